@@ -0,0 +1,144 @@
+#include <new>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include "allocation_guard.h"
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+#include "eigen/Eigen/Core"
+#endif
+
+namespace {
+thread_local int t_guard_depth = 0;  // Guards held by the thread, 0 while paused.
+std::atomic<u64> g_allocation_count{0};
+#ifdef _DEBUG
+std::atomic<bool> g_fail_fast{true};
+#else
+std::atomic<bool> g_fail_fast{false};
+#endif
+
+
+void set_guard_depth(const int guard_depth) {
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+	if ((t_guard_depth == 0) != (guard_depth == 0)) {
+		Eigen::internal::set_is_malloc_allowed(guard_depth == 0);
+	}
+#endif
+	t_guard_depth = guard_depth;
+}
+
+
+// The size of the Eigen allocations is not known (0).
+void count_allocation(const std::size_t size, const bool eigen = false) {
+	if (t_guard_depth == 0) {
+		return;
+	}
+	++g_allocation_count;
+	if (g_fail_fast) {
+		// Nothing which allocates may run from here (the report would recurse), so the report is plain stdio.
+		t_guard_depth = 0;
+		if (eigen) {
+			std::fprintf(stderr, "APP: Eigen heap allocation on the cycle path\n");
+		}
+		else {
+			std::fprintf(stderr, "APP: Heap allocation of %zu bytes on the cycle path\n", size);
+		}
+		std::abort();
+	}
+}
+}
+
+
+AllocationGuard::AllocationGuard() {
+	set_guard_depth(t_guard_depth + 1);
+}
+
+
+AllocationGuard::~AllocationGuard() {
+	set_guard_depth(t_guard_depth - 1);
+}
+
+
+u64 AllocationGuard::take_allocation_count() {
+	return g_allocation_count.exchange(0);
+}
+
+
+void AllocationGuard::set_fail_fast(const bool fail_fast) {
+	g_fail_fast = fail_fast;
+}
+
+
+bool AllocationGuard::get_fail_fast() {
+	return g_fail_fast;
+}
+
+
+void AllocationGuard::count_eigen_allocation() {
+	count_allocation(0, true);
+}
+
+
+AllocationPause::AllocationPause() : m_guard_depth(t_guard_depth) {
+	set_guard_depth(0);
+}
+
+
+AllocationPause::~AllocationPause() {
+	set_guard_depth(m_guard_depth);
+}
+
+
+// Replacements of the global allocation functions (the rest of the forms forward to these).
+void* operator new(std::size_t size) {
+	count_allocation(size);
+	if (auto ptr = std::malloc(size ? size : 1)) {
+		return ptr;
+	}
+	throw std::bad_alloc{};
+}
+
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	count_allocation(size);
+	return std::malloc(size ? size : 1);
+}
+
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+
+void operator delete[](void* ptr) noexcept {
+	std::free(ptr);
+}
+
+
+void operator delete(void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
+
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+	std::free(ptr);
+}
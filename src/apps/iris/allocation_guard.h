@@ -0,0 +1,75 @@
+#pragma once
+#include <type_traits>
+#include "core0/types.h"
+
+
+// Tracks the heap allocations of the cycle path.
+// The global operator new of the app is replaced (see allocation_guard.cpp), it counts an allocation whenever the calling
+// thread holds a guard. Only the thread which holds the guard is tracked (the DAQ callback thread, not the OpenMP workers),
+// and allocations of the DLLs (which have their own operator new) are not seen.
+// In fail fast mode, an allocation under a guard aborts, so the debugger stops at the allocating call.
+// Eigen allocates with malloc rather than operator new. With EIGEN_RUNTIME_NO_MALLOC (all the builds of the app, with this
+// header force included), the guard forbids the Eigen allocations, and eigen_assert below counts them instead of asserting.
+// Its flag is shared by all the threads, so the Eigen allocations of the other threads reach the count, which ignores them.
+class AllocationGuard {
+public:
+	AllocationGuard();
+	~AllocationGuard();
+	AllocationGuard(const AllocationGuard&) = delete;
+	AllocationGuard& operator=(const AllocationGuard&) = delete;
+
+	// Allocations under a guard since the last call.
+	static u64 take_allocation_count();
+
+	// Fail fast is on by default in debug builds.
+	static void set_fail_fast(const bool fail_fast);
+	static bool get_fail_fast();
+
+	// Counts an Eigen allocation of the calling thread (see eigen_assert below).
+	static void count_eigen_allocation();
+
+	// Whether an Eigen assertion is the check of its allocations (the condition is the text of the assertion).
+	static constexpr bool is_eigen_allocation_check(const char* const condition) {
+		const char kAllocationCheck[] = "heap allocation is forbidden";
+		for (auto text = condition; *text; ++text) {
+			auto length = 0;
+			while (kAllocationCheck[length] && (text[length] == kAllocationCheck[length])) {
+				++length;
+			}
+			if (!kAllocationCheck[length]) {
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+
+// The allocation check of Eigen is counted, the rest of its assertions are left as they are (compiled out in release builds).
+// The check is picked at compile time, so the other assertions cost nothing more.
+#ifdef EIGEN_RUNTIME_NO_MALLOC
+#define eigen_assert(x) \
+	do { \
+		if (std::integral_constant<bool, AllocationGuard::is_eigen_allocation_check(#x)>::value) { \
+			if (!(x)) { \
+				AllocationGuard::count_eigen_allocation(); \
+			} \
+		} \
+		else { \
+			eigen_plain_assert(x); \
+		} \
+	} while (false)
+#endif
+
+
+// Suspends the guard of the thread, for the paths of the callback which are expected to allocate (reports and recovery).
+class AllocationPause {
+public:
+	AllocationPause();
+	~AllocationPause();
+	AllocationPause(const AllocationPause&) = delete;
+	AllocationPause& operator=(const AllocationPause&) = delete;
+
+private:
+	int m_guard_depth;
+};
@@ -0,0 +1,246 @@
+#include <fstream>
+#include <functional>
+#include <cstring>
+#include <vector>
+#include "spdlog/spdlog.h"
+#include "glv/glv_column.h"
+#include "backends.h"
+#include "daq_emulation.h"
+
+namespace {
+// The board, forwarded as is.
+class HardwareDAQ : public DAQBackend {
+public:
+	RETURN_CODE configure(const DAQParams& daq_params) override { return m_daq.configure(daq_params); }
+	RETURN_CODE capture() override { return m_daq.capture(); }
+	void stop() override { m_daq.stop(); }
+	bool wait_for_armed(const u32 timeout_ms) override { return m_daq.wait_for_armed(timeout_ms); }
+	bool get_trigger_count(u32* trigger_count) const override { return m_daq.get_trigger_count(trigger_count); }
+	void set_trace_buffer(TraceBuffer* const trace_buffer) override { m_daq.set_trace_buffer(trace_buffer); }
+	const char* error_to_text(const RETURN_CODE& return_code) const override { return m_daq.error_to_text(return_code); }
+
+private:
+	DAQ m_daq;
+};
+
+
+// The GLV, forwarded as is, with or without the LOOPCYCLE command of the firmware.
+class HardwareGLV : public GLVBackend {
+public:
+	explicit HardwareGLV(const bool loopcycle) : m_loopcycle{loopcycle} {}
+	bool configure(const GLVParams& glv_params) override {
+		auto params = glv_params;
+		params.loopcycle = m_loopcycle;
+		return m_glv.configure(params);
+	}
+	bool set_column_period(const u32 col_period_ns) override { return m_glv.set_column_period(col_period_ns); }
+	bool preload(const GLVFrameXs& dac_frame) override { return m_glv.preload(dac_frame); }
+	bool load_columns(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) override { return m_glv.load_columns(column_start, dac_frame); }
+	bool cycle(const u16 column_start, const u16 column_end, const bool repeat) override { return m_glv.cycle(column_start, column_end, repeat); }
+	bool run_loop_cycle() override { return m_glv.run_loop_cycle(); }
+	bool restart_loop_cycle(const u32 loopcycle_wait_us) override { return m_glv.restart_loop_cycle(loopcycle_wait_us); }
+	bool stop_loop_cycle() override { return m_glv.stop_loop_cycle(); }
+	bool interrupt_loop_cycle(const u16 filler_columns) override { return m_glv.interrupt_loop_cycle(filler_columns); }
+	bool resume_loop_cycle() override { return m_glv.resume_loop_cycle(); }
+	bool set_loop_cycle_range(const u16 column_start, const u16 column_end) override { return m_glv.set_loop_cycle_range(column_start, column_end); }
+	bool reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) override { return m_glv.reload_loop_cycle(column_start, dac_frame); }
+	bool reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame, const u16 loop_column_start, const u16 loop_column_end) override {
+		return m_glv.reload_loop_cycle(column_start, dac_frame, loop_column_start, loop_column_end);
+	}
+	bool stop() override { return m_glv.stop(); }
+	bool run_test(const GLV::GLV_TESTS& test_index) override { return m_glv.run_test(test_index); }
+	bool load_and_resume_cycle(const GLVColVectorXs& dac_column) override { return m_glv.load_and_resume_cycle(dac_column); }
+	void set_trace_buffer(TraceBuffer* const trace_buffer) override { m_glv.set_trace_buffer(trace_buffer); }
+
+private:
+	GLV m_glv;
+	bool m_loopcycle;
+};
+
+
+// No GLV, the commands succeed right away. The variable column is still converted to the raw buffer of the GLV,
+// so benchmarking the processing datapath includes the work of the GLV library.
+class NullGLV : public GLVBackend {
+public:
+	NullGLV() : m_glv_buffer(kGLVPixels) {}
+	bool configure(const GLVParams& glv_params) override { return true; }
+	bool set_column_period(const u32 col_period_ns) override { return true; }
+	bool preload(const GLVFrameXs& dac_frame) override { return true; }
+	bool load_columns(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) override { return true; }
+	bool cycle(const u16 column_start, const u16 column_end, const bool repeat) override { return true; }
+	bool run_loop_cycle() override { return true; }
+	bool restart_loop_cycle(const u32 loopcycle_wait_us) override { return true; }
+	bool stop_loop_cycle() override { return true; }
+	bool interrupt_loop_cycle(const u16 filler_columns) override { return true; }
+	bool resume_loop_cycle() override { return true; }
+	bool set_loop_cycle_range(const u16 column_start, const u16 column_end) override { return true; }
+	bool reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) override { return true; }
+	bool reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame, const u16 loop_column_start, const u16 loop_column_end) override { return true; }
+	bool stop() override { return true; }
+	bool run_test(const GLV::GLV_TESTS& test_index) override { return false; }  // The tests need the GLV.
+	bool load_and_resume_cycle(const GLVColVectorXs& dac_column) override {
+		TraceSpan trace_span{"glv_load_column"};
+		convert_glv_column_to_raw_buffer(dac_column.data(), m_glv_buffer.data());
+		return true;
+	}
+	void set_trace_buffer(TraceBuffer* const trace_buffer) override {}
+
+private:
+	std::vector<u16> m_glv_buffer;
+};
+
+
+// The backends by name, the first is the default.
+struct DAQBackendEntry {
+	const char* name;
+	const char* description;
+	std::function<std::unique_ptr<DAQBackend>(const BackendOptions&)> create;
+};
+struct GLVBackendEntry {
+	const char* name;
+	const char* description;
+	std::function<std::unique_ptr<GLVBackend>(const BackendOptions&)> create;
+};
+const DAQBackendEntry kDAQBackends[] = {
+	{"ats9350", "AlazarTech ATS9350 board", [](const BackendOptions&) { return std::unique_ptr<DAQBackend>{new HardwareDAQ}; }},
+	{"simulator", "Synthesized buffers, delivered back to back", [](const BackendOptions&) { return std::unique_ptr<DAQBackend>{new SimulatedDAQ}; }},
+	{"replay", "Replays the recording in daq_replay_file", [](const BackendOptions& options) { return std::unique_ptr<DAQBackend>{new ReplayDAQ{options.daq_replay_file}}; }},
+};
+const GLVBackendEntry kGLVBackends[] = {
+	{"glv", "GLV with the LOOPCYCLE firmware command", [](const BackendOptions&) { return std::unique_ptr<GLVBackend>{new HardwareGLV{true}}; }},
+	{"glv_no_loopcycle", "GLV without the LOOPCYCLE firmware command (emulated with USB and GOLUT, slower)", [](const BackendOptions&) { return std::unique_ptr<GLVBackend>{new HardwareGLV{false}}; }},
+	{"null", "No GLV, only the column conversion runs (for benchmarking the processing)", [](const BackendOptions&) { return std::unique_ptr<GLVBackend>{new NullGLV}; }},
+};
+
+
+std::string trim(const std::string& text) {
+	auto first = text.find_first_not_of(" \t\r\n");
+	if (first == std::string::npos) {
+		return {};
+	}
+	auto last = text.find_last_not_of(" \t\r\n");
+	return text.substr(first, last - first + 1);
+}
+
+
+bool set_backend_option(const std::string& key, const std::string& value, BackendOptions& options) {
+	if (key == "daq") {
+		options.daq = value;
+	}
+	else if (key == "glv") {
+		options.glv = value;
+	}
+	else if (key == "daq_record_file") {
+		options.daq_record_file = value;
+	}
+	else if (key == "daq_replay_file") {
+		options.daq_replay_file = value;
+	}
+	else if (key == "benchmark") {
+		if (!value.empty() && (value != "tm") && (value != "iterative")) {
+			spdlog::error("APP: Unknown benchmark %s", value);
+			return false;
+		}
+		options.benchmark = value;
+	}
+	else if (key == "config") {
+		return load_backend_config_file(value, options);
+	}
+	else {
+		spdlog::error("APP: Unknown option %s", key);
+		return false;
+	}
+	return true;
+}
+}
+
+
+bool parse_backend_options(const int argc, char* argv[], BackendOptions& options) {
+	for (auto arg_index = 1; arg_index < argc; ++arg_index) {
+		std::string arg{argv[arg_index]};
+		if ((arg.size() < 3) || (arg.compare(0, 2, "--") != 0)) {
+			spdlog::error("APP: Unexpected argument %s", arg);
+			return false;
+		}
+		if (arg_index + 1 == argc) {
+			spdlog::error("APP: Option %s needs a value", arg);
+			return false;
+		}
+		if (!set_backend_option(arg.substr(2), argv[++arg_index], options)) {
+			return false;
+		}
+	}
+
+	// The benchmark uploads its solutions back to back without a loop cycle, which the GLV can't display.
+	if (!options.benchmark.empty() && (options.glv != "null")) {
+		spdlog::error("APP: The %s benchmark runs only with the null GLV backend (--glv null)", options.benchmark);
+		return false;
+	}
+	return true;
+}
+
+
+bool load_backend_config_file(const std::string& file_name, BackendOptions& options) {
+	std::ifstream file{file_name};
+	if (!file) {
+		spdlog::error("APP: Failed to open the config file %s", file_name);
+		return false;
+	}
+	std::string line;
+	auto line_number = 0;
+	while (std::getline(file, line)) {
+		line_number++;
+		line = trim(line.substr(0, line.find('#')));
+		if (line.empty()) {
+			continue;
+		}
+		auto separator = line.find('=');
+		if (separator == std::string::npos) {
+			spdlog::error("APP: %s:%d: expected \"key = value\"", file_name, line_number);
+			return false;
+		}
+		if (!set_backend_option(trim(line.substr(0, separator)), trim(line.substr(separator + 1)), options)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void print_backend_usage() {
+	spdlog::info("Usage: iris [--config <file>] [--daq <backend>] [--glv <backend>] [--daq_record_file <file>] [--daq_replay_file <file>] [--benchmark tm|iterative]");
+	spdlog::info("DAQ backends:");
+	for (const auto& backend : kDAQBackends) {
+		spdlog::info("  %s - %s", backend.name, backend.description);
+	}
+	spdlog::info("GLV backends:");
+	for (const auto& backend : kGLVBackends) {
+		spdlog::info("  %s - %s", backend.name, backend.description);
+	}
+}
+
+
+std::unique_ptr<DAQBackend> create_daq_backend(const BackendOptions& options) {
+	for (const auto& backend : kDAQBackends) {
+		if (options.daq == backend.name) {
+			auto daq = backend.create(options);
+			if (!options.daq_record_file.empty()) {
+				daq = std::unique_ptr<DAQBackend>{new RecordingDAQ{std::move(daq), options.daq_record_file}};
+			}
+			return daq;
+		}
+	}
+	spdlog::error("APP: Unknown DAQ backend %s", options.daq);
+	return nullptr;
+}
+
+
+std::unique_ptr<GLVBackend> create_glv_backend(const BackendOptions& options) {
+	for (const auto& backend : kGLVBackends) {
+		if (options.glv == backend.name) {
+			return backend.create(options);
+		}
+	}
+	spdlog::error("APP: Unknown GLV backend %s", options.glv);
+	return nullptr;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <memory>
+#include <string>
+#include "eigen/Eigen/Dense"
+#include "core0/types.h"
+#include "core2/trace.h"
+#include "alazar_daq/alazar_daq.h"
+#include "glv/glv.h"
+
+
+// The DAQ as the application uses it, implemented by the board (DAQ) and by the emulations (see daq_emulation.h).
+// Same semantics as the DAQ methods of the same names.
+class DAQBackend {
+public:
+	virtual ~DAQBackend() {}
+	virtual RETURN_CODE configure(const DAQParams& daq_params) = 0;
+	virtual RETURN_CODE capture() = 0;
+	virtual void stop() = 0;
+	virtual bool wait_for_armed(const u32 timeout_ms) = 0;
+	virtual bool get_trigger_count(u32* trigger_count) const = 0;
+	virtual void set_trace_buffer(TraceBuffer* const trace_buffer) = 0;
+	virtual const char* error_to_text(const RETURN_CODE& return_code) const = 0;
+};
+
+
+// The GLV as the application uses it, implemented by the GLV and by the null sink.
+// Same semantics as the GLV methods of the same names.
+class GLVBackend {
+public:
+	virtual ~GLVBackend() {}
+	virtual bool configure(const GLVParams& glv_params) = 0;
+	virtual bool set_column_period(const u32 col_period_ns) = 0;
+	virtual bool preload(const GLVFrameXs& dac_frame) = 0;
+	virtual bool load_columns(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) = 0;
+	virtual bool cycle(const u16 column_start, const u16 column_end, const bool repeat = false) = 0;
+	virtual bool run_loop_cycle() = 0;
+	virtual bool restart_loop_cycle(const u32 loopcycle_wait_us) = 0;
+	virtual bool stop_loop_cycle() = 0;
+	virtual bool interrupt_loop_cycle(const u16 filler_columns) = 0;
+	virtual bool resume_loop_cycle() = 0;
+	virtual bool set_loop_cycle_range(const u16 column_start, const u16 column_end) = 0;
+	virtual bool reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) = 0;
+	virtual bool reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame, const u16 loop_column_start, const u16 loop_column_end) = 0;
+	virtual bool stop() = 0;
+	virtual bool run_test(const GLV::GLV_TESTS& test_index) = 0;
+	virtual bool load_and_resume_cycle(const GLVColVectorXs& dac_column) = 0;
+	virtual void set_trace_buffer(TraceBuffer* const trace_buffer) = 0;
+};
+
+
+// Selects the backends at startup, from the command line or a config file (one "key = value" per line, '#' starts a comment).
+// The keys are the command line options without the dashes, e.g. "--daq simulator" or "daq = simulator".
+struct BackendOptions {
+	std::string daq = "ats9350";  // See kDAQBackends in backends.cpp.
+	std::string glv = "glv";  // See kGLVBackends in backends.cpp.
+	std::string daq_record_file;  // If set, the buffers of the DAQ are also recorded to this file (for the replay DAQ).
+	std::string daq_replay_file = "daq_recording.bin";  // Recording which the replay DAQ plays.
+	std::string benchmark;  // "tm" or "iterative" benchmarks the processing datapath on startup, only with the null GLV backend.
+};
+
+
+// Parses the command line, a config file (--config) is applied where it appears, so later options override it.
+bool parse_backend_options(const int argc, char* argv[], BackendOptions& options);
+
+// Applies the options of a config file.
+bool load_backend_config_file(const std::string& file_name, BackendOptions& options);
+
+// Lists the options and the backends.
+void print_backend_usage();
+
+// Create the selected backends, nullptr if the name is unknown.
+std::unique_ptr<DAQBackend> create_daq_backend(const BackendOptions& options);
+std::unique_ptr<GLVBackend> create_glv_backend(const BackendOptions& options);
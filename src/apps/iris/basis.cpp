@@ -0,0 +1,129 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "basis.h"
+const f32 PI_F32 = 3.1415927f;
+const f32 TWOPI_F32 = 2 * PI_F32;
+
+
+namespace {
+	// Parity of the set bits, 1 if odd.
+	inline u32 parity(const u32 value) {
+#ifdef _MSC_VER
+		return __popcnt(value) & 1;
+#else
+		return __builtin_popcount(value) & 1;
+#endif
+	}
+}
+
+
+Basis::Basis() :
+	m_type(INPUT_MODE_BASIS::HADAMARD),
+	m_modes(0) {
+}
+
+
+void Basis::configure(const INPUT_MODE_BASIS type, const int modes) {
+	m_type = type;
+	m_modes = modes;
+
+	// Fourier basis.
+	// Each DFT matrix column gives two basis elements, the DFT element PI * exp(-j*2PI*k*n/N) is used as a phase:
+	// Real part corresponds to a cosine wave, exp(j*PI*cos(2PI*k*n/N)).
+	// Imaginery part corresponds to a sine wave, exp(-j*PI*sin(2PI*k*n/N)).
+	// Both only depend on (k*n) % N, so a single period is kept.
+	if (m_type == INPUT_MODE_BASIS::FOURIER) {
+		m_fourier_cos_lut = Eigen::VectorXcf{m_modes};
+		m_fourier_sin_lut = Eigen::VectorXcf{m_modes};
+		for (auto lut_index = 0; lut_index < m_modes; ++lut_index) {
+			auto twiddle_phase = TWOPI_F32 * lut_index / m_modes;
+			m_fourier_cos_lut(lut_index) = std::polar(1.0f, PI_F32 * cosf(twiddle_phase));
+			m_fourier_sin_lut(lut_index) = std::polar(1.0f, -PI_F32 * sinf(twiddle_phase));
+		}
+	}
+	else {
+		m_fourier_cos_lut.resize(0);
+		m_fourier_sin_lut.resize(0);
+	}
+}
+
+
+std::complex<f32> Basis::element(const int mode_pixel, const int mode) const {
+	// Hadamard basis (Sylvester construction), H(n, k) = (-1)^popcount(n & k).
+	if (m_type == INPUT_MODE_BASIS::HADAMARD) {
+		return std::complex<f32>{parity(static_cast<u32>(mode_pixel & mode)) ? -1.0f : 1.0f, 0};
+	}
+
+	// Fourier basis, even modes are cosine waves and odd modes are sine waves of the frequency mode/2.
+	auto lut_index = ((mode >> 1) * mode_pixel) % m_modes;
+	return (mode & 1) ? m_fourier_sin_lut(lut_index) : m_fourier_cos_lut(lut_index);
+}
+
+
+Eigen::VectorXcf Basis::column(const int mode) const {
+	auto mode_column = Eigen::VectorXcf{m_modes};
+	fill_block(0, mode, mode_column);
+	return mode_column;
+}
+
+
+void Basis::transform(const Eigen::Ref<const Eigen::VectorXcf>& coefficients, Eigen::Ref<Eigen::VectorXf> pattern_real, Eigen::Ref<Eigen::VectorXf> pattern_imag) const {
+	// In place fast Walsh-Hadamard transform (Sylvester ordering, #modes is a power of 2).
+	// The basis is real, so the real and imaginary planes are transformed separately, each butterfly stage runs on full vectors of floats.
+	if (m_type == INPUT_MODE_BASIS::HADAMARD) {
+		pattern_real = coefficients.real();
+		pattern_imag = coefficients.imag();
+		for (auto plane : {pattern_real.data(), pattern_imag.data()}) {
+			for (auto half_size = 1; half_size < m_modes; half_size <<= 1) {
+				for (auto butterfly_start = 0; butterfly_start < m_modes; butterfly_start += (half_size << 1)) {
+					for (auto index = butterfly_start; index < (butterfly_start + half_size); ++index) {
+						auto sum = plane[index] + plane[index + half_size];
+						plane[index + half_size] = plane[index] - plane[index + half_size];
+						plane[index] = sum;
+					}
+				}
+			}
+		}
+		return;
+	}
+
+	// The Fourier basis elements are phases of the DFT elements, which have no fast transform.
+	for (auto mode_pixel = 0; mode_pixel < m_modes; ++mode_pixel) {
+		std::complex<f32> sum{0, 0};
+		for (auto mode = 0; mode < m_modes; ++mode) {
+			sum += element(mode_pixel, mode) * coefficients(mode);
+		}
+		pattern_real(mode_pixel) = sum.real();
+		pattern_imag(mode_pixel) = sum.imag();
+	}
+}
+
+
+void Basis::fill_block(const int mode_pixel_start, const int mode_start, Eigen::Ref<Eigen::MatrixXcf> block) const {
+	for (auto col_index = 0; col_index < block.cols(); ++col_index) {
+		for (auto row_index = 0; row_index < block.rows(); ++row_index) {
+			block(row_index, col_index) = element(mode_pixel_start + row_index, mode_start + col_index);
+		}
+	}
+}
+
+
+void Basis::fill_block(const int mode_pixel_start, const int mode_start, Eigen::Ref<Eigen::MatrixXf> block_real, Eigen::Ref<Eigen::MatrixXf> block_imag) const {
+	for (auto col_index = 0; col_index < block_real.cols(); ++col_index) {
+		for (auto row_index = 0; row_index < block_real.rows(); ++row_index) {
+			auto value = element(mode_pixel_start + row_index, mode_start + col_index);
+			block_real(row_index, col_index) = value.real();
+			block_imag(row_index, col_index) = value.imag();
+		}
+	}
+}
+
+
+void Basis::fill_hadamard_block(const int mode_pixel_start, const int mode_start, Eigen::Ref<Eigen::MatrixXi> block) const {
+	for (auto col_index = 0; col_index < block.cols(); ++col_index) {
+		for (auto row_index = 0; row_index < block.rows(); ++row_index) {
+			block(row_index, col_index) = parity(static_cast<u32>((mode_pixel_start + row_index) & (mode_start + col_index))) ? -1 : 1;
+		}
+	}
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <complex>
+#include "eigen/Eigen/Dense"
+#include "core0/types.h"
+
+
+// Input mode basis in mode space (one row per mode pixel, one column per mode).
+// The elements are generated on demand, so only O(#modes) memory is kept and reconfiguring is immediate.
+class Basis {
+public:
+	enum INPUT_MODE_BASIS {
+		HADAMARD = 0,
+		FOURIER
+	};
+
+	Basis();
+
+	// Sets the type and the number of modes (which is also the number of mode pixels) of the basis.
+	void configure(const INPUT_MODE_BASIS type, const int modes);
+
+	// Element of the mode pixel in the mode (cartesian).
+	std::complex<f32> element(const int mode_pixel, const int mode) const;
+
+	// Column of the mode.
+	Eigen::VectorXcf column(const int mode) const;
+
+	// Fills the block with the mode pixels [mode_pixel_start, mode_pixel_start + block.rows()) of the
+	// modes [mode_start, mode_start + block.cols()).
+	void fill_block(const int mode_pixel_start, const int mode_start, Eigen::Ref<Eigen::MatrixXcf> block) const;
+
+	// Same as above, the real and imaginary parts are filled to separate planes.
+	void fill_block(const int mode_pixel_start, const int mode_start, Eigen::Ref<Eigen::MatrixXf> block_real, Eigen::Ref<Eigen::MatrixXf> block_imag) const;
+
+	// Same as above for the Hadamard basis, whose elements are +1/-1 integers.
+	void fill_hadamard_block(const int mode_pixel_start, const int mode_start, Eigen::Ref<Eigen::MatrixXi> block) const;
+
+	// True if the basis has a fast (O(N log N)) transform.
+	bool has_fast_transform() const { return m_type == INPUT_MODE_BASIS::HADAMARD; }
+
+	// True if the elements of the basis are real (their imaginary plane is zero).
+	bool is_real() const { return m_type == INPUT_MODE_BASIS::HADAMARD; }
+
+	// Sums up the modes weighted by the coefficients, pattern = B * coefficients, to separate real and imaginary planes.
+	void transform(const Eigen::Ref<const Eigen::VectorXcf>& coefficients, Eigen::Ref<Eigen::VectorXf> pattern_real, Eigen::Ref<Eigen::VectorXf> pattern_imag) const;
+
+	int modes() const { return m_modes; }
+	INPUT_MODE_BASIS type() const { return m_type; }
+
+private:
+	INPUT_MODE_BASIS m_type;
+	int m_modes;
+	Eigen::VectorXcf m_fourier_cos_lut;  // Element of the cosine mode, indexed by (frequency * mode pixel) % #modes.
+	Eigen::VectorXcf m_fourier_sin_lut;  // Element of the sine mode, indexed the same way.
+};
@@ -0,0 +1,247 @@
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <algorithm>
+#include "spdlog/spdlog.h"
+#include "daq_emulation.h"
+const int kSimulatedDAQBuffers = 4;
+const u32 kSimulatedDAQSeed = 1;
+const int kSimulatedDAQNoiseCodes = 8;  // Peak noise of the samples (12 bit codes).
+const char kRecordingMagic[8] = {'I', 'R', 'I', 'S', 'D', 'A', 'Q', '1'};
+
+
+EmulatedDAQ::EmulatedDAQ() :
+	m_channel_count{1},
+	m_samples_per_buffer{0},
+	m_daq_configured{false},
+	m_daq_running{false},
+	m_trigger_count{0},
+	m_daq_armed{false} {
+}
+
+
+RETURN_CODE EmulatedDAQ::configure(const DAQParams& daq_params) {
+	if (m_daq_running) {
+		return ApiFailed;
+	}
+	m_daq_params = daq_params;
+	m_channel_count = ((daq_params.channel_mask & CHANNEL_A) ? 1 : 0) + ((daq_params.channel_mask & CHANNEL_B) ? 1 : 0);
+	m_samples_per_buffer = static_cast<size_t>(daq_params.samples_per_record) * daq_params.records_per_buffer * m_channel_count;
+	m_daq_configured = load_buffers() && !m_buffers.empty();
+	return m_daq_configured ? ApiSuccess : ApiFailed;
+}
+
+
+RETURN_CODE EmulatedDAQ::capture() {
+	if (!m_daq_configured) {
+		return ApiFailed;
+	}
+
+	// Capture loop, armed right away.
+	Trace::set_thread_name("daq");
+	u64 buffers_completed = 0;
+	auto bytes_per_buffer = m_samples_per_buffer * sizeof(u16);
+	m_trigger_count = 0;
+	m_daq_running = true;
+	{
+		std::lock_guard<std::mutex> lock(m_armed_mtx);
+		m_daq_armed = true;
+	}
+	m_armed_cv.notify_all();
+	while (m_daq_running) {
+		auto& buffer = m_buffers[buffers_completed % m_buffers.size()];
+		buffers_completed++;
+		m_trigger_count += m_daq_params.records_per_buffer;
+		if (m_daq_params.on_recv) {
+			m_daq_params.on_recv(buffer.data(), bytes_per_buffer, buffers_completed);
+		}
+		if ((m_daq_params.acquisition_mode == DAQParams::ACQUISTION_SINGLE) && (buffers_completed == m_daq_params.buffers_per_acquisition)) {
+			break;
+		}
+	}
+	m_daq_running = false;
+	{
+		std::lock_guard<std::mutex> lock(m_armed_mtx);
+		m_daq_armed = false;
+	}
+	return ApiSuccess;
+}
+
+
+void EmulatedDAQ::stop() {
+	m_daq_running = false;
+}
+
+
+bool EmulatedDAQ::wait_for_armed(const u32 timeout_ms) {
+	std::unique_lock<std::mutex> lock(m_armed_mtx);
+	return m_armed_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return m_daq_armed; });
+}
+
+
+bool EmulatedDAQ::get_trigger_count(u32* trigger_count) const {
+	*trigger_count = m_trigger_count;
+	return true;
+}
+
+
+void EmulatedDAQ::set_trace_buffer(TraceBuffer* const trace_buffer) {
+	// Part of the application, so it already records to its trace.
+}
+
+
+const char* EmulatedDAQ::error_to_text(const RETURN_CODE& return_code) const {
+	// The emulations fail only on their configuration.
+	return (return_code == ApiSuccess) ? "ApiSuccess" : "ApiFailed (emulated DAQ)";
+}
+
+
+bool SimulatedDAQ::load_buffers() {
+	// Samples are arranged as the board arranges them: S0A, S0B, ..., S1A, S1B, ... within each record.
+	std::mt19937 random{kSimulatedDAQSeed};
+	std::uniform_int_distribution<int> intensity_distribution{0x400, 0xC00};
+	std::uniform_int_distribution<int> noise_distribution{-kSimulatedDAQNoiseCodes, kSimulatedDAQNoiseCodes};
+	m_buffers.resize(kSimulatedDAQBuffers);
+	for (auto& buffer : m_buffers) {
+		buffer.resize(m_samples_per_buffer);
+		for (u32 record_index = 0; record_index < m_daq_params.records_per_buffer; ++record_index) {
+			for (auto channel_index = 0; channel_index < m_channel_count; ++channel_index) {
+				auto intensity = intensity_distribution(random);
+				for (u32 sample_index = 0; sample_index < m_daq_params.samples_per_record; ++sample_index) {
+					auto code = (std::max)(0, (std::min)(intensity + noise_distribution(random), 0xFFF));
+					buffer[(static_cast<size_t>(record_index) * m_daq_params.samples_per_record + sample_index) * m_channel_count + channel_index] = static_cast<u16>(code << 4);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+
+ReplayDAQ::ReplayDAQ(const std::string& file_name) :
+	m_file_name{file_name} {
+}
+
+
+bool ReplayDAQ::load_buffers() {
+	std::ifstream file{m_file_name, std::ios::binary};
+	if (!file) {
+		spdlog::error("APP: Failed to open the DAQ recording %s", m_file_name);
+		return false;
+	}
+	char magic[sizeof(kRecordingMagic)];
+	u32 records_per_buffer;
+	u32 samples_per_record;
+	u32 channels;
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(&records_per_buffer), sizeof(records_per_buffer));
+	file.read(reinterpret_cast<char*>(&samples_per_record), sizeof(samples_per_record));
+	file.read(reinterpret_cast<char*>(&channels), sizeof(channels));
+	if (!file || (std::memcmp(magic, kRecordingMagic, sizeof(magic)) != 0)) {
+		spdlog::error("APP: %s is not a DAQ recording", m_file_name);
+		return false;
+	}
+	if ((records_per_buffer != m_daq_params.records_per_buffer) || (samples_per_record != m_daq_params.samples_per_record) || (channels != static_cast<u32>(m_channel_count))) {
+		spdlog::error("APP: The DAQ recording has %d records of %d samples and %d channel(s) per buffer, the run needs %d records of %d samples and %d channel(s)",
+			records_per_buffer, samples_per_record, channels, m_daq_params.records_per_buffer, m_daq_params.samples_per_record, m_channel_count);
+		return false;
+	}
+
+	// The buffers are loaded in advance, so the replay doesn't wait for the disk.
+	m_buffers.clear();
+	while (true) {
+		u64 data_index;
+		u64 bytes;
+		file.read(reinterpret_cast<char*>(&data_index), sizeof(data_index));
+		file.read(reinterpret_cast<char*>(&bytes), sizeof(bytes));
+		if (!file) {
+			break;
+		}
+		if (bytes != m_samples_per_buffer * sizeof(u16)) {
+			spdlog::error("APP: The DAQ recording %s is corrupt", m_file_name);
+			return false;
+		}
+		m_buffers.emplace_back(m_samples_per_buffer);
+		file.read(reinterpret_cast<char*>(m_buffers.back().data()), bytes);
+		if (!file) {
+			m_buffers.pop_back();
+			break;
+		}
+	}
+	spdlog::info("APP: Replaying %d DAQ buffers from %s", m_buffers.size(), m_file_name);
+	return true;
+}
+
+
+RecordingDAQ::RecordingDAQ(std::unique_ptr<DAQBackend> daq, const std::string& file_name) :
+	m_daq{std::move(daq)},
+	m_file_name{file_name} {
+}
+
+
+RETURN_CODE RecordingDAQ::configure(const DAQParams& daq_params) {
+	// Each configuration starts a new recording.
+	m_file.close();
+	m_file.open(m_file_name, std::ios::binary | std::ios::trunc);
+	if (!m_file) {
+		spdlog::error("APP: Failed to open the DAQ recording %s", m_file_name);
+		return ApiFailed;
+	}
+	u32 channels = ((daq_params.channel_mask & CHANNEL_A) ? 1 : 0) + ((daq_params.channel_mask & CHANNEL_B) ? 1 : 0);
+	m_file.write(kRecordingMagic, sizeof(kRecordingMagic));
+	m_file.write(reinterpret_cast<const char*>(&daq_params.records_per_buffer), sizeof(daq_params.records_per_buffer));
+	m_file.write(reinterpret_cast<const char*>(&daq_params.samples_per_record), sizeof(daq_params.samples_per_record));
+	m_file.write(reinterpret_cast<const char*>(&channels), sizeof(channels));
+
+	// The buffers pass through the recording on their way to the application.
+	m_on_recv = daq_params.on_recv;
+	auto recording_params = daq_params;
+	recording_params.on_recv = std::bind(&RecordingDAQ::on_buffer_receive, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	return m_daq->configure(recording_params);
+}
+
+
+RETURN_CODE RecordingDAQ::capture() {
+	auto return_code = m_daq->capture();
+	m_file.flush();
+	return return_code;
+}
+
+
+void RecordingDAQ::stop() {
+	m_daq->stop();
+}
+
+
+bool RecordingDAQ::wait_for_armed(const u32 timeout_ms) {
+	return m_daq->wait_for_armed(timeout_ms);
+}
+
+
+bool RecordingDAQ::get_trigger_count(u32* trigger_count) const {
+	return m_daq->get_trigger_count(trigger_count);
+}
+
+
+void RecordingDAQ::set_trace_buffer(TraceBuffer* const trace_buffer) {
+	m_daq->set_trace_buffer(trace_buffer);
+}
+
+
+const char* RecordingDAQ::error_to_text(const RETURN_CODE& return_code) const {
+	return m_daq->error_to_text(return_code);
+}
+
+
+void RecordingDAQ::on_buffer_receive(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	{
+		TraceSpan trace_span{"daq_record"};
+		u64 bytes = data_len;
+		m_file.write(reinterpret_cast<const char*>(&data_index), sizeof(data_index));
+		m_file.write(reinterpret_cast<const char*>(&bytes), sizeof(bytes));
+		m_file.write(reinterpret_cast<const char*>(data_ptr), data_len);
+	}
+	if (m_on_recv) {
+		m_on_recv(data_ptr, data_len, data_index);
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <condition_variable>
+#include "core0/types.h"
+#include "core2/pinned_memory.h"
+#include "backends.h"
+
+
+// A DAQ without a board, it delivers its buffers back to back on the capture thread (as fast as the callback returns),
+// so the processing runs at its own speed. Every delivered record counts as a trigger, so the buffers are always aligned.
+// The buffers are laid out as the board lays them out (see DAQ::capture()).
+class EmulatedDAQ : public DAQBackend {
+public:
+	EmulatedDAQ();
+	RETURN_CODE configure(const DAQParams& daq_params) override;
+	RETURN_CODE capture() override;
+	void stop() override;
+	bool wait_for_armed(const u32 timeout_ms) override;
+	bool get_trigger_count(u32* trigger_count) const override;
+	void set_trace_buffer(TraceBuffer* const trace_buffer) override;
+	const char* error_to_text(const RETURN_CODE& return_code) const override;
+
+protected:
+	using Buffer = std::vector<u16, PinnedAllocator<u16>>;
+	DAQParams m_daq_params;
+	int m_channel_count;
+	size_t m_samples_per_buffer;
+	std::vector<Buffer> m_buffers;  // Delivered in turn.
+
+	// Fills m_buffers for the configuration in m_daq_params.
+	virtual bool load_buffers() = 0;
+
+private:
+	bool m_daq_configured;
+	std::atomic<bool> m_daq_running;
+	std::atomic<u32> m_trigger_count;
+	bool m_daq_armed;
+	std::mutex m_armed_mtx;
+	std::condition_variable m_armed_cv;
+};
+
+
+// Synthesized records: each record holds a constant intensity (12 bit codes, left aligned) with a little noise,
+// the intensities are pseudo random and repeat every kSimulatedDAQBuffers buffers.
+class SimulatedDAQ : public EmulatedDAQ {
+protected:
+	bool load_buffers() override;
+};
+
+
+// Plays a recording of RecordingDAQ, from the start again when it ends (unless a single acquisition ends first).
+// The configuration must match the recorded one (records per buffer, samples per record and channels).
+class ReplayDAQ : public EmulatedDAQ {
+public:
+	explicit ReplayDAQ(const std::string& file_name);
+
+protected:
+	bool load_buffers() override;
+
+private:
+	std::string m_file_name;
+};
+
+
+// Records the buffers of another DAQ to a file, before the application processes them.
+// The file starts with a header (magic "IRISDAQ1", u32 records per buffer, samples per record, channels),
+// followed by each buffer (u64 data index, u64 bytes, samples). Writing is on the capture thread, so it slows the cycle.
+class RecordingDAQ : public DAQBackend {
+public:
+	RecordingDAQ(std::unique_ptr<DAQBackend> daq, const std::string& file_name);
+	RETURN_CODE configure(const DAQParams& daq_params) override;
+	RETURN_CODE capture() override;
+	void stop() override;
+	bool wait_for_armed(const u32 timeout_ms) override;
+	bool get_trigger_count(u32* trigger_count) const override;
+	void set_trace_buffer(TraceBuffer* const trace_buffer) override;
+	const char* error_to_text(const RETURN_CODE& return_code) const override;
+
+private:
+	std::unique_ptr<DAQBackend> m_daq;
+	std::string m_file_name;
+	std::ofstream m_file;
+	cb_on_buffer_recv m_on_recv;
+
+	void on_buffer_receive(u16* const data_ptr, const size_t data_len, const u64 data_index);
+};
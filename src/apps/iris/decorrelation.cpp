@@ -0,0 +1,117 @@
+#include <cmath>
+#include "decorrelation.h"
+const f32 kMinCorrelation = 0.05f;  // Weaker correlations are left out of the fit, their log is dominated by noise.
+
+
+DecorrelationEstimator::DecorrelationEstimator() :
+	m_running(false),
+	m_modes(0),
+	m_ring_size(0),
+	m_pushed_count(0),
+	m_analyzed_count(0),
+	m_decorrelation_time_us(-1),
+	m_correlation(-1) {
+}
+
+
+DecorrelationEstimator::~DecorrelationEstimator() {
+	stop();
+}
+
+
+void DecorrelationEstimator::start(const int modes, const int ring_size) {
+	stop();
+	m_modes = modes;
+	m_ring_size = (std::max)(ring_size, 2);
+	m_ring = Eigen::MatrixXcf::Zero(m_modes, m_ring_size);
+	m_ring_time_us.assign(m_ring_size, 0);
+	m_pushed_count = 0;
+	m_analyzed_count = 0;
+	m_decorrelation_time_us = -1;
+	m_correlation = -1;
+	m_running = true;
+	m_thread = std::thread(&DecorrelationEstimator::analyze, this);
+}
+
+
+void DecorrelationEstimator::stop() {
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_running = false;
+	}
+	m_cv.notify_one();
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+
+void DecorrelationEstimator::push(const Eigen::Ref<const Eigen::VectorXcf>& responses, const f64 time_us) {
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (!m_running || (responses.size() != m_modes)) {
+			return;
+		}
+		auto slot = m_pushed_count % m_ring_size;
+		m_ring.col(slot) = responses;
+		m_ring_time_us[slot] = time_us;
+		++m_pushed_count;
+	}
+	m_cv.notify_one();
+}
+
+
+void DecorrelationEstimator::analyze() {
+	// Local copy of the ring, so the hot thread only waits for the copy.
+	auto ring = Eigen::MatrixXcf{m_modes, m_ring_size};
+	auto ring_time_us = std::vector<f64>(m_ring_size);
+	auto inner_products = Eigen::VectorXcf{m_ring_size};
+	auto correlations = Eigen::VectorXf{m_ring_size};
+	while (true) {
+		int pushed_count;
+		{
+			std::unique_lock<std::mutex> lock(m_mtx);
+			m_cv.wait(lock, [this] { return !m_running || (m_pushed_count != m_analyzed_count); });
+			if (!m_running) {
+				return;
+			}
+			pushed_count = m_pushed_count;
+			ring = m_ring;
+			ring_time_us = m_ring_time_us;
+		}
+		m_analyzed_count = pushed_count;
+		if (pushed_count < 2) {
+			continue;
+		}
+
+		// Normalized correlation of the newest responses with each of the older ones: |<r_t, r_t-k>| / (||r_t|| * ||r_t-k||).
+		auto lags = (std::min)(pushed_count, m_ring_size);
+		auto newest_slot = (pushed_count - 1) % m_ring_size;
+		auto newest_norm = ring.col(newest_slot).norm();
+		correlations.setZero();
+		inner_products.head(lags).noalias() = ring.leftCols(lags).adjoint() * ring.col(newest_slot);
+		correlations.head(lags) = inner_products.head(lags).cwiseAbs();
+		for (auto slot = 0; slot < lags; ++slot) {
+			auto norms = newest_norm * ring.col(slot).norm();
+			correlations(slot) = (norms > 0) ? (std::min)(correlations(slot) / norms, 1.0f) : 0.0f;
+		}
+		m_correlation = correlations((pushed_count - 2) % m_ring_size);
+
+		// Least squares fit of ln(correlation) = -dt / decorrelation time through the origin,
+		// decorrelation time = -sum(dt^2) / sum(dt * ln(correlation)).
+		f64 sum_dt2 = 0;
+		f64 sum_dt_log = 0;
+		for (auto lag = 1; lag < lags; ++lag) {
+			auto slot = (pushed_count - 1 - lag) % m_ring_size;
+			auto dt_us = ring_time_us[newest_slot] - ring_time_us[slot];
+			if ((dt_us <= 0) || (correlations(slot) < kMinCorrelation)) {
+				continue;
+			}
+			sum_dt2 += dt_us * dt_us;
+			sum_dt_log += dt_us * std::log(static_cast<f64>(correlations(slot)));
+		}
+		if (sum_dt_log < 0) {
+			m_decorrelation_time_us = -sum_dt2 / sum_dt_log;
+		}
+	}
+}
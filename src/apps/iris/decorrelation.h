@@ -0,0 +1,49 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <condition_variable>
+#include "eigen/Eigen/Dense"
+#include "core0/types.h"
+
+
+// Estimates the decorrelation time of the medium from the mode responses of successive optimization cycles.
+// The responses are kept in a ring and correlated on a worker thread, so pushing them costs only a copy.
+// The correlation between responses dt apart is modeled as exp(-dt / decorrelation time).
+class DecorrelationEstimator {
+public:
+	DecorrelationEstimator();
+	~DecorrelationEstimator();
+
+	// Starts the worker thread for responses of #modes modes, the ring is cleared and holds #ring_size cycles.
+	void start(const int modes, const int ring_size);
+
+	// Stops the worker thread, the last estimate is kept.
+	void stop();
+
+	// Copies the responses of a cycle which ended at time_us to the ring, ignored if not started.
+	void push(const Eigen::Ref<const Eigen::VectorXcf>& responses, const f64 time_us);
+
+	// Latest decorrelation time (us), negative if not known yet.
+	f64 get_decorrelation_time_us() const { return m_decorrelation_time_us; }
+
+	// Latest correlation between consecutive responses in the range [0, 1], negative if not known yet.
+	f64 get_correlation() const { return m_correlation; }
+
+private:
+	std::thread m_thread;
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_running;
+	int m_modes;
+	int m_ring_size;
+	Eigen::MatrixXcf m_ring;  // One column per cycle.
+	std::vector<f64> m_ring_time_us;
+	int m_pushed_count;
+	int m_analyzed_count;
+	std::atomic<f64> m_decorrelation_time_us;
+	std::atomic<f64> m_correlation;
+
+	void analyze();
+};
@@ -0,0 +1,238 @@
+#include <ctime>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include "spdlog/spdlog.h"
+#include "core2/clock.h"
+#include "flight_recorder.h"
+const char kFileMagic[8] = {'I', 'R', 'I', 'S', 'F', 'R', '0', '1'};
+const size_t kFileReasonLength = 32;
+const int kWarmupCycles = 16;  // Cycles which only learn the running means, after the start and after each dump.
+const f64 kMeanWeight = 1.0 / 16;  // Weight of a new cycle in the running means.
+const f64 kLatencyOutlier = 5.0;  // A cycle slower than X times the mean latency is an anomaly.
+const f64 kFocusSignalDrop = 0.5;  // A focus signal below X times its mean is an anomaly.
+const int kMaxDumpsPerRun = 8;  // Automatic dumps, so a misbehaving run doesn't fill the disk.
+
+
+FlightRecorder::FlightRecorder() :
+	m_thread_running(true),
+	m_recording(false),
+	m_frozen(false),
+	m_dump_reason(nullptr),
+	m_dump_count(0),
+	m_buffer_bytes(0),
+	m_buffer_slots(0),
+	m_buffer_count(0),
+	m_modes(0),
+	m_cycle_slots(0),
+	m_cycle_count(0),
+	m_latency_mean_us(0),
+	m_focus_signal_mean(0),
+	m_warmup_cycles(kWarmupCycles),
+	m_latency_warmup_cycles(kWarmupCycles) {
+	m_thread = std::thread(&FlightRecorder::run, this);
+}
+
+
+FlightRecorder::~FlightRecorder() {
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		m_thread_running = false;
+	}
+	m_cv.notify_all();
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+}
+
+
+void FlightRecorder::start(const size_t buffer_bytes, const size_t raw_bytes, const int modes, const int cycles) {
+	// The rings are resized only when the run needs other sizes, a dump in progress finishes first.
+	std::unique_lock<std::mutex> lock(m_mtx);
+	m_cv.wait(lock, [this] { return !m_frozen; });
+	m_buffer_slots = static_cast<int>((std::max)(raw_bytes / (std::max)(buffer_bytes, static_cast<size_t>(1)), static_cast<size_t>(1)));
+	if ((m_buffer_bytes != buffer_bytes) || (m_buffer_data.size() != m_buffer_slots * buffer_bytes)) {
+		m_buffer_bytes = buffer_bytes;
+		m_buffer_data.clear();
+		m_buffer_data.shrink_to_fit();
+		m_buffer_data.resize(m_buffer_slots * m_buffer_bytes);
+	}
+	m_buffer_records.resize(m_buffer_slots);
+	m_modes = modes;
+	m_cycle_slots = (std::max)(cycles, 1);
+	m_cycle_responses.resize(m_modes, m_cycle_slots);
+	m_cycle_columns.resize(kGLVPixels, m_cycle_slots);
+	m_cycle_records.resize(m_cycle_slots);
+	m_buffer_count = 0;
+	m_cycle_count = 0;
+	m_warmup_cycles = kWarmupCycles;
+	m_latency_warmup_cycles = kWarmupCycles;
+	m_dump_count = 0;
+	m_recording = true;
+}
+
+
+void FlightRecorder::stop() {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	m_recording = false;
+}
+
+
+void FlightRecorder::push_buffer(const u16* const data_ptr, const size_t data_len, const u64 data_index, const u64 receive_ticks, const u64 done_ticks) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!m_recording || m_frozen) {
+		return;
+	}
+	auto slot = static_cast<size_t>(m_buffer_count % m_buffer_slots);
+	auto bytes = (std::min)(data_len, m_buffer_bytes);
+	std::memcpy(m_buffer_data.data() + slot * m_buffer_bytes, data_ptr, bytes);
+	m_buffer_records[slot] = BufferRecord{data_index, receive_ticks, done_ticks, bytes};
+	++m_buffer_count;
+}
+
+
+void FlightRecorder::push_cycle(const Eigen::Ref<const Eigen::VectorXcf>& responses, const Eigen::Ref<const GLVColVectorXs>& dac_column, const f64 latency_us, const f32 focus_signal, const u32 loopcycle_wait_us, const bool check_latency) {
+	std::lock_guard<std::mutex> lock(m_mtx);
+	if (!m_recording || m_frozen || (responses.size() != m_modes) || (dac_column.size() != kGLVPixels)) {
+		return;
+	}
+	auto slot = static_cast<int>(m_cycle_count % m_cycle_slots);
+	m_cycle_responses.col(slot) = responses;
+	m_cycle_columns.col(slot) = dac_column;
+	m_cycle_records[slot] = CycleRecord{m_cycle_count, get_clock_ticks(), latency_us, focus_signal, loopcycle_wait_us};
+	++m_cycle_count;
+
+	// The running means are learned over the warmup cycles (plain mean), then follow the cycles slowly.
+	// The latency is learned and checked only over the cycles which check it, the others are recorded as is.
+	// The cycle which triggers a dump is in the dump, and the means are learned again after it.
+	auto latency_warmup = check_latency && (m_latency_warmup_cycles > 0);
+	if (latency_warmup) {
+		m_latency_mean_us += (latency_us - m_latency_mean_us) / (kWarmupCycles - m_latency_warmup_cycles + 1);
+		--m_latency_warmup_cycles;
+	}
+	auto focus_signal_warmup = (m_warmup_cycles > 0);
+	if (focus_signal_warmup) {
+		m_focus_signal_mean += (focus_signal - m_focus_signal_mean) / (kWarmupCycles - m_warmup_cycles + 1);
+		--m_warmup_cycles;
+	}
+	auto latency_checked = check_latency && !latency_warmup;
+	if (latency_checked && (latency_us > kLatencyOutlier * m_latency_mean_us)) {
+		request_dump("latency outlier");
+		return;
+	}
+	if (!focus_signal_warmup && (focus_signal < kFocusSignalDrop * m_focus_signal_mean)) {
+		request_dump("focus signal drop");
+		return;
+	}
+	if (latency_checked) {
+		m_latency_mean_us += kMeanWeight * (latency_us - m_latency_mean_us);
+	}
+	if (!focus_signal_warmup) {
+		m_focus_signal_mean += kMeanWeight * (focus_signal - m_focus_signal_mean);
+	}
+}
+
+
+void FlightRecorder::dump(const char* const reason) {
+	{
+		std::lock_guard<std::mutex> lock(m_mtx);
+		if (m_frozen) {
+			return;
+		}
+		m_frozen = true;
+		m_dump_reason = reason;
+	}
+	m_cv.notify_all();
+}
+
+
+void FlightRecorder::request_dump(const char* const reason) {
+	// Called with the lock held, by the automatic checks.
+	if (m_dump_count >= kMaxDumpsPerRun) {
+		return;
+	}
+	++m_dump_count;
+	m_warmup_cycles = kWarmupCycles;
+	m_latency_warmup_cycles = kWarmupCycles;
+	m_latency_mean_us = 0;
+	m_focus_signal_mean = 0;
+	m_frozen = true;
+	m_dump_reason = reason;
+	m_cv.notify_all();
+}
+
+
+void FlightRecorder::run() {
+	auto file_index = 0;
+	while (true) {
+		const char* reason;
+		{
+			std::unique_lock<std::mutex> lock(m_mtx);
+			m_cv.wait(lock, [this] { return !m_thread_running || m_frozen; });
+			if (!m_thread_running) {
+				return;
+			}
+			reason = m_dump_reason;
+		}
+
+		// The rings are frozen, so they are written without the lock.
+		auto file_name = "flight_recorder_" + std::to_string(std::time(nullptr)) + "_" + std::to_string(file_index++) + ".bin";
+		if (write_file(file_name, reason)) {
+			spdlog::warn("APP: Flight recorder dumped to %s (%s)", file_name, reason);
+		}
+		else {
+			spdlog::error("APP: Failed to write the flight recorder to %s", file_name);
+		}
+		{
+			std::lock_guard<std::mutex> lock(m_mtx);
+			m_frozen = false;
+		}
+		m_cv.notify_all();
+	}
+}
+
+
+bool FlightRecorder::write_file(const std::string& file_name, const char* const reason) const {
+	std::ofstream file{file_name, std::ios::binary};
+	if (!file) {
+		return false;
+	}
+	auto write = [&file](const void* const data, const size_t bytes) {
+		file.write(static_cast<const char*>(data), bytes);
+	};
+
+	// Header.
+	char reason_field[kFileReasonLength] = {};
+	std::strncpy(reason_field, reason ? reason : "", kFileReasonLength - 1);
+	auto ticks_per_usec = get_clock_source().ticks_per_usec;
+	auto dump_ticks = get_clock_ticks();
+	auto buffer_records = static_cast<u32>((std::min)(m_buffer_count, static_cast<u64>(m_buffer_slots)));
+	auto cycle_records = static_cast<u32>((std::min)(m_cycle_count, static_cast<u64>(m_cycle_slots)));
+	auto modes = static_cast<u32>(m_modes);
+	auto glv_pixels = static_cast<u32>(kGLVPixels);
+	write(kFileMagic, sizeof(kFileMagic));
+	write(reason_field, sizeof(reason_field));
+	write(&ticks_per_usec, sizeof(ticks_per_usec));
+	write(&dump_ticks, sizeof(dump_ticks));
+	write(&buffer_records, sizeof(buffer_records));
+	write(&cycle_records, sizeof(cycle_records));
+	write(&modes, sizeof(modes));
+	write(&glv_pixels, sizeof(glv_pixels));
+
+	// Buffers, oldest first, each record is followed by its samples.
+	for (auto record_index = m_buffer_count - buffer_records; record_index < m_buffer_count; ++record_index) {
+		auto slot = static_cast<size_t>(record_index % m_buffer_slots);
+		auto& record = m_buffer_records[slot];
+		write(&record, sizeof(record));
+		write(m_buffer_data.data() + slot * m_buffer_bytes, static_cast<size_t>(record.bytes));
+	}
+
+	// Cycles, oldest first, each record is followed by the responses (real, imaginary interleaved) and the focusing column.
+	for (auto record_index = m_cycle_count - cycle_records; record_index < m_cycle_count; ++record_index) {
+		auto slot = static_cast<int>(record_index % m_cycle_slots);
+		write(&m_cycle_records[slot], sizeof(CycleRecord));
+		write(m_cycle_responses.col(slot).data(), m_modes * sizeof(std::complex<f32>));
+		write(m_cycle_columns.col(slot).data(), kGLVPixels * sizeof(u16));
+	}
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <string>
+#include <condition_variable>
+#include "eigen/Eigen/Dense"
+#include "core0/types.h"
+#include "core2/pinned_memory.h"
+#include "glv/glv_column.h"
+
+
+// Keeps the latest raw DAQ buffers, mode responses, focusing columns and stage timestamps of the optimization in preallocated rings,
+// and dumps them to a binary file when the run misbehaves (DAQ timeout, stalled cycle, latency outlier, focus signal drop) or on request.
+// Recording costs a copy of each buffer and no allocations. The rings are frozen while a dump thread writes them, so the file holds
+// the lead up to the anomaly. See matlab/flight_recorder/read_flight_recorder.m for the file layout.
+class FlightRecorder {
+public:
+	FlightRecorder();
+	~FlightRecorder();
+
+	// Preallocates and clears the rings, then starts recording.
+	// The buffer ring holds as many buffers of #buffer_bytes as fit in #raw_bytes, the cycle ring holds #cycles cycles of #modes responses.
+	void start(const size_t buffer_bytes, const size_t raw_bytes, const int modes, const int cycles);
+
+	// Stops recording, the rings are kept for dump().
+	void stop();
+
+	// Copies a processed buffer and its receive and processing done times (clock ticks, see core2/clock.h).
+	void push_buffer(const u16* const data_ptr, const size_t data_len, const u64 data_index, const u64 receive_ticks, const u64 done_ticks);
+
+	// Copies the responses (channel A) and the focusing column of a cycle, and checks it for anomalies.
+	// latency_us is from the arrival of the last buffer of the cycle until the upload, focus_signal is a measure of the focus intensity
+	// (e.g. the sum of the response magnitudes), a cycle far slower than usual, or with a far weaker focus signal, triggers a dump.
+	// The latency is checked only if check_latency, a cycle which blocks on GLV commands (e.g. a restart of the loop cycle) is expected to be slow.
+	void push_cycle(const Eigen::Ref<const Eigen::VectorXcf>& responses, const Eigen::Ref<const GLVColVectorXs>& dac_column, const f64 latency_us, const f32 focus_signal, const u32 loopcycle_wait_us, const bool check_latency = true);
+
+	// Freezes the rings and writes them on the dump thread, ignored while a dump is in progress.
+	// The reason is a string literal, it is written to the file.
+	void dump(const char* const reason);
+
+private:
+	struct BufferRecord {
+		u64 data_index;
+		u64 receive_ticks;
+		u64 done_ticks;
+		u64 bytes;
+	};
+	struct CycleRecord {
+		u64 cycle_index;
+		u64 end_ticks;
+		f64 latency_us;
+		f32 focus_signal;
+		u32 loopcycle_wait_us;
+	};
+
+	std::thread m_thread;
+	std::mutex m_mtx;
+	std::condition_variable m_cv;
+	bool m_thread_running;
+	bool m_recording;
+	bool m_frozen;  // Set while dumping, pushes are dropped.
+	const char* m_dump_reason;
+	int m_dump_count;
+
+	// Buffer ring.
+	size_t m_buffer_bytes;
+	int m_buffer_slots;
+	u64 m_buffer_count;
+	std::vector<u8, PinnedAllocator<u8>> m_buffer_data;
+	std::vector<BufferRecord> m_buffer_records;
+
+	// Cycle ring.
+	int m_modes;
+	int m_cycle_slots;
+	u64 m_cycle_count;
+	Eigen::MatrixXcf m_cycle_responses;  // One column per cycle.
+	GLVFrameXs m_cycle_columns;
+	std::vector<CycleRecord> m_cycle_records;
+
+	// Anomaly detection, running means of the latency and the focus signal.
+	f64 m_latency_mean_us;
+	f64 m_focus_signal_mean;
+	int m_warmup_cycles;
+	int m_latency_warmup_cycles;  // The checked cycles learn the latency, so it is warmed up on its own.
+
+	void request_dump(const char* const reason);
+	void run();
+	bool write_file(const std::string& file_name, const char* const reason) const;
+};
@@ -4,31 +4,63 @@
 #include <string>
 #include <future>
 #include <fstream>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
 #include "spdlog/spdlog.h"
 #include "iris.h"
-using ModeMatrixTM = Eigen::Matrix<u16, kDAQSamplesPerRecord, kTMInterferencePatternsPerMode>;
-using ModeMatrixIterative = Eigen::Matrix<u16, kDAQSamplesPerRecord, kIterativePhaseStepsPerMode>;
+using RecordMatrix = Eigen::Matrix<u16, Eigen::Dynamic, Eigen::Dynamic>;
 const f32 PI_F32 = 3.1415927f;
 const f32 TWOPI_F32 = 2 * PI_F32;
 
 
-App::App() {	
-	// Allocate a DAQ and a GLV.
-	m_daq = std::make_unique<DAQ>();
-	m_glv = std::make_unique<GLV>();
+App::App(std::unique_ptr<DAQBackend> daq, std::unique_ptr<GLVBackend> glv) :
+	m_daq{std::move(daq)},
+	m_glv{std::move(glv)} {
+
+	// The DAQ and the GLV record their activity to the trace of the app.
+	// The DLLs link core2 statically, so each module calibrates a clock of its own here (on attach) rather than on the cycle path.
+	m_daq->set_trace_buffer(Trace::get_buffer());
+	m_glv->set_trace_buffer(Trace::get_buffer());
+	Trace::set_thread_name("main");
+	get_clock_source();
 
 	// Internal initializations.
 	m_cycle_count = 0;
+	m_buffer_receive_ticks = 0;
 	m_glv_col_period_ns_initial = 20000;
 	m_app_running = false;
 	m_glv_manual_running = false;
 	m_glv_auto_running = false;
 	m_calibration_loaded = false;
 	m_phase_to_dac = nullptr;
+	m_basis_blocks.resize(kModePixelBlocks);
+	m_hadamard_blocks.resize(kModePixelBlocks);
+	m_on_buffer_receive = &App::on_buffer_receive_run_tm_optimization;
+	m_fixed_point_tm = false;
+	m_tm_demodulation_bits = kFixedPointDemodulationBits;
+	m_adaptive_pacing = true;
+	m_rolling_tm_buffers = 0;
+	m_rolling_tm_forgetting = 1.0f;
+	m_online_iterative = false;
+	m_adaptive_tm = false;
+	m_loopcycle_wait_us = kGLVLoopCycleWait_us;
+	reset_loop_cycle_pacing();
 
 	// Determine how many records the DAQ would return with each buffer.
-	m_records_per_buffer_tm = kTMInterferencePatternsPerMode * kModesPerBufferTM;
-	m_records_per_buffer_iterative = kIterativePhaseStepsPerMode * kModesPerBufferIterative;
+	m_tm_patterns_per_mode = kTMInterferencePatternsPerMode_initial;
+	m_records_per_buffer_tm = m_tm_patterns_per_mode * kModesPerBufferTM;
+	m_records_per_buffer_iterative = kRecordsPerBufferIterative;
+
+	m_iterative_phase_steps = kIterativePhaseStepsPerMode_initial;
+	m_modes_per_buffer_iterative = m_records_per_buffer_iterative / m_iterative_phase_steps;
+	m_daq_channels = DAQ_CHANNELS::SINGLE_CHANNEL;
+	m_power_normalization = POWER_NORMALIZATION::NO_NORMALIZATION;
+	m_daq_acquired_channels = get_daq_acquired_channels();
+	m_detected_window_start = -1;
+	m_detected_window_length = 0;
+	set_analysis_window(kAnalysisWindowStart_initial, kAnalysisWindowLength_initial, true);
 
 	// Create the input modes.
 	m_glv_mode_pixel_ratio = PIXEL_RATIO::ONE_TO_ONE;
@@ -133,6 +165,101 @@ void App::extract_calibration_curve(const CALIBRATION_TYPE calibration_type) {
 }
 
 
+void App::detect_analysis_window() {
+	if (m_app_running) {
+		spdlog::error("APP: Already running");
+		return;
+	}
+	spdlog::info("APP: --- Detecting the analysis window for a column period of %dns... ---", m_glv_col_period_ns_initial);
+	m_detected_window_start = -1;
+	m_detected_window_length = 0;
+	m_app_running = true;
+
+	// Each record covers a column period (a trigger that arrives during a record is missed, so don't cross to the next column).
+	auto column_period_samples = static_cast<u32>(m_glv_col_period_ns_initial * kDAQSamplesPerSec * 1e-9);
+	auto samples_per_record = ((column_period_samples - kDAQSamplesPerRecordAlignment) / kDAQSamplesPerRecordAlignment) * kDAQSamplesPerRecordAlignment;
+	if ((column_period_samples < kDAQSamplesPerRecordAlignment) || (samples_per_record < kDAQMinSamplesPerRecord)) {
+		spdlog::error("APP: Column period is too short for the DAQ minimum record");
+		m_app_running = false;
+		return;
+	}
+
+	// DAQ is configured to have all records in one buffer.
+	// Each record corresponds to one GLV column.
+	DAQParams m_daqparams;
+	const auto on_m_daqbuffer_recv = std::bind(&App::on_buffer_receive_detect_analysis_window, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	const auto on_m_daqtimeout = std::bind(&App::on_daq_timeout, this);
+	m_daqparams.records_per_buffer = static_cast<u32>(2 * kWindowDetectionColumnPairs);
+	m_daqparams.samples_per_record = samples_per_record;
+	m_daqparams.buffers_per_acquisition = 1;
+	m_daqparams.acquisition_mode = DAQParams::ACQUISTION_SINGLE;
+	m_daqparams.trigger_delay_sec = 0;
+	m_daqparams.voltage_range = INPUT_RANGE_PM_1_V;
+	m_daqparams.on_recv = on_m_daqbuffer_recv;
+	m_daqparams.on_timeout = on_m_daqtimeout;
+
+	// GLV configuration.
+	GLVParams m_glvparams;
+	const auto on_m_glvserial_recv = std::bind(&App::on_glv_serial_receive, this, std::placeholders::_1, std::placeholders::_2);
+	m_glvparams.com_port = kGLVComPort;
+	m_glvparams.trigger_auto = false;
+	m_glvparams.vddah = kGLVvddah;
+	m_glvparams.col_period_ns = m_glv_col_period_ns_initial;
+	m_glvparams.on_recv = on_m_glvserial_recv;
+
+	// Configures the DAQ and the GLV.
+	if (!configure(&m_daqparams, &m_glvparams)) {
+		spdlog::error("APP: Detecting the analysis window failed");
+		m_app_running = false;
+		return;
+	}
+
+	// Alternate between a flat column and the grating with the highest amplitude, so each record starts with a step.
+	auto voltage_gratings = create_voltage_gratings();
+	auto alternating_columns = GLVFrameXs{kGLVPixels, 2 * kWindowDetectionColumnPairs};
+	for (auto pair_index = 0; pair_index < kWindowDetectionColumnPairs; ++pair_index) {
+		alternating_columns.col(2 * pair_index) = voltage_gratings.col(kGLVMaxAmp);
+		alternating_columns.col(2 * pair_index + 1) = voltage_gratings.col(kGLVMinAmp);
+	}
+	if (!m_glv->preload(alternating_columns)) {
+		spdlog::error("APP: Detecting the analysis window failed");
+		m_app_running = false;
+		return;
+	}
+
+	// Start the DAQ capture and cycle once, after the DAQ is armed (triggers which arrive before are lost).
+	std::promise<RETURN_CODE> capture_return_promise;
+	std::future<RETURN_CODE> capture_return_future = capture_return_promise.get_future();
+	m_daq_thread = std::thread{ [&] {capture_return_promise.set_value_at_thread_exit(m_daq->capture()); } };
+	if (!m_daq->wait_for_armed(kDAQArmTimeout_ms)) {
+		spdlog::error("APP: DAQ failed to arm");
+		spdlog::error("APP: Detecting the analysis window failed");
+		m_daq->stop();
+	}
+	else if (!m_glv->cycle(0, 2 * kWindowDetectionColumnPairs - 1)) {
+		spdlog::error("APP: Detecting the analysis window failed");
+	}
+
+	// Clean up.
+	capture_return_future.wait();
+	auto capture_return_code = capture_return_future.get();
+	if (capture_return_code != ApiSuccess) {
+		spdlog::error("APP: DAQ failed with status %s", m_daq->error_to_text(capture_return_code));
+		spdlog::error("APP: Detecting the analysis window failed");
+	}
+	if (m_daq_thread.joinable()) {
+		m_daq_thread.join();
+	}
+	m_app_running = false;
+
+	// Apply the detected window.
+	if (m_detected_window_start >= 0) {
+		set_analysis_window(m_detected_window_start, m_detected_window_length);
+		spdlog::info("APP: --- Analysis window is ready ---");
+	}
+}
+
+
 void App::run_tm_optimization() {
 	if (m_app_running) {
 		spdlog::error("APP: Already running");
@@ -146,18 +273,44 @@ void App::run_tm_optimization() {
 
 	// One cycle of the optimization requires cycling through #m_buffer_count_per_cycle buffers.
 	// This is required for the DAQ buffer receive callback in order to know how many buffer to process per cycle.
-	m_buffer_count_per_cycle = m_input_modes / kModesPerBufferTM;
+	// In the rolling optimization, a cycle covers only the buffers of the rolling window.
+	if ((m_rolling_tm_buffers > 0) && ((m_tm_buffer_count % m_rolling_tm_buffers) != 0)) {
+		spdlog::error("APP: The rolling TM window (%d buffers) must divide the %d buffers of a TM cycle", m_rolling_tm_buffers, m_tm_buffer_count);
+		return;
+	}
+	// In the adaptive optimization, the number of buffers in a cycle changes whenever the schedule is rebuilt.
+	if (m_adaptive_tm && (m_tm_buffer_count < 2)) {
+		spdlog::error("APP: The adaptive TM optimization requires at least 2 mode groups");
+		return;
+	}
+	m_buffer_count_per_cycle = (m_rolling_tm_buffers > 0) ? m_rolling_tm_buffers : m_tm_buffer_count;
+
+	// Start from the initial (safe) loop cycle wait, the pacing tunes it during the optimization.
+	m_loopcycle_wait_us = kGLVLoopCycleWait_us;
+	reset_loop_cycle_pacing();
 
 	// DAQ is configured to have #m_records_per_buffer_tm records in one buffer.
 	// Each record corresponds to one GLV column.
 	DAQParams m_daqparams;
-	const auto on_m_daqbuffer_recv = std::bind(&App::on_buffer_receive_run_tm_optimization, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	m_on_buffer_receive = &App::on_buffer_receive_run_tm_optimization;
+	if (m_rolling_tm_buffers > 0) {
+		m_on_buffer_receive = &App::on_buffer_receive_run_rolling_tm_optimization;
+	}
+	else if (m_adaptive_tm) {
+		m_on_buffer_receive = &App::on_buffer_receive_run_adaptive_tm_optimization;
+	}
+	else if (use_fixed_point_tm()) {
+		m_on_buffer_receive = &App::on_buffer_receive_run_fixed_point_tm_optimization;
+		create_fixed_point_tm_demodulation_matrix();
+	}
+	const auto on_m_daqbuffer_recv = std::bind(&App::on_buffer_receive_guarded, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 	const auto on_m_daqtimeout = std::bind(&App::on_daq_timeout, this);
 	m_daqparams.records_per_buffer = static_cast<u32>(m_records_per_buffer_tm);
-	m_daqparams.samples_per_record = kDAQSamplesPerRecord;
+	m_daqparams.samples_per_record = m_daq_samples_per_record;
 	m_daqparams.acquisition_mode = DAQParams::ACQUISTION_NORMAL;
-	m_daqparams.trigger_delay_sec = 0;
+	m_daqparams.trigger_delay_sec = m_daq_trigger_delay_samples / kDAQSamplesPerSec;
 	m_daqparams.voltage_range = INPUT_RANGE_PM_1_V;
+	m_daqparams.channel_mask = (m_daq_acquired_channels > 1) ? (CHANNEL_A | CHANNEL_B) : CHANNEL_A;
 	m_daqparams.on_recv = on_m_daqbuffer_recv;
 	m_daqparams.on_timeout = on_m_daqtimeout;
 
@@ -167,7 +320,7 @@ void App::run_tm_optimization() {
 	m_glvparams.com_port = kGLVComPort;
 	m_glvparams.trigger_auto = false;
 	m_glvparams.vddah = kGLVvddah;
-	m_glvparams.loopcycle_wait_us = kGLVLoopCycleWait_us;
+	m_glvparams.loopcycle_wait_us = m_loopcycle_wait_us;
 	m_glvparams.col_period_ns = m_glv_col_period_ns_initial;
 	m_glvparams.on_recv = on_m_glvserial_recv;
 
@@ -176,6 +329,8 @@ void App::run_tm_optimization() {
 	spdlog::info("APP: --- Running the TM optimization... ---");
 	print_configuration(OPTIMIZATION_ALGORITHM::TM);
 	auto columns_to_preload = create_preloaded_phase_columns_for_tm_optimization(false);
+	allocate_cycle_buffers(m_records_per_buffer_tm, kModesPerBufferTM, m_adaptive_tm ? (m_input_modes * m_tm_patterns_per_mode) : 0);
+	m_flight_recorder.start(sizeof(u16) * m_daq_samples_per_record * m_records_per_buffer_tm * m_daq_acquired_channels, kFlightRecorderRawBytes, m_input_modes, kFlightRecorderCycles);
 	m_app_running = true;
 
 	// Configures the DAQ and the GLV.
@@ -192,20 +347,34 @@ void App::run_tm_optimization() {
 		m_app_running = false;
 		return;
 	}
+
+	// In the rolling optimization, the loop cycle runs through the columns of the rolling window, starting from the first modes.
+	// The adaptive optimization starts with a cycle through all the modes (as preloaded), which gives the first schedule.
+	m_tm_mode_responses = Eigen::MatrixXcf::Zero(m_input_modes, kDAQChannelsMax);
+	m_tm_mode_magnitudes = Eigen::VectorXf::Zero(m_input_modes);
+	if (m_adaptive_tm) {
+		reset_adaptive_tm();
+	}
+	if (m_rolling_tm_buffers > 0) {
+		m_rolling_tm_first_buffer = 0;
+		m_glv->set_loop_cycle_range(0, static_cast<u16>(m_records_per_buffer_tm * m_buffer_count_per_cycle - 1));
+	}
 	
 	// Start the DAQ capture.
 	std::promise<RETURN_CODE> capture_return_promise;
 	std::future<RETURN_CODE> capture_return_future = capture_return_promise.get_future();
 	m_daq_thread = std::thread{ [&] {capture_return_promise.set_value_at_thread_exit(m_daq->capture()); }};
-	Sleep(1000);
-#ifdef m_daqWORKAROUND
-	m_daqworkaround_first_buffer_flag_ = true;
-	m_glv->cycle(0, kModesPerBufferTM * kTMInterferencePatternsPerMode);
-#endif
 
-	// Start the GLV loop cycle.
-	m_hpc.start();
-	m_glv->run_loop_cycle();
+	// The responses of channel A are correlated across the sweeps on a thread of their own, off the DAQ callback.
+	m_decorrelation.start(m_input_modes, kDecorrelationRingSize);
+	m_decorrelation_hpc.start();
+
+	// Start the GLV loop cycle once the DAQ is armed, and watch for stalled cycles while capturing.
+	if (start_synchronized_loop_cycle(m_records_per_buffer_tm)) {
+		while (capture_return_future.wait_for(std::chrono::milliseconds(kCycleStallCheck_ms)) != std::future_status::ready) {
+			check_for_stalled_cycle();
+		}
+	}
 
 	// Clean-up.
 	capture_return_future.wait();
@@ -217,6 +386,9 @@ void App::run_tm_optimization() {
 		m_daq_thread.join();
 	}
 	m_glv->stop_loop_cycle();
+	m_decorrelation.stop();
+	m_flight_recorder.stop();
+	report_cycle_allocations();
 	m_app_running = false;
 	m_algorithm_on_last_run = OPTIMIZATION_ALGORITHM::TM;
 	if (capture_return_code == ApiSuccess) {
@@ -241,18 +413,25 @@ void App::run_iterative_optimization(const bool use_previous_solution) {
 
 	// One cycle of the optimization requires cycling through #m_buffer_count_per_cycle buffers.
 	// This is required for the DAQ buffer receive callback in order to know how many buffer to process per cycle.
-	m_buffer_count_per_cycle = m_input_modes / kModesPerBufferIterative;
+	// In the online optimization, a cycle covers only the preloaded banks (see reset_online_iterative).
+	m_buffer_count_per_cycle = m_input_modes / m_modes_per_buffer_iterative;
+
+	// Start from the initial (safe) loop cycle wait, the pacing tunes it during the optimization.
+	m_loopcycle_wait_us = kGLVLoopCycleWait_us;
+	reset_loop_cycle_pacing();
 
 	// DAQ is configured to have #m_records_per_buffer_iterative records in one buffer.
 	// Each record corresponds to one GLV column.
 	DAQParams m_daqparams;
-	const auto on_m_daqbuffer_recv = std::bind(&App::on_buffer_receive_run_iterative_optimization, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
+	m_on_buffer_receive = m_online_iterative ? &App::on_buffer_receive_run_online_iterative_optimization : &App::on_buffer_receive_run_iterative_optimization;
+	const auto on_m_daqbuffer_recv = std::bind(&App::on_buffer_receive_guarded, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 	const auto on_m_daqtimeout = std::bind(&App::on_daq_timeout, this);
 	m_daqparams.records_per_buffer = static_cast<u32>(m_records_per_buffer_iterative);
-	m_daqparams.samples_per_record = kDAQSamplesPerRecord;
+	m_daqparams.samples_per_record = m_daq_samples_per_record;
 	m_daqparams.acquisition_mode = DAQParams::ACQUISTION_NORMAL;
-	m_daqparams.trigger_delay_sec = 0;
+	m_daqparams.trigger_delay_sec = m_daq_trigger_delay_samples / kDAQSamplesPerSec;
 	m_daqparams.voltage_range = INPUT_RANGE_PM_1_V;
+	m_daqparams.channel_mask = (m_daq_acquired_channels > 1) ? (CHANNEL_A | CHANNEL_B) : CHANNEL_A;
 	m_daqparams.on_recv = on_m_daqbuffer_recv;
 	m_daqparams.on_timeout = on_m_daqtimeout;
 
@@ -262,7 +441,7 @@ void App::run_iterative_optimization(const bool use_previous_solution) {
 	m_glvparams.com_port = kGLVComPort;
 	m_glvparams.trigger_auto = false;
 	m_glvparams.vddah = kGLVvddah;
-	m_glvparams.loopcycle_wait_us = kGLVLoopCycleWait_us;
+	m_glvparams.loopcycle_wait_us = m_loopcycle_wait_us;
 	m_glvparams.col_period_ns = m_glv_col_period_ns_initial;
 	m_glvparams.on_recv = on_m_glvserial_recv;
 
@@ -270,7 +449,12 @@ void App::run_iterative_optimization(const bool use_previous_solution) {
 	spdlog::info("");
 	spdlog::info("APP: --- Running the Iterative optimization... ---");
 	print_configuration(OPTIMIZATION_ALGORITHM::ITERATIVE);
+	if (m_daq_channels == DAQ_CHANNELS::DUAL_CHANNEL) {
+		spdlog::info("APP: Dual channel acquisition is only used in the TM optimization, using channel A");
+	}
 	auto columns_to_preload = create_preloaded_phase_columns_for_iterative_optimization(use_previous_solution, false);
+	allocate_cycle_buffers(m_records_per_buffer_iterative, m_modes_per_buffer_iterative, m_online_iterative ? (m_records_per_buffer_iterative * m_buffer_count_per_cycle) : 0);
+	m_flight_recorder.start(sizeof(u16) * m_daq_samples_per_record * m_records_per_buffer_iterative * m_daq_acquired_channels, kFlightRecorderRawBytes, m_input_modes, kFlightRecorderCycles);
 	m_app_running = true;
 
 	// Configures the DAQ and the GLV.
@@ -281,7 +465,16 @@ void App::run_iterative_optimization(const bool use_previous_solution) {
 	}
 
 	// Preload the fixed columns to the GLV.
-	if (!m_glv->preload(convert_phase_to_glv_dac_column(columns_to_preload))) {
+	// In the online optimization, only the banks of the first mode groups are preloaded.
+	auto dac_columns_to_preload = GLVFrameXs{};
+	if (m_online_iterative) {
+		reset_online_iterative();
+		dac_columns_to_preload = create_online_iterative_dac_columns();
+	}
+	else {
+		dac_columns_to_preload = convert_phase_to_glv_dac_column(columns_to_preload);
+	}
+	if (!m_glv->preload(dac_columns_to_preload)) {
 		spdlog::error("APP: Failed to preload the GLV");
 		spdlog::error("APP: --- Optimization stopped ---");
 		m_app_running = false;
@@ -292,15 +485,13 @@ void App::run_iterative_optimization(const bool use_previous_solution) {
 	std::promise<RETURN_CODE> capture_return_promise;
 	std::future<RETURN_CODE> capture_return_future = capture_return_promise.get_future();
 	m_daq_thread = std::thread{ [&] {capture_return_promise.set_value_at_thread_exit(m_daq->capture()); }};
-	Sleep(1000);
-#ifdef m_daqWORKAROUND
-	m_daqworkaround_first_buffer_flag_ = true;
-	m_glv->cycle(0, kModesPerBufferIterative * kIterativePhaseStepsPerMode);
-#endif
 
-	// Start the GLV loop cycle.
-	m_hpc.start();
-	m_glv->run_loop_cycle();
+	// Start the GLV loop cycle once the DAQ is armed, and watch for stalled cycles while capturing.
+	if (start_synchronized_loop_cycle(m_records_per_buffer_iterative)) {
+		while (capture_return_future.wait_for(std::chrono::milliseconds(kCycleStallCheck_ms)) != std::future_status::ready) {
+			check_for_stalled_cycle();
+		}
+	}
 
 	// Clean-up.
 	capture_return_future.wait();
@@ -312,6 +503,8 @@ void App::run_iterative_optimization(const bool use_previous_solution) {
 		m_daq_thread.join();
 	}
 	m_glv->stop_loop_cycle();
+	m_flight_recorder.stop();
+	report_cycle_allocations();
 	m_app_running = false;
 	m_algorithm_on_last_run = OPTIMIZATION_ALGORITHM::ITERATIVE;
 	if (capture_return_code == ApiSuccess) {
@@ -377,7 +570,7 @@ void App::cycle_custom_columns(const CYCLE_TYPE cycle_type, const CUSTOM_COLUMN_
 			m_app_running = false;
 			return;
 		}
-		last_column_index = m_input_modes * kTMInterferencePatternsPerMode - 1;
+		last_column_index = m_input_modes * m_tm_patterns_per_mode - 1;
 	}
 
 	// For the Iterative optimization, load phase to DAC calibration for the GLV, create the preloaded phase columns and preload.
@@ -396,7 +589,7 @@ void App::cycle_custom_columns(const CYCLE_TYPE cycle_type, const CUSTOM_COLUMN_
 			m_app_running = false;
 			return;
 		}
-		last_column_index = m_input_modes * kIterativePhaseStepsPerMode - 1;
+		last_column_index = m_input_modes * m_iterative_phase_steps - 1;
 	}
 
 	// For the voltage gratings, we only need to preload.
@@ -539,7 +732,11 @@ void App::stop(const bool silent) {
 }
 
  
-void App::display_solution(const bool ramp_repetitive) {
+void App::display_solution(const bool ramp_repetitive, const int channel) {
+	if ((channel < 0) || (channel >= kDAQChannelsMax)) {
+		spdlog::error("APP: Illegal DAQ channel");
+		return;
+	}
 	if (m_app_running) {
 		stop();
 		m_glv->stop_loop_cycle();
@@ -557,14 +754,25 @@ void App::display_solution(const bool ramp_repetitive) {
 		}
 	}
 
-	if (!ramp_repetitive) {
-		int focusing_pattern_index;
-		if (m_algorithm_on_last_run == OPTIMIZATION_ALGORITHM::TM) {
-			focusing_pattern_index = m_input_modes * kTMInterferencePatternsPerMode;
-		}
-		if (m_algorithm_on_last_run == OPTIMIZATION_ALGORITHM::ITERATIVE) {
-			focusing_pattern_index = m_input_modes * kIterativePhaseStepsPerMode;
-		}
+	// The focusing column follows the preloaded columns of the last run.
+	int focusing_pattern_index = 0;
+	if (m_algorithm_on_last_run == OPTIMIZATION_ALGORITHM::TM) {
+		focusing_pattern_index = m_input_modes * m_tm_patterns_per_mode;
+	}
+	if (m_algorithm_on_last_run == OPTIMIZATION_ALGORITHM::ITERATIVE) {
+		focusing_pattern_index = m_input_modes * m_iterative_phase_steps;
+	}
+
+	// Only the solution of channel A is loaded to the focusing column during the optimization.
+	// The solution of any other channel is loaded to the free column after it, so the preloaded columns and the
+	// focusing column of channel A are kept for the next display or run.
+	if (!ramp_repetitive && (channel != 0)) {
+		auto channel_pattern_index = static_cast<u16>(focusing_pattern_index + channel);
+		m_glv->load_columns(channel_pattern_index, convert_phase_to_glv_dac_column(Eigen::MatrixXf{m_final_phase_columns.col(channel)}));
+		m_glv->cycle(channel_pattern_index, channel_pattern_index);
+		spdlog::info("APP: Displaying focusing column of channel B");
+	}
+	else if (!ramp_repetitive) {
 		m_glv->cycle(focusing_pattern_index, focusing_pattern_index);
 		spdlog::info("APP: Displaying focusing column");
 	}
@@ -573,7 +781,7 @@ void App::display_solution(const bool ramp_repetitive) {
 		auto final_phase_ramped_frame = Eigen::MatrixXf{kGLVPixels, ramp_steps};
 		for (auto col_index = 0; col_index < ramp_steps; ++col_index) {
 			auto add_fraction = (col_index / static_cast<f32>(ramp_steps)) * TWOPI_F32;
-			final_phase_ramped_frame.col(col_index) = m_final_phase_column.array() + add_fraction;
+			final_phase_ramped_frame.col(col_index) = m_final_phase_columns.col(channel).array() + add_fraction;
 			//final_phase_ramped_frame.col(col_index).fill(add_fraction);  // FIXME, for testing purposes, display constant phase columns.
 			
 			// Original phase values are between [-PI, PI], after ramp, the range becomes [-PI, 3PI].
@@ -639,6 +847,7 @@ void App::set_glv_column_period(const u32 col_period_ns) {
 		return;
 	}
 	auto success = m_glv->set_column_period(col_period_ns);
+	reset_loop_cycle_pacing();
 	if (success) {
 		spdlog::info("APP: Column period was set to %dns", col_period_ns);
 	}
@@ -654,12 +863,13 @@ void App::set_tm_fixed_segment(const FIXED_SEGMENT segment, const bool final_ref
 		return;
 	}
 	m_fixed_segment = segment;
+	Eigen::VectorXf final_phase_column;
 
 	// The reference is fixed at 0 during the entire optimization (including the final phase column.)
 	// Set the phase of the reference for the final phase column.
 	if (segment == FIXED_SEGMENT::REFERENCE_AT_ZERO) {
-		m_final_phase_column = Eigen::VectorXf::Ones(kGLVPixels, 1);
-		m_final_phase_column = m_final_phase_column.array() * 1;
+		final_phase_column = Eigen::VectorXf::Ones(kGLVPixels, 1);
+		final_phase_column = final_phase_column.array() * 1;
 		if (!silent) {
 			spdlog::info("APP: Reference is fixed at phase 0 during measurement");
 		}
@@ -667,8 +877,8 @@ void App::set_tm_fixed_segment(const FIXED_SEGMENT segment, const bool final_ref
 
 	// The reference is fixed at PI during the entire optimization (including the final phase column.)
 	if (segment == FIXED_SEGMENT::REFERENCE_AT_PI) {
-		m_final_phase_column = Eigen::VectorXf::Ones(kGLVPixels, 1);
-		m_final_phase_column = m_final_phase_column.array() * PI_F32;
+		final_phase_column = Eigen::VectorXf::Ones(kGLVPixels, 1);
+		final_phase_column = final_phase_column.array() * PI_F32;
 		if (!silent) {
 			spdlog::info("APP: Reference is fixed at phase PI during measurement");
 		}
@@ -677,7 +887,7 @@ void App::set_tm_fixed_segment(const FIXED_SEGMENT segment, const bool final_ref
 	// Signal is fixed.
 	// For the final phase pattern, we will have the reference at 0, otherwise, the reference changes.
 	if (segment == FIXED_SEGMENT::MODE) {
-		m_final_phase_column = Eigen::VectorXf::Zero(kGLVPixels, 1);
+		final_phase_column = Eigen::VectorXf::Zero(kGLVPixels, 1);
 		if (!silent) {
 			spdlog::info("APP: Signal is fixed");
 		}
@@ -685,7 +895,7 @@ void App::set_tm_fixed_segment(const FIXED_SEGMENT segment, const bool final_ref
 		// If this is true, the reference on the final phase column will be a grating.
 		if (final_reference_is_grating) {
 			for (auto pixel_index = 0; pixel_index < kGLVPixels; pixel_index += 2) {
-				m_final_phase_column(pixel_index) = PI_F32;
+				final_phase_column(pixel_index) = PI_F32;
 			}				
 			if (!silent) {			
 				spdlog::info("APP: Reference during focusing is a high frequency grating");
@@ -698,6 +908,11 @@ void App::set_tm_fixed_segment(const FIXED_SEGMENT segment, const bool final_ref
 		}
 	}
 
+	// All the channels share the same reference.
+	m_final_phase_columns = final_phase_column.replicate(1, kDAQChannelsMax);
+
+	// The sign of the extracted response depends on which segment is fixed.
+	create_tm_demodulation_matrix();
 }
 
 
@@ -709,8 +924,8 @@ void App::set_num_of_input_modes(const int input_modes, const bool silent) {
 	// 4.Number of input modes must be smaller than the number of GLV pixels.
 	if (
 		  (input_modes <= 0) ||
-		  (((input_modes * kTMInterferencePatternsPerMode) % kModesPerBufferTM) != 0) ||
-		  (((input_modes * kIterativePhaseStepsPerMode) % kModesPerBufferIterative) != 0) ||
+		  ((input_modes % kModesPerBufferTM) != 0) ||
+		  ((input_modes % m_modes_per_buffer_iterative) != 0) ||
 		  ((input_modes & (input_modes - 1)) != 0) 
 	) {
 		spdlog::error("APP: Number of input modes is illegal");
@@ -720,6 +935,10 @@ void App::set_num_of_input_modes(const int input_modes, const bool silent) {
 		spdlog::error("APP: Could not set the number of input modes to %d, \"GLV to mode\" pixel ratio * #input modes > %d pixels", input_modes, kGLVPixels);
 		return;
 	}
+	if (m_online_iterative && ((input_modes / m_modes_per_buffer_iterative) < kOnlineIterativeBanks)) {
+		spdlog::error("APP: Could not set the number of input modes to %d, the online iterative optimization requires at least %d mode groups", input_modes, kOnlineIterativeBanks);
+		return;
+	}
 	if (m_app_running) {
 		spdlog::error("APP: Running, stop in order to change the configuration");
 		return;
@@ -728,9 +947,12 @@ void App::set_num_of_input_modes(const int input_modes, const bool silent) {
 	// For a complete basis, the number of pixels required is equal to the number of modes.
 	m_input_modes = input_modes;
 	m_pixels_per_mode = m_input_modes * m_glv_mode_pixel_ratio;
+	m_tm_buffer_count = m_input_modes / kModesPerBufferTM;
 
-	// The pattern includes only the mode (column without reference).
-	m_final_cartesian_pattern = Eigen::VectorXcf::Zero(m_pixels_per_mode, 1);
+	// The pattern includes only the mode (column without reference), in mode space.
+	m_final_cartesian_patterns.resize(m_input_modes, kDAQChannelsMax);
+	m_final_patterns_real_fixed_point = Eigen::MatrixXi::Zero(m_input_modes, kDAQChannelsMax);
+	m_final_patterns_imag_fixed_point = Eigen::MatrixXi::Zero(m_input_modes, kDAQChannelsMax);
 
 	// In a GLV column, find the pixel index where the mode starts.
 	m_mode_start_pixel = (kGLVPixels - m_pixels_per_mode) >> 1;
@@ -761,7 +983,48 @@ void App::set_glv_mode_pixel_ratio(const PIXEL_RATIO ratio) {
 
 
 void App::set_tm_optimization_phase_steps(const PHASE_STEPS phase_steps) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return;
+	}
 	m_phase_steps = phase_steps;
+	create_tm_demodulation_matrix();
+}
+
+
+bool App::set_tm_interference_patterns_per_mode(const TM_INTERFERENCE_PATTERNS patterns) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return false;
+	}
+	m_tm_patterns_per_mode = patterns;
+	m_records_per_buffer_tm = m_tm_patterns_per_mode * kModesPerBufferTM;
+	create_tm_demodulation_matrix();
+	spdlog::info("APP: Number of interference patterns per mode for the TM optimization was changed to %d", m_tm_patterns_per_mode);
+	return true;
+}
+
+
+bool App::set_iterative_optimization_phase_steps(const ITERATIVE_PHASE_STEPS phase_steps) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return false;
+	}
+
+	// All the phase steps of a mode must be in the same buffer, and the buffers must divide the number of input modes.
+	auto modes_per_buffer = m_records_per_buffer_iterative / phase_steps;
+	if ((m_input_modes % modes_per_buffer) != 0) {
+		spdlog::error("APP: Could not set the number of phase steps to %d, #input modes must be a multiple of %d", phase_steps, modes_per_buffer);
+		return false;
+	}
+	if (m_online_iterative && ((m_input_modes / modes_per_buffer) < kOnlineIterativeBanks)) {
+		spdlog::error("APP: Could not set the number of phase steps to %d, the online iterative optimization requires at least %d mode groups", phase_steps, kOnlineIterativeBanks);
+		return false;
+	}
+	m_iterative_phase_steps = phase_steps;
+	m_modes_per_buffer_iterative = modes_per_buffer;
+	spdlog::info("APP: Number of phase steps per mode for the iterative optimization was changed to %d", m_iterative_phase_steps);
+	return true;
 }
 
 
@@ -772,15 +1035,210 @@ void App::set_basis_type(const INPUT_MODE_BASIS input_mode_basis) {
 	}
 	m_input_mode_basis = input_mode_basis;
 	set_num_of_input_modes(m_input_modes, true);
-	if (input_mode_basis == HADAMARD) {
+	if (input_mode_basis == INPUT_MODE_BASIS::HADAMARD) {
 		spdlog::info("APP: Input mode basis was set to Hadamard");
 	}
-	if (input_mode_basis == FOURIER) {
+	if (input_mode_basis == INPUT_MODE_BASIS::FOURIER) {
 		spdlog::info("APP: Input mode basis was set to Fourier");
 	}
 }
 
 
+bool App::set_rolling_tm(const int buffers, const f32 forgetting) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return false;
+	}
+	if ((buffers < 0) || ((buffers > 0) && ((m_tm_buffer_count % buffers) != 0))) {
+		spdlog::error("APP: Could not set the rolling TM window to %d buffers, it must divide the %d buffers of a TM cycle", buffers, m_tm_buffer_count);
+		return false;
+	}
+	if ((forgetting <= 0) || (forgetting > 1.0f)) {
+		spdlog::error("APP: Forgetting factor must be in the range (0, 1]");
+		return false;
+	}
+	if ((buffers > 0) && m_adaptive_tm) {
+		spdlog::error("APP: The rolling TM optimization can't be used with the adaptive TM optimization");
+		return false;
+	}
+	m_rolling_tm_buffers = buffers;
+	m_rolling_tm_forgetting = forgetting;
+	if (m_rolling_tm_buffers > 0) {
+		spdlog::info("APP: Rolling TM optimization is enabled, updating every %d buffers with a forgetting factor of %f", m_rolling_tm_buffers, m_rolling_tm_forgetting);
+	}
+	else {
+		spdlog::info("APP: Rolling TM optimization is disabled");
+	}
+	return true;
+}
+
+
+bool App::set_adaptive_tm(const bool adaptive_tm) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return false;
+	}
+	if (adaptive_tm && (m_rolling_tm_buffers > 0)) {
+		spdlog::error("APP: The adaptive TM optimization can't be used with the rolling TM optimization");
+		return false;
+	}
+	if (adaptive_tm && (m_tm_buffer_count < 2)) {
+		spdlog::error("APP: The adaptive TM optimization requires at least 2 mode groups");
+		return false;
+	}
+	m_adaptive_tm = adaptive_tm;
+	if (m_adaptive_tm) {
+		spdlog::info("APP: Adaptive TM optimization is enabled");
+	}
+	else {
+		spdlog::info("APP: Adaptive TM optimization is disabled");
+	}
+	return true;
+}
+
+
+bool App::set_fixed_point_tm(const bool fixed_point_tm) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return false;
+	}
+	m_fixed_point_tm = fixed_point_tm;
+	if (m_fixed_point_tm) {
+		spdlog::info("APP: Fixed point TM optimization is enabled (Hadamard basis without power normalization)");
+	}
+	else {
+		spdlog::info("APP: Fixed point TM optimization is disabled");
+	}
+	return true;
+}
+
+
+bool App::set_online_iterative(const bool online_iterative) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return false;
+	}
+	if (online_iterative && ((m_input_modes / m_modes_per_buffer_iterative) < kOnlineIterativeBanks)) {
+		spdlog::error("APP: The online iterative optimization requires at least %d mode groups", kOnlineIterativeBanks);
+		return false;
+	}
+	m_online_iterative = online_iterative;
+	if (m_online_iterative) {
+		spdlog::info("APP: Online iterative optimization is enabled");
+	}
+	else {
+		spdlog::info("APP: Online iterative optimization is disabled");
+	}
+	return true;
+}
+
+
+void App::set_adaptive_pacing(const bool adaptive_pacing) {
+	m_adaptive_pacing = adaptive_pacing;
+	reset_loop_cycle_pacing();
+	if (m_adaptive_pacing) {
+		spdlog::info("APP: Adaptive loop cycle pacing is enabled");
+	}
+	else {
+		spdlog::info("APP: Adaptive loop cycle pacing is disabled");
+	}
+}
+
+
+void App::set_analysis_window(const int window_start, const int window_length, const bool silent) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return;
+	}
+	if ((window_start < 0) || (window_length <= 0)) {
+		spdlog::error("APP: Analysis window is illegal");
+		return;
+	}
+	m_analysis_window_start = window_start;
+	m_analysis_window_length = window_length;
+
+	// Only capture what's required for the analysis window.
+	DAQ::fit_record_to_window(m_analysis_window_start, m_analysis_window_length, &m_daq_trigger_delay_samples, &m_daq_samples_per_record, &m_analysis_window_offset);
+	auto column_period_samples = static_cast<u32>(m_glv_col_period_ns_initial * kDAQSamplesPerSec * 1e-9);
+	if ((m_daq_trigger_delay_samples + m_daq_samples_per_record) > column_period_samples) {
+		spdlog::warn("APP: DAQ record ends after the column period (%d samples), triggers will be missed", column_period_samples);
+	}
+	if (!silent) {
+		spdlog::info("APP: Analysis window was set to samples %d-%d", m_analysis_window_start, m_analysis_window_start + m_analysis_window_length - 1);
+		spdlog::info("APP: DAQ record is %d samples with a trigger delay of %d samples", m_daq_samples_per_record, m_daq_trigger_delay_samples);
+	}
+}
+
+
+bool App::set_daq_channels(const DAQ_CHANNELS channels) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return false;
+	}
+	if ((channels == DAQ_CHANNELS::DUAL_CHANNEL) && (m_power_normalization != POWER_NORMALIZATION::NO_NORMALIZATION)) {
+		spdlog::error("APP: Channel B is used as the reference power, disable the power normalization first");
+		return false;
+	}
+	m_daq_channels = channels;
+	m_daq_acquired_channels = get_daq_acquired_channels();
+	if (channels == DAQ_CHANNELS::SINGLE_CHANNEL) {
+		spdlog::info("APP: DAQ acquires channel A");
+	}
+	if (channels == DAQ_CHANNELS::DUAL_CHANNEL) {
+		spdlog::info("APP: DAQ acquires channel A and channel B");
+	}
+	return true;
+}
+
+
+bool App::set_power_normalization(const POWER_NORMALIZATION power_normalization) {
+	if (m_app_running) {
+		spdlog::error("APP: Running, stop in order to change the configuration");
+		return false;
+	}
+	if ((power_normalization != POWER_NORMALIZATION::NO_NORMALIZATION) && (m_daq_channels == DAQ_CHANNELS::DUAL_CHANNEL)) {
+		spdlog::error("APP: Channel B is used as a signal channel, switch to a single channel first");
+		return false;
+	}
+	m_power_normalization = power_normalization;
+
+	m_daq_acquired_channels = get_daq_acquired_channels();
+	if (power_normalization == POWER_NORMALIZATION::NO_NORMALIZATION) {
+		spdlog::info("APP: Power normalization is disabled");
+	}
+	if (power_normalization == POWER_NORMALIZATION::DIVIDE) {
+		spdlog::info("APP: Signal is divided by the reference power on channel B");
+	}
+	if (power_normalization == POWER_NORMALIZATION::REGRESS) {
+		spdlog::info("APP: Signal is regressed on the reference power on channel B");
+	}
+	return true;
+}
+
+
+void App::toggle_trace() {
+	if (!Trace::is_recording()) {
+		if (!Trace::start()) {
+			spdlog::error("APP: Failed to start tracing");
+			return;
+		}
+		spdlog::info("APP: Tracing started");
+		return;
+	}
+	Trace::stop();
+	if (!Trace::export_to_chrome_json(kTraceFile)) {
+		spdlog::error("APP: Failed to write the trace to %s", kTraceFile);
+		return;
+	}
+	spdlog::info("APP: Trace written to %s", kTraceFile);
+}
+
+
+void App::dump_flight_recorder() {
+	m_flight_recorder.dump("key press");
+}
+
+
 void App::test_tm_optimization_compute_performance() {	
 	// Configure for fixed mode and reference at 0 for the final column.
 	set_tm_fixed_segment(FIXED_SEGMENT::MODE, false, true);
@@ -795,13 +1253,13 @@ void App::test_tm_optimization_compute_performance() {
 	}
 
 	// Simulate the DAQ capture and and callback process.
-	// Allocate memory for DMA buffers.
+	// Allocate memory for DMA buffers (pinned, like the DAQ does).
 	auto m_daqbuffer_count = 4;
 	auto buffer_array = new u16*[m_daqbuffer_count];
-	auto bytes_per_record = kDAQSamplesPerRecord * 2;
-	auto bytes_per_buffer = bytes_per_record * kModesPerBufferTM * kTMInterferencePatternsPerMode;
+	auto bytes_per_record = m_daq_samples_per_record * 2;
+	auto bytes_per_buffer = bytes_per_record * m_records_per_buffer_tm * m_daq_acquired_channels;
 	for (auto buffer_index = 0; buffer_index < m_daqbuffer_count; buffer_index++) {
-		buffer_array[buffer_index] = static_cast<u16*>(VirtualAlloc(nullptr, bytes_per_buffer, MEM_COMMIT, PAGE_READWRITE));
+		buffer_array[buffer_index] = static_cast<u16*>(allocate_pinned_memory(bytes_per_buffer));
 		if (buffer_array[buffer_index] == nullptr) {
 			spdlog::error("Alloc %d bytes failed", bytes_per_buffer);
 		}
@@ -818,12 +1276,17 @@ void App::test_tm_optimization_compute_performance() {
 	u32 sample_index_start = 0;
 	u32 intereference_index = 0;
 	while (std::getline(file, line)) {
-		for (auto sample_index = sample_index_start; sample_index < sample_index_start + kDAQSamplesPerRecord; ++sample_index) {
-			buffer_array[buffer_index][sample_index] = static_cast<u16>(std::stof(line));
+		// With multiple channels, all the signal channels get the same synthesized data (samples are interleaved).
+		// The reference power channel gets a constant power.
+		for (auto sample_index = sample_index_start; sample_index < sample_index_start + m_daq_samples_per_record; ++sample_index) {
+			for (auto channel_index = 0; channel_index < m_daq_acquired_channels; ++channel_index) {
+				auto sample = (channel_index < m_daq_channels) ? static_cast<u16>(std::stof(line)) : static_cast<u16>(2 * kDAQZeroCode - 1);
+				buffer_array[buffer_index][sample_index * m_daq_acquired_channels + channel_index] = sample;
+			}
 		}
-		sample_index_start += kDAQSamplesPerRecord;
+		sample_index_start += m_daq_samples_per_record;
 		intereference_index++;
-		if (intereference_index == kModesPerBufferTM * kTMInterferencePatternsPerMode) {
+		if (intereference_index == m_records_per_buffer_tm) {
 			buffer_index++;
 			sample_index_start = 0;
 			intereference_index = 0;
@@ -831,27 +1294,39 @@ void App::test_tm_optimization_compute_performance() {
 	}
 
 	// Compute the number of bytes in the buffer.
-	auto buffer_length_bytes = kDAQSamplesPerRecord * m_records_per_buffer_tm * 2;
+	auto buffer_length_bytes = m_daq_samples_per_record * m_records_per_buffer_tm * m_daq_acquired_channels * 2;
 
 	// One cycle of the optimization requires cycling through #m_buffer_count_per_cycle buffers.
 	// This is required for the DAQ buffer receive callback in order to know how many buffer to process per cycle.
 	m_buffer_count_per_cycle = m_input_modes / kModesPerBufferTM;
+	allocate_cycle_buffers(m_records_per_buffer_tm, kModesPerBufferTM, 0);
+	m_tm_mode_responses = Eigen::MatrixXcf::Zero(m_input_modes, kDAQChannelsMax);
+	m_tm_mode_magnitudes = Eigen::VectorXf::Zero(m_input_modes);
+	m_on_buffer_receive = &App::on_buffer_receive_run_tm_optimization;
+	if (use_fixed_point_tm()) {
+		m_on_buffer_receive = &App::on_buffer_receive_run_fixed_point_tm_optimization;
+		create_fixed_point_tm_demodulation_matrix();
+	}
 
 	// Setup and run the test.
 	// kTestTrials is #of trials per iteration
 	// Start the high performance counter.
+	// Buffers are numbered from 1, like the DAQ does.
+	reset_buffer_alignment(m_records_per_buffer_tm);
+	reset_final_dac_column();
+	u64 buffers_completed = 0;
 	m_app_running = true;
 	m_hpc.start();
 	while (m_app_running) {
 		for (auto ii = 0; ii < m_daqbuffer_count; ++ii) {
-			on_buffer_receive_run_tm_optimization(buffer_array[ii], buffer_length_bytes, ii);
+			on_buffer_receive_guarded(buffer_array[ii], buffer_length_bytes, ++buffers_completed);
 		}
 	}
 
 	// Clear allocated memory.
 	for (auto buffer_index = 0; buffer_index < m_daqbuffer_count; ++buffer_index) {
 		if (buffer_array[buffer_index]) {
-			VirtualFree(buffer_array[buffer_index], 0, MEM_RELEASE);
+			free_pinned_memory(buffer_array[buffer_index], bytes_per_buffer);
 		}
 	}
 	delete[] buffer_array;
@@ -870,53 +1345,61 @@ void App::test_iterative_optimization_compute_performance() {
 
 	// Unlike the TM case, we need this in order to create the phase steps LUT.
 	// Also, simulate a case which we start with a solution vector.
-	m_final_phase_column.fill(PI_F32/4);
+	m_final_phase_columns.fill(PI_F32/4);
 	create_preloaded_phase_columns_for_iterative_optimization(true, true);
 
 	// Simulate the DAQ capture and and callback process.
-	// Allocate memory for DMA buffers.
+	// Allocate memory for DMA buffers (pinned, like the DAQ does).
 	auto m_daqbuffer_count = 4;
 	auto buffer_array = new u16*[m_daqbuffer_count];
-	auto bytes_per_record = kDAQSamplesPerRecord * 2;
-	auto bytes_per_buffer = bytes_per_record * kModesPerBufferIterative * kIterativePhaseStepsPerMode;
+	auto bytes_per_record = m_daq_samples_per_record * 2;
+	auto bytes_per_buffer = bytes_per_record * m_records_per_buffer_iterative * m_daq_acquired_channels;
 	for (auto buffer_index = 0; buffer_index < m_daqbuffer_count; buffer_index++) {
-		buffer_array[buffer_index] = static_cast<u16*>(VirtualAlloc(nullptr, bytes_per_buffer, MEM_COMMIT, PAGE_READWRITE));
+		buffer_array[buffer_index] = static_cast<u16*>(allocate_pinned_memory(bytes_per_buffer));
 		if (buffer_array[buffer_index] == nullptr) {
 			spdlog::error("Alloc %d  bytes failed", bytes_per_buffer);
 		}
 	}
 
-	// Fill each buffer from synthesized data.
+	// Fill each buffer from synthesized data (all the acquired channels get the same data, samples are interleaved).
 	for (auto buffer_index = 0; buffer_index < m_daqbuffer_count; ++buffer_index) {
-		for (auto record_index = 0; record_index < kModesPerBufferIterative * kIterativePhaseStepsPerMode; ++record_index) {
-			for (auto sample_index = 0; sample_index < kDAQSamplesPerRecord; ++sample_index) {
-				buffer_array[buffer_index][record_index*kDAQSamplesPerRecord + sample_index] = record_index;
+		for (auto record_index = 0; record_index < m_records_per_buffer_iterative; ++record_index) {
+			for (u32 sample_index = 0; sample_index < m_daq_samples_per_record; ++sample_index) {
+				for (auto channel_index = 0; channel_index < m_daq_acquired_channels; ++channel_index) {
+					buffer_array[buffer_index][(record_index*m_daq_samples_per_record + sample_index) * m_daq_acquired_channels + channel_index] = record_index;
+				}
 			}
 		}
 	}
 
 	// Compute the number of bytes in the buffer.
-	auto buffer_length_bytes = kDAQSamplesPerRecord * m_records_per_buffer_iterative * 2;
+	auto buffer_length_bytes = m_daq_samples_per_record * m_records_per_buffer_iterative * m_daq_acquired_channels * 2;
 
 	// One cycle of the optimization requires cycling through #m_buffer_count_per_cycle buffers.
 	// This is required for the DAQ buffer receive callback in order to know how many buffer to process per cycle.
-	m_buffer_count_per_cycle = m_input_modes / kModesPerBufferIterative;
+	m_buffer_count_per_cycle = m_input_modes / m_modes_per_buffer_iterative;
+	allocate_cycle_buffers(m_records_per_buffer_iterative, m_modes_per_buffer_iterative, 0);
+	m_on_buffer_receive = &App::on_buffer_receive_run_iterative_optimization;
 
 	// Setup and run the test.
 	// kTestTrials is #of trials per iteration
 	// Start the high performance counter.
+	// Buffers are numbered from 1, like the DAQ does.
+	reset_buffer_alignment(m_records_per_buffer_iterative);
+	reset_final_dac_column();
+	u64 buffers_completed = 0;
 	m_app_running = true;
 	m_hpc.start();
 	while (m_app_running) {
 		for (auto ii = 0; ii < m_daqbuffer_count; ++ii) {
-			on_buffer_receive_run_iterative_optimization(buffer_array[ii], buffer_length_bytes, ii);
+			on_buffer_receive_guarded(buffer_array[ii], buffer_length_bytes, ++buffers_completed);
 		}
 	}
 
 	// Clear allocated memory.
 	for (auto buffer_index = 0; buffer_index < m_daqbuffer_count; ++buffer_index) {
 		if (buffer_array[buffer_index]) {
-			VirtualFree(buffer_array[buffer_index], 0, MEM_RELEASE);
+			free_pinned_memory(buffer_array[buffer_index], bytes_per_buffer);
 		}
 	}
 	delete[] buffer_array;
@@ -1029,212 +1512,1027 @@ void App::on_buffer_receive_extract_calibration_curve(u16* const data_ptr, const
 }
 
 
-void App::on_buffer_receive_run_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index) {
-#ifdef DAQ_WORKAROUND
-#ifndef GLV_PROCESSING_EMULATION
-	static int buffer_index = 0;
-	if (m_daq_workaround_first_buffer_flag) {
-		buffer_index = 0;
-		m_daq_workaround_first_buffer_flag = false;
+void App::on_buffer_receive_detect_analysis_window(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	// Records alternate between the two high contrast columns (data_len is in bytes, and each sample is 2bytes).
+	// The first pair is discarded, the column before the first record is unknown.
+	const auto records_per_buffer = 2 * kWindowDetectionColumnPairs;
+	const auto samples_per_record = static_cast<int>((data_len >> 1) / records_per_buffer);
+	auto stride = Eigen::OuterStride<>(2 * samples_per_record);
+	auto rising_records = Eigen::Map<RecordMatrix, 0, Eigen::OuterStride<>>(data_ptr + 2 * samples_per_record, samples_per_record, kWindowDetectionColumnPairs - 1, stride);
+	auto falling_records = Eigen::Map<RecordMatrix, 0, Eigen::OuterStride<>>(data_ptr + 3 * samples_per_record, samples_per_record, kWindowDetectionColumnPairs - 1, stride);
+
+	// The per sample step response, averaged over the records (the offset of the two columns cancels out).
+	Eigen::VectorXf step_response = rising_records.cast<f32>().rowwise().mean() - falling_records.cast<f32>().rowwise().mean();
+
+	// The settled step is the median of the second half of the record.
+	std::vector<f32> second_half(step_response.data() + samples_per_record / 2, step_response.data() + samples_per_record);
+	std::nth_element(second_half.begin(), second_half.begin() + second_half.size() / 2, second_half.end());
+	auto settled_step = second_half[second_half.size() / 2];
+
+	// Find the earliest run of settled samples which is long enough, the window starts with the run.
+	// The window keeps the configured length (shorter if the run is shorter), so the records stay short.
+	auto tolerance = kWindowDetectionTolerance * std::abs(settled_step);
+	auto window_start = -1;
+	auto window_length = 0;
+	auto run_start = 0;
+	for (auto sample_index = 0; sample_index <= samples_per_record; ++sample_index) {
+		bool settled = (sample_index < samples_per_record) && (std::abs(step_response(sample_index) - settled_step) <= tolerance);
+		if (!settled) {
+			if ((sample_index - run_start) >= kWindowDetectionMinLength) {
+				window_start = run_start;
+				window_length = (std::min)(sample_index - run_start, static_cast<int>(m_analysis_window_length));
+				break;
+			}
+			run_start = sample_index + 1;
+		}
+	}
+
+	// Dump the step response to file.
+	std::ofstream file{"step_response.txt"};
+	for (auto sample_index = 0; sample_index < samples_per_record; ++sample_index) {
+		file << step_response(sample_index) << std::endl;
+	}
+	file.close();
+
+	if ((settled_step == 0) || (window_start < 0)) {
+		spdlog::error("APP: Failed to find a settled window, check the step response file");
 		return;
 	}
+	spdlog::info("APP: Settle time is %dns", static_cast<int>(window_start * 1e9 / kDAQSamplesPerSec));
+	m_detected_window_start = window_start;
+	m_detected_window_length = window_length;
+}
 
-	// Get the index of the buffer, discard first.
-	//int buffer_index = (data_index - 1) % m_buffer_count_per_cycle;
-#else
-	// For the emulation, we should not discard the first buffer.
-	int buffer_index = data_index % m_buffer_count_per_cycle;
-#endif
-#endif
-
-	// Each thread takes care of exactly one input mode.
-	#pragma omp parallel
-	{
-		Eigen::MatrixXcf private_cartesian_pattern = Eigen::VectorXcf::Zero(m_pixels_per_mode, 1);
-		#pragma omp for nowait
-		for (auto record_index = 0; record_index < m_records_per_buffer_tm; record_index += kTMInterferencePatternsPerMode) {
-			// Get the local index of the mode, which is equal to the index of the first record of that mode inside the buffer.
-			auto mode_index = record_index / kTMInterferencePatternsPerMode;
-
-			// Convert a buffer segment to a Column-major storage eigen matrix, where each column corresponds to a record (different interference pattern).
-			auto start_sample_index = record_index * kDAQSamplesPerRecord;
-			auto mode_intensities_per_interference = Eigen::Map<ModeMatrixTM>(data_ptr + start_sample_index);
-		
-			// Find the mean of each record and store in a row vector with kTMInterferencePatternsPerMode_ entries.
-			//auto mode_avg_intensity_per_interference = mode_intensities_per_interference.cast<f32>().colwise().mean();
-			auto mode_avg_intensity_per_interference = mode_intensities_per_interference.cast<f32>().block(200, 0, 50, kTMInterferencePatternsPerMode).colwise().mean();
-
-			// Compute the response of the mode from the interference patterns.
-			// Note: This equation depends on the interference patterns and would have to change if they change.
-			auto I = mode_avg_intensity_per_interference;
-			std::complex<f32> mode_response_conj;
-			if (m_fixed_segment == FIXED_SEGMENT::MODE) {
-				if (m_phase_steps == PHASE_STEPS::PI_HALF) 
-					mode_response_conj = std::complex<f32>{I(2)-I(1), -(I(0)-I(1))};			
-				else if (m_phase_steps == PHASE_STEPS::PI_QUARTER) {
-					auto a = I(0) - I(1);
-					auto b = I(2) - I(1);
-					mode_response_conj = std::complex<f32>{-a-(1+sqrtf(2))*b, -((1 + sqrtf(2))*a+b)};
-				}
-				//mode_response_conj = std::complex<f32>{I(0)-I(2), -(I(0)+I(2)-2*I(1))};
-				//mode_response_conj = std::complex<f32>{I(2)-I(1), I(0)-I(1)};
-			}
-			else {
-				if( m_phase_steps == PHASE_STEPS::PI_HALF)
-					mode_response_conj = std::complex<f32>{I(2)-I(1), (I(0)-I(1))};
-				else if (m_phase_steps == PHASE_STEPS::PI_QUARTER) {
-					auto a = I(0) - I(1);
-					auto b = I(2) - I(1);
-					mode_response_conj = std::complex<f32>{-a-(1+sqrtf(2))*b, +((1+sqrtf(2))*a+b)};
-				}
-			}
 
-			// Find the global mode index.
-			auto mode_global_index = kModesPerBufferTM * buffer_index + mode_index;
+void App::on_buffer_receive_run_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	// Find the index of the buffer in the cycle, buffers of a resynchronization or of a misaligned cycle are discarded.
+	int buffer_index;
+	bool last_buffer_in_cycle;
+	if (!begin_cycle_buffer(data_index, &buffer_index, &last_buffer_in_cycle)) {
+		return;
+	}
 
-			// Multiply the mode by the conjugate response in order to align the phase.
-			private_cartesian_pattern = m_input_modes_matrix.col(mode_global_index) * (mode_response_conj/std::abs(mode_response_conj));
+	// Find the mean of the analysis window of each record in the buffer, per channel.
+	average_record_windows(data_ptr, m_records_per_buffer_tm);
+
+	// The phase of each mode is aligned by multiplying it with its normalized conjugate response, one column per channel.
+	Eigen::Matrix<std::complex<f32>, kModesPerBufferTM, Eigen::Dynamic, 0, kModesPerBufferTM, kDAQChannelsMax> mode_alignment{kModesPerBufferTM, m_daq_channels};
+	estimate_tm_mode_responses(mode_alignment, m_tm_mode_magnitudes.segment(kModesPerBufferTM * buffer_index, kModesPerBufferTM));
+	m_tm_mode_responses.block(kModesPerBufferTM * buffer_index, 0, kModesPerBufferTM, m_daq_channels) = mode_alignment;
+	Eigen::Matrix<f32, kModesPerBufferTM, Eigen::Dynamic, 0, kModesPerBufferTM, kDAQChannelsMax> mode_alignment_real = mode_alignment.real();
+	Eigen::Matrix<f32, kModesPerBufferTM, Eigen::Dynamic, 0, kModesPerBufferTM, kDAQChannelsMax> mode_alignment_imag = mode_alignment.imag();
+
+	// Each thread adds up the aligned modes of the buffer for its own block of mode pixels (for all the channels), so no synchronization is needed.
+	// On the last buffer of the cycle, the thread also converts its pixels to phase and DAC values, so only the upload remains after the loop.
+	auto mode_global_start = kModesPerBufferTM * buffer_index;
+	auto mode_pixels_per_block = (m_input_modes + kModePixelBlocks - 1) / kModePixelBlocks;
+	#pragma omp parallel for
+	for (auto block_index = 0; block_index < kModePixelBlocks; ++block_index) {
+		auto mode_pixel_start = mode_pixels_per_block * block_index;
+		auto mode_pixels = (std::min)(mode_pixels_per_block, m_input_modes - mode_pixel_start);
+		if (mode_pixels <= 0) {
+			continue;
+		}
+		auto& basis_block = m_basis_blocks[block_index];
+		if ((basis_block.rows() != mode_pixels) || (basis_block.cols() != kModesPerBufferTM)) {
+			basis_block.resize(mode_pixels, kModesPerBufferTM);
+		}
+		m_basis.fill_block(mode_pixel_start, mode_global_start, basis_block.real(), basis_block.imag());
+		accumulate_mode_pixels(mode_pixel_start, basis_block, mode_alignment_real, mode_alignment_imag);
+		if (last_buffer_in_cycle) {
+			finalize_mode_pixels(mode_pixel_start, mode_pixels, m_daq_channels);
+		}
+	}
 
-			// Add up the aligned modes.
-			#pragma omp critical  
-			{
-				m_final_cartesian_pattern += private_cartesian_pattern;
-			}
+	// After the last buffer of the cycle, we finished processing all the modes, load the solution of channel A to the GLV.
+	if (last_buffer_in_cycle) {
+		auto loop_cycle_restarted = pace_loop_cycle();
+		m_glv->load_and_resume_cycle(m_final_dac_column);
+		record_cycle(m_tm_mode_responses.col(0), m_tm_mode_magnitudes.sum(), loop_cycle_restarted);
+		if (!loop_cycle_restarted) {
+			m_pacing_latency_max_us = (std::max)(m_pacing_latency_max_us, m_pacing_hpc.stop().get_time_in_usec());
+			++m_pacing_cycle_count;
 		}
+		m_decorrelation.push(m_tm_mode_responses.col(0), m_decorrelation_hpc.stop().get_time_in_usec());
+		count_cycle([this](const f64 cycle_time_us) {
+			spdlog::info("APP: Average cycle time is %f usec", cycle_time_us);
+			spdlog::info("APP: %f cycles per second, loop cycle wait is %dus", 1e6 / cycle_time_us, m_loopcycle_wait_us);
+			report_decorrelation_time();
+		});
 	}
+}
 
-	// Increase the buffer index, which is used in order to compute the index of the mode to be processed.
-	buffer_index = (buffer_index + 1) % m_buffer_count_per_cycle;
 
-	// When the buffer_index returns to zero, we finished processing all the modes.
-	// Compute element wise phase in the range [-PI, PI] and load to the GLV.
-	if (buffer_index == 0) {
-		m_final_phase_column.block(m_mode_start_pixel, 0, m_pixels_per_mode, 1) = m_final_cartesian_pattern.imag().binaryExpr(m_final_cartesian_pattern.real(), std::ptr_fun<f32, f32, f32>(atan2f)).array();
-		m_final_cartesian_pattern.fill(0);
-		m_glv->load_and_resume_cycle(convert_phase_to_glv_dac_column(m_final_phase_column));
-		++m_cycle_count;
-		
-		// Report results.
-		if (m_cycle_count == kTestTrials) {
-			spdlog::info("APP: Average cycle time is %f usec", m_hpc.stop().get_time_in_usec() / m_cycle_count);
-			m_hpc.start();
-			m_cycle_count = 0;
+void App::on_buffer_receive_run_fixed_point_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	// Find the index of the buffer in the cycle, buffers of a resynchronization or of a misaligned cycle are discarded.
+	int buffer_index;
+	bool last_buffer_in_cycle;
+	if (!begin_cycle_buffer(data_index, &buffer_index, &last_buffer_in_cycle)) {
+		return;
+	}
+
+	// Find the sum of the analysis window of each record in the buffer, per channel.
+	sum_record_windows(data_ptr, m_records_per_buffer_tm);
+
+	// The phase of each mode is aligned by multiplying it with its normalized conjugate response (Q14), one column per channel.
+	Eigen::Matrix<i32, kModesPerBufferTM, Eigen::Dynamic, 0, kModesPerBufferTM, kDAQChannelsMax> mode_alignment_real{kModesPerBufferTM, m_daq_channels};
+	Eigen::Matrix<i32, kModesPerBufferTM, Eigen::Dynamic, 0, kModesPerBufferTM, kDAQChannelsMax> mode_alignment_imag{kModesPerBufferTM, m_daq_channels};
+	estimate_fixed_point_tm_mode_responses(mode_alignment_real, mode_alignment_imag, m_tm_mode_magnitudes.segment(kModesPerBufferTM * buffer_index, kModesPerBufferTM));
+	auto mode_responses = m_tm_mode_responses.block(kModesPerBufferTM * buffer_index, 0, kModesPerBufferTM, m_daq_channels);
+	mode_responses.real() = mode_alignment_real.cast<f32>() / (1 << kFixedPointAlignmentBits);
+	mode_responses.imag() = mode_alignment_imag.cast<f32>() / (1 << kFixedPointAlignmentBits);
+
+	// Each thread adds up the aligned modes of the buffer for its own block of mode pixels (for all the channels), so no synchronization is needed.
+	// Integer sums don't depend on the order, so the solution is the same for any number of threads.
+	// On the last buffer of the cycle, the thread also converts its pixels to phase and DAC values, so only the upload remains after the loop.
+	auto mode_global_start = kModesPerBufferTM * buffer_index;
+	auto mode_pixels_per_block = (m_input_modes + kModePixelBlocks - 1) / kModePixelBlocks;
+	#pragma omp parallel for
+	for (auto block_index = 0; block_index < kModePixelBlocks; ++block_index) {
+		auto mode_pixel_start = mode_pixels_per_block * block_index;
+		auto mode_pixels = (std::min)(mode_pixels_per_block, m_input_modes - mode_pixel_start);
+		if (mode_pixels <= 0) {
+			continue;
+		}
+		TraceSpan trace_span{"accumulate_mode_pixels"};
+		auto& hadamard_block = m_hadamard_blocks[block_index];
+		hadamard_block.resize(mode_pixels, kModesPerBufferTM);
+		m_basis.fill_hadamard_block(mode_pixel_start, mode_global_start, hadamard_block);
+		accumulate_hadamard_block(hadamard_block, mode_alignment_real, mode_alignment_imag,
+			m_final_patterns_real_fixed_point.block(mode_pixel_start, 0, mode_pixels, m_daq_channels), m_final_patterns_imag_fixed_point.block(mode_pixel_start, 0, mode_pixels, m_daq_channels));
+		if (last_buffer_in_cycle) {
+			finalize_fixed_point_mode_pixels(mode_pixel_start, mode_pixels, m_daq_channels);
 		}
 	}
+
+	// After the last buffer of the cycle, we finished processing all the modes, load the solution of channel A to the GLV.
+	if (last_buffer_in_cycle) {
+		auto loop_cycle_restarted = pace_loop_cycle();
+		m_glv->load_and_resume_cycle(m_final_dac_column);
+		record_cycle(m_tm_mode_responses.col(0), m_tm_mode_magnitudes.sum(), loop_cycle_restarted);
+		if (!loop_cycle_restarted) {
+			m_pacing_latency_max_us = (std::max)(m_pacing_latency_max_us, m_pacing_hpc.stop().get_time_in_usec());
+			++m_pacing_cycle_count;
+		}
+		m_decorrelation.push(m_tm_mode_responses.col(0), m_decorrelation_hpc.stop().get_time_in_usec());
+		count_cycle([this](const f64 cycle_time_us) {
+			spdlog::info("APP: Average cycle time is %f usec", cycle_time_us);
+			spdlog::info("APP: %f cycles per second, loop cycle wait is %dus", 1e6 / cycle_time_us, m_loopcycle_wait_us);
+			report_decorrelation_time();
+		});
+	}
 }
 
 
-void App::on_buffer_receive_run_iterative_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index) {
-#ifdef DAQ_WORKAROUND
-#ifndef GLV_PROCESSING_EMULATION
-	static int buffer_index = 0;
-	if (m_daq_workaround_first_buffer_flag) {
-		buffer_index = 0;
-		m_daq_workaround_first_buffer_flag = false;
+void App::on_buffer_receive_run_rolling_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	// Find the index of the buffer in the rolling window (the cycle), buffers of a resynchronization or of a misaligned window are discarded.
+	int buffer_index;
+	bool last_buffer_in_cycle;
+	if (!begin_cycle_buffer(data_index, &buffer_index, &last_buffer_in_cycle)) {
 		return;
 	}
 
-	// Get the index of the buffer, discard first.
-	//int buffer_index = (data_index - 1) % m_buffer_count_per_cycle;
-#else
-	// For the emulation, we should not discard the first buffer.
-	int buffer_index = data_index % m_buffer_count_per_cycle;
-#endif
-#endif
-
-	// Each thread takes care of exactly one input mode (the buffer contains multiple modes).
-	#pragma omp parallel
-	{
-		Eigen::MatrixXcf private_cartesian_pattern = Eigen::VectorXcf::Zero(m_pixels_per_mode, 1);
-		#pragma omp for nowait
-		for (auto mode_index = 0; mode_index < kModesPerBufferIterative; mode_index++) {
-			// Convert a buffer segment to a Column-major storage eigen matrix, where each column corresponds to a record (different interference pattern).
-			auto start_sample_index = mode_index * kDAQSamplesPerRecord * kIterativePhaseStepsPerMode;
-			auto mode_intensities_per_phase_addition = Eigen::Map<ModeMatrixIterative>(data_ptr + start_sample_index);
-		
-			// Find the mean of each record (i.e. added phase) and store in a row vector with kIterativePhaseStepsPerMode entries.
-			//auto mode_avg_intensity_per_phase_addition = mode_intensities_per_phase_addition.cast<f32>().colwise().mean();
-			auto mode_avg_intensity_per_phase_addition = mode_intensities_per_phase_addition.cast<f32>().block(200, 0, 50, kIterativePhaseStepsPerMode).colwise().mean();
+	// Find the mean of the analysis window of each record in the buffer, per channel.
+	average_record_windows(data_ptr, m_records_per_buffer_tm);
+
+	// Age the responses once per window, then keep the fresh responses of the modes in the buffer.
+	if ((buffer_index == 0) && (m_rolling_tm_forgetting < 1.0f)) {
+		m_tm_mode_responses *= m_rolling_tm_forgetting;
+	}
+	auto tm_buffer_index = (m_rolling_tm_first_buffer + buffer_index) % m_tm_buffer_count;
+	estimate_tm_mode_responses(m_tm_mode_responses.block(kModesPerBufferTM * tm_buffer_index, 0, kModesPerBufferTM, m_daq_channels),
+		m_tm_mode_magnitudes.segment(kModesPerBufferTM * tm_buffer_index, kModesPerBufferTM));
+	if (!last_buffer_in_cycle) {
+		return;
+	}
+
+	// Sum up all the modes by their latest responses.
+	finalize_tm_mode_responses();
+
+	// The GLV waits for the variable column, move the loop cycle to the next window and load the solution of channel A.
+	// The pacing latency is the processing, the GLV runs through the columns of the window after the restart, so the upload
+	// which follows the restart isn't late. A window of all the modes never moves, so the loop cycle isn't restarted.
+	auto processing_latency_us = m_pacing_hpc.stop().get_time_in_usec();
+	auto loop_cycle_restarted = pace_loop_cycle();
+	m_rolling_tm_first_buffer = (m_rolling_tm_first_buffer + m_buffer_count_per_cycle) % m_tm_buffer_count;
+	auto window_moved = (m_buffer_count_per_cycle < m_tm_buffer_count);
+	if (window_moved) {
+		auto column_start = m_records_per_buffer_tm * m_rolling_tm_first_buffer;
+		m_glv->set_loop_cycle_range(static_cast<u16>(column_start), static_cast<u16>(column_start + m_records_per_buffer_tm * m_buffer_count_per_cycle - 1));
+	}
+	m_glv->load_and_resume_cycle(m_final_dac_column);
+	record_cycle(m_tm_mode_responses.col(0), m_tm_mode_magnitudes.sum(), loop_cycle_restarted || window_moved);
+	if (!loop_cycle_restarted) {
+		m_pacing_latency_max_us = (std::max)(m_pacing_latency_max_us, processing_latency_us);
+		++m_pacing_cycle_count;
+	}
+
+	// Every mode was refreshed once the window wraps around, which makes a sweep for the decorrelation estimate.
+	if (m_rolling_tm_first_buffer == 0) {
+		m_decorrelation.push(m_tm_mode_responses.col(0), m_decorrelation_hpc.stop().get_time_in_usec());
+	}
+	count_cycle([this](const f64 cycle_time_us) {
+		auto window_patterns = m_records_per_buffer_tm * m_buffer_count_per_cycle;
+		auto pattern_duty = window_patterns * m_glv_col_period_ns_initial * 1e-3 / cycle_time_us;
+		spdlog::info("APP: Average update time is %f usec, loop cycle wait is %dus", cycle_time_us, m_loopcycle_wait_us);
+		spdlog::info("APP: %f patterns per second, %f%% of the column rate", window_patterns * 1e6 / cycle_time_us, 100 * pattern_duty);
+		report_decorrelation_time();
+	});
+}
 
-			// Find the index of the phase step which gives maximum response.
-			ModeMatrixIterative::Index max_index;
-			mode_avg_intensity_per_phase_addition.maxCoeff(&max_index);
 
-			// Find the global mode index.
-			auto mode_global_index = kModesPerBufferIterative * buffer_index + mode_index;
+void App::on_buffer_receive_run_adaptive_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	// Find the index of the buffer in the cycle, buffers of a resynchronization or of a misaligned cycle are discarded.
+	int buffer_index;
+	bool last_buffer_in_cycle;
+	if (!begin_cycle_buffer(data_index, &buffer_index, &last_buffer_in_cycle)) {
+		return;
+	}
+
+	// Find the mean of the analysis window of each record in the buffer, per channel.
+	average_record_windows(data_ptr, m_records_per_buffer_tm);
+
+	// The dominant groups are preloaded first, followed by the group of weak modes of this cycle.
+	// Keep the fresh responses of the modes in the buffer.
+	Eigen::Matrix<std::complex<f32>, kModesPerBufferTM, Eigen::Dynamic, 0, kModesPerBufferTM, kDAQChannelsMax> mode_alignment{kModesPerBufferTM, m_daq_channels};
+	Eigen::Matrix<f32, kModesPerBufferTM, 1> mode_magnitudes;
+	estimate_tm_mode_responses(mode_alignment, mode_magnitudes);
+	auto schedule_group = (buffer_index < m_adaptive_tm_dominant_groups) ? buffer_index : (m_adaptive_tm_dominant_groups + m_adaptive_tm_weak_group);
+	for (auto mode_index = 0; mode_index < kModesPerBufferTM; ++mode_index) {
+		auto mode = m_adaptive_tm_schedule[kModesPerBufferTM * schedule_group + mode_index];
+		m_tm_mode_responses.row(mode).head(m_daq_channels) = mode_alignment.row(mode_index);
+		m_tm_mode_magnitudes(mode) = mode_magnitudes(mode_index);
+	}
+	if (!last_buffer_in_cycle) {
+		return;
+	}
 
-			// Add the phase (in cartesian) that corresponds to the highest response.
-			private_cartesian_pattern = m_input_modes_matrix_adjusted.col(mode_global_index).array() * m_iterative_phase_step_in_cartesian[max_index];
+	// Sum up all the modes by their latest responses.
+	finalize_tm_mode_responses();
+
+	// The GLV waits for the variable column, preload the next group of weak modes (or the columns of a new schedule),
+	// then load the solution of channel A.
+	// The number of buffers in the cycle changes with the schedule, so the next buffer starts a new cycle.
+	auto weak_groups = adaptive_tm_weak_groups();
+	if (weak_groups > 0) {
+		m_adaptive_tm_weak_group = (m_adaptive_tm_weak_group + 1) % weak_groups;
+	}
+	if ((weak_groups == 0) || (m_adaptive_tm_weak_group == 0)) {
+		m_decorrelation.push(m_tm_mode_responses.col(0), m_decorrelation_hpc.stop().get_time_in_usec());
+	}
+	auto loop_cycle_reloaded = false;
+	if (++m_adaptive_tm_cycles >= kAdaptiveTMScheduleCycles) {
+		loop_cycle_reloaded = true;
+		reschedule_adaptive_tm();
+		m_first_cycle_data_index = data_index + 1;
+		m_glv->reload_loop_cycle(0, create_adaptive_tm_dac_columns(false), 0, static_cast<u16>(m_records_per_buffer_tm * m_buffer_count_per_cycle - 1));
+	}
+	else if (weak_groups > 0) {
+		loop_cycle_reloaded = true;
+		reload_loop_cycle_measured(static_cast<u16>(m_records_per_buffer_tm * m_adaptive_tm_dominant_groups), create_adaptive_tm_dac_columns(true));
+	}
+	m_glv->load_and_resume_cycle(m_final_dac_column);
+	record_cycle(m_tm_mode_responses.col(0), m_tm_mode_magnitudes.sum(), loop_cycle_reloaded);
+	m_pacing_latency_max_us = (std::max)(m_pacing_latency_max_us, m_pacing_hpc.stop().get_time_in_usec());
+	count_cycle([this, weak_groups](const f64 cycle_time_us) {
+		spdlog::info("APP: Average cycle time is %f usec, worst cycle latency is %f usec", cycle_time_us, m_pacing_latency_max_us);
+		spdlog::info("APP: %d dominant modes are measured every cycle, %d weak modes every %d cycles", kModesPerBufferTM * m_adaptive_tm_dominant_groups, m_input_modes - kModesPerBufferTM * m_adaptive_tm_dominant_groups, (std::max)(weak_groups, 1));
+		spdlog::info("APP: Skipping the weak groups saves %f usec of patterns per cycle, reloading the weak group takes %f usec", adaptive_tm_skipped_us(), m_reload_us);
+		report_decorrelation_time();
+		m_pacing_latency_max_us = 0;
+	});
+}
 
-			// Add up the aligned modes.
-			#pragma omp critical  
-			{
-				m_final_cartesian_pattern += private_cartesian_pattern;
+
+void App::on_buffer_receive_run_iterative_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	// Find the index of the buffer in the cycle, buffers of a resynchronization or of a misaligned cycle are discarded.
+	int buffer_index;
+	bool last_buffer_in_cycle;
+	if (!begin_cycle_buffer(data_index, &buffer_index, &last_buffer_in_cycle)) {
+		return;
+	}
+
+	// Find the mean of the analysis window of each record in the buffer (only channel A is used).
+	average_record_windows(data_ptr, m_records_per_buffer_iterative);
+
+	// Find the optimal phase (in cartesian) of each mode in the buffer.
+	auto mode_global_start = m_modes_per_buffer_iterative * buffer_index;
+	auto mode_alignment = m_mode_responses.segment(mode_global_start, m_modes_per_buffer_iterative);
+	estimate_iterative_mode_responses(mode_alignment);
+	Eigen::Matrix<f32, Eigen::Dynamic, 1, 0, kRecordsPerBufferIterative, 1> mode_alignment_real = mode_alignment.real();
+	Eigen::Matrix<f32, Eigen::Dynamic, 1, 0, kRecordsPerBufferIterative, 1> mode_alignment_imag = mode_alignment.imag();
+
+	// The adjusted basis is diag(adjustment) * B, so the pattern is adjustment .* (B * responses).
+	// With a fast transform, the responses of all the modes are kept and transformed once on the last buffer of the cycle.
+	// Otherwise, each thread adds up the modes of the buffer for its own block of mode pixels, so no synchronization is needed.
+	if (m_basis.has_fast_transform() && last_buffer_in_cycle) {
+		m_basis.transform(m_mode_responses, m_final_cartesian_patterns.real().col(0), m_final_cartesian_patterns.imag().col(0));
+	}
+	if (!m_basis.has_fast_transform() || last_buffer_in_cycle) {
+		auto mode_pixels_per_block = (m_input_modes + kModePixelBlocks - 1) / kModePixelBlocks;
+		#pragma omp parallel for
+		for (auto block_index = 0; block_index < kModePixelBlocks; ++block_index) {
+			auto mode_pixel_start = mode_pixels_per_block * block_index;
+			auto mode_pixels = (std::min)(mode_pixels_per_block, m_input_modes - mode_pixel_start);
+			if (mode_pixels <= 0) {
+				continue;
+			}
+			if (!m_basis.has_fast_transform()) {
+				auto& basis_block = m_basis_blocks[block_index];
+				if ((basis_block.rows() != mode_pixels) || (basis_block.cols() != m_modes_per_buffer_iterative)) {
+					basis_block.resize(mode_pixels, m_modes_per_buffer_iterative);
+				}
+				m_basis.fill_block(mode_pixel_start, mode_global_start, basis_block.real(), basis_block.imag());
+				accumulate_mode_pixels(mode_pixel_start, basis_block, mode_alignment_real, mode_alignment_imag);
 			}
+
+			// On the last buffer of the cycle, the thread also adjusts its pixels and converts them to phase and DAC values.
+			if (last_buffer_in_cycle) {
+				auto adjustment = m_input_modes_adjustment.segment(mode_pixel_start, mode_pixels);
+				auto pattern_real = m_final_cartesian_patterns.real().block(mode_pixel_start, 0, mode_pixels, 1).array();
+				auto pattern_imag = m_final_cartesian_patterns.imag().block(mode_pixel_start, 0, mode_pixels, 1).array();
+				Eigen::Array<f32, Eigen::Dynamic, 1, 0, kGLVPixels, 1> adjusted_real = pattern_real * adjustment.real().array() - pattern_imag * adjustment.imag().array();
+				pattern_imag = pattern_real * adjustment.imag().array() + pattern_imag * adjustment.real().array();
+				pattern_real = adjusted_real;
+				finalize_mode_pixels(mode_pixel_start, mode_pixels, 1);
+			}
+		}
+	}
+
+	// After the last buffer of the cycle, we finished processing all the modes, load the solution to the GLV.
+	if (last_buffer_in_cycle) {
+		auto loop_cycle_restarted = pace_loop_cycle();
+		m_glv->load_and_resume_cycle(m_final_dac_column);
+		record_cycle(m_mode_responses, m_record_avg_intensity.col(0).mean() - kDAQZeroCode, loop_cycle_restarted);
+		if (!loop_cycle_restarted) {
+			m_pacing_latency_max_us = (std::max)(m_pacing_latency_max_us, m_pacing_hpc.stop().get_time_in_usec());
+			++m_pacing_cycle_count;
 		}
+		count_cycle([this](const f64 cycle_time_us) {
+			spdlog::info("APP: Average cycle time is %f", cycle_time_us);
+			spdlog::info("APP: %f cycles per second, loop cycle wait is %dus", 1e6 / cycle_time_us, m_loopcycle_wait_us);
+		});
 	}
+}
 
-	// Increase the buffer index, which is used in order to compute the index of the mode to be processed.
-	buffer_index = (buffer_index + 1) % m_buffer_count_per_cycle;
 
-	// When the buffer_index returns to zero, we finished processing all the modes.
-	// Compute element wise phase in the range [-PI, PI] and load to the GLV.
-	if (buffer_index == 0) {
-		m_final_phase_column.block(m_mode_start_pixel, 0, m_pixels_per_mode, 1) = m_final_cartesian_pattern.imag().binaryExpr(m_final_cartesian_pattern.real(), std::ptr_fun<f32, f32, f32>(atan2f)).array();
-		m_final_cartesian_pattern.fill(0);
-		m_glv->load_and_resume_cycle(convert_phase_to_glv_dac_column(m_final_phase_column));
-		++m_cycle_count;
-		
-		// Report results.
-		if (m_cycle_count == kTestTrials) {
-			spdlog::info("APP: Average cycle time is %f", m_hpc.stop().get_time_in_usec() / m_cycle_count);
-			m_hpc.start();
-			m_cycle_count = 0;
+void App::on_buffer_receive_run_online_iterative_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	// Find the index of the buffer (preloaded bank) in the cycle, buffers of a resynchronization or of a misaligned cycle are discarded.
+	int buffer_index;
+	bool last_buffer_in_cycle;
+	if (!begin_cycle_buffer(data_index, &buffer_index, &last_buffer_in_cycle)) {
+		return;
+	}
+
+	// Find the mean of the analysis window of each record in the buffer (only channel A is used).
+	average_record_windows(data_ptr, m_records_per_buffer_iterative);
+
+	// Find the optimal phase (in cartesian) of each mode in the group.
+	auto group_index = (m_online_first_group + buffer_index) % m_online_groups;
+	auto mode_alignment = m_mode_responses.segment(m_modes_per_buffer_iterative * group_index, m_modes_per_buffer_iterative);
+	estimate_iterative_mode_responses(mode_alignment);
+
+	// Replace the previous contribution of the group to the solution.
+	// The groups were measured with the basis adjusted by the solution at that time, the aligned contributions add up regardless.
+	m_basis.fill_block(0, m_modes_per_buffer_iterative * group_index, m_online_basis_block);
+	m_online_partial_pattern.noalias() = m_online_basis_block * mode_alignment;
+	m_online_partial_pattern = m_online_adjustment.cwiseProduct(m_online_partial_pattern);
+	m_online_pattern_sum += m_online_partial_pattern - m_online_partial_patterns.col(group_index);
+	m_online_partial_patterns.col(group_index) = m_online_partial_pattern;
+
+	// After the last bank, the GLV waits for the variable column.
+	// Rebuild the banks with the next mode groups around the updated solution, then load the solution.
+	if (last_buffer_in_cycle) {
+		m_final_cartesian_patterns.real().col(0) = m_online_pattern_sum.real();
+		m_final_cartesian_patterns.imag().col(0) = m_online_pattern_sum.imag();
+		finalize_mode_pixels(0, m_input_modes, 1);
+		m_online_adjustment = m_online_pattern_sum.unaryExpr([](const std::complex<f32>& value) {
+			return (std::abs(value) > 0) ? (value / std::abs(value)) : std::complex<f32>{1, 0};
+		});
+		m_online_first_group = (m_online_first_group + m_online_banks) % m_online_groups;
+
+		// The number of banks follows the measured reload cost, a new number of banks moves the end of the loop cycle,
+		// so the next buffer starts a new cycle.
+		auto online_banks = online_iterative_banks();
+		if (online_banks != m_online_banks) {
+			m_online_banks = online_banks;
+			m_buffer_count_per_cycle = m_online_banks;
+			m_first_cycle_data_index = data_index + 1;
+			m_glv->reload_loop_cycle(0, create_online_iterative_dac_columns(), 0, static_cast<u16>(m_records_per_buffer_iterative * m_online_banks - 1));
 		}
+		else {
+			reload_loop_cycle_measured(0, create_online_iterative_dac_columns());
+		}
+		m_glv->load_and_resume_cycle(m_final_dac_column);
+		record_cycle(m_mode_responses, m_record_avg_intensity.col(0).mean() - kDAQZeroCode, true);
+		count_cycle([this](const f64 cycle_time_us) {
+			auto cycle_patterns = m_records_per_buffer_iterative * m_online_banks;
+			auto pattern_duty = cycle_patterns * m_glv_col_period_ns_initial * 1e-3 / cycle_time_us;
+			spdlog::info("APP: Average cycle time is %f usec, %d mode groups are preloaded per cycle", cycle_time_us, m_online_banks);
+			spdlog::info("APP: %f patterns per second, %f%% of the column rate", cycle_patterns * 1e6 / cycle_time_us, 100 * pattern_duty);
+			spdlog::info("APP: Reloading the banks takes %f usec", m_reload_us);
+		});
 	}
 }
 
 
+void App::on_buffer_receive_guarded(u16* const data_ptr, const size_t data_len, const u64 data_index) {
+	// The callback is the cycle path, its heap allocations are counted.
+	AllocationGuard allocation_guard;
+	TraceSpan trace_span{"process_buffer"};
+	m_buffer_receive_ticks = get_clock_ticks();
+	(this->*m_on_buffer_receive)(data_ptr, data_len, data_index);
+	m_flight_recorder.push_buffer(data_ptr, data_len, data_index, m_buffer_receive_ticks, get_clock_ticks());
+}
+
+
 void App::on_daq_timeout() {
+	m_flight_recorder.dump("DAQ timeout");
 }
 
 
-GLVColVectorXs App::convert_phase_to_glv_dac_column(const Eigen::VectorXf& phase_column) {
-	auto dac_column = GLVColVectorXs{kGLVPixels, 1};
+int App::get_daq_acquired_channels() const {
+	// The signal channels, and channel B for the reference power when the power is normalized.
+	return (std::max)(static_cast<int>(m_daq_channels), (m_power_normalization != POWER_NORMALIZATION::NO_NORMALIZATION) ? 2 : 1);
+}
+
+
+u16* App::deinterleave_record_channels(u16* const data_ptr, const int records_per_buffer) {
+	// With multiple channels, the samples are interleaved in the buffer, split them to a contiguous block per channel.
+	if (m_daq_acquired_channels == 1) {
+		return data_ptr;
+	}
+	auto samples_per_channel = m_daq_samples_per_record * records_per_buffer;
+	auto channel_data_ptr = m_deinterleaved_buffer.data();
+	DAQ::deinterleave_channels(data_ptr, channel_data_ptr, channel_data_ptr + samples_per_channel, samples_per_channel);
+	return channel_data_ptr;
+}
+
+
+void App::average_record_windows(u16* const data_ptr, const int records_per_buffer) {
+	TraceSpan trace_span{"average_record_windows"};
+	auto channel_data_ptr = deinterleave_record_channels(data_ptr, records_per_buffer);
+
+	// The records of channel B follow the records of channel A, each is fitted to the analysis window, which starts at m_analysis_window_offset.
+	auto records = records_per_buffer * m_daq_acquired_channels;
+	average_windows(channel_data_ptr, m_daq_samples_per_record, records, m_analysis_window_offset, m_analysis_window_length, Eigen::Map<Eigen::RowVectorXf>(m_record_avg_intensity.data(), records));
 
-	// Atan2 phase is in the range [-PI, PI]. It has two discontinuities which we need to resolve to get an integer index.
-	// This is a description of how it is done:
-	// We multiply by the m_phase_index_coeff to get a number in the range [-m_phase_to_dac_size/2 : m_phase_to_dac_size/2]
-	// and add m_phase_to_dac_size if the number is negative.
-	// For example: 
-	// m_phase_to_dac_size = 100  -> m_phase_index_coeff = 100/2PI
-	// If we have a pixel with phase 3PI/4, the resulting index will be (u16)(3PI/4 * 100/2PI) = 37
-	// If we have a pixel with phase PI, the resulting index will be (u16)(PI * 100/2PI) = 50
-	// If we have a pixel with phase -PI (discontinuity), the resulting index will be (u16)(-PI * 100/2PI + 100) = 50
-	// If we have a pixel with phase -PI/100, the resulting index will be (u16)(-PI/100 * 100/2PI + 100) = 99
-	auto phase_column_to_dac_transformed = phase_column.array() * m_phase_index_coeff;
-	for (auto dac_row_index = 0; dac_row_index < kGLVPixels; ++dac_row_index) {
-		auto m_phase_to_dactransformed = phase_column_to_dac_transformed(dac_row_index);
-		u16 dac_value_index;
-		if (m_phase_to_dactransformed < 0) {
-			dac_value_index = static_cast<u16>(m_phase_to_dactransformed + m_phase_to_dac_size);
+	// Normalize the signal (channel A) by the reference power (channel B).
+	// The sample codes are offset, a ~0V signal has the code kDAQZeroCode.
+	if (m_power_normalization == POWER_NORMALIZATION::NO_NORMALIZATION) {
+		return;
+	}
+	auto signal = m_record_avg_intensity.col(0).array();
+	auto reference = m_record_avg_intensity.col(1).array();
+	if (m_power_normalization == POWER_NORMALIZATION::DIVIDE) {
+		// Keep the signal scale by normalizing to the mean reference power in the buffer.
+		auto reference_mean = reference.mean() - kDAQZeroCode;
+		signal = (signal - kDAQZeroCode) * (reference_mean / (reference - kDAQZeroCode).matrix().cwiseMax(1.0f).array()) + kDAQZeroCode;
+	}
+	if (m_power_normalization == POWER_NORMALIZATION::REGRESS) {
+		// Least squares fit of signal = a + b * reference, remove the part that follows the reference.
+		auto signal_mean = signal.mean();
+		auto reference_mean = reference.mean();
+		auto reference_variance = (reference - reference_mean).square().sum();
+		if (reference_variance > 0) {
+			auto slope = ((signal - signal_mean) * (reference - reference_mean)).sum() / reference_variance;
+			signal -= slope * (reference - reference_mean);
 		}
-		else {
-			dac_value_index = static_cast<u16>(m_phase_to_dactransformed);
+	}
+}
+
+
+void App::sum_record_windows(u16* const data_ptr, const int records_per_buffer) {
+	TraceSpan trace_span{"sum_record_windows"};
+	auto channel_data_ptr = deinterleave_record_channels(data_ptr, records_per_buffer);
+
+	// Same as average_record_windows(), in integers (without the power normalization).
+	auto records = records_per_buffer * m_daq_acquired_channels;
+	sum_windows(channel_data_ptr, m_daq_samples_per_record, records, m_analysis_window_offset, m_analysis_window_length, Eigen::Map<Eigen::RowVectorXi>(m_record_window_sums.data(), records));
+}
+
+
+void App::estimate_tm_mode_responses(Eigen::Ref<Eigen::MatrixXcf> mode_alignment, Eigen::Ref<Eigen::VectorXf> mode_magnitudes) {
+	TraceSpan trace_span{"estimate_mode_responses"};
+	demodulate_tm_responses(m_tm_demodulation_matrix, m_record_avg_intensity.data(), m_daq_channels, mode_alignment, mode_magnitudes);
+}
+
+
+void App::estimate_iterative_mode_responses(Eigen::Ref<Eigen::VectorXcf> mode_responses) {
+	for (auto mode_index = 0; mode_index < mode_responses.size(); mode_index++) {
+		// The mean of each record of the mode (i.e. added phase) as a row vector with m_iterative_phase_steps entries.
+		auto mode_avg_intensity_per_phase_addition = m_record_avg_intensity.block(mode_index * m_iterative_phase_steps, 0, m_iterative_phase_steps, 1).transpose();
+
+		// The intensity follows I(phi) = A + B*cos(phi - phi_opt) over the phase steps, so the first harmonic of the
+		// phase stepped intensities, sum(I(k) * exp(j*phi(k))), has the argument phi_opt.
+		// Unlike picking the maximal intensity, the estimate is not quantized to the phase step.
+		// A flat response (e.g. no light on the mode) has no phase, the mode then keeps its phase.
+		std::complex<f32> first_harmonic = (mode_avg_intensity_per_phase_addition.cast<std::complex<f32>>() * m_iterative_phase_step_in_cartesian)(0);
+		auto first_harmonic_magnitude = std::abs(first_harmonic);
+		mode_responses(mode_index) = (first_harmonic_magnitude > 0) ? first_harmonic / first_harmonic_magnitude : std::complex<f32>{1, 0};
+	}
+}
+
+
+void App::finalize_tm_mode_responses() {
+	// Sum up all the modes by their latest responses, then convert to phase and DAC values in parallel.
+	for (auto channel_index = 0; channel_index < m_daq_channels; ++channel_index) {
+		m_basis.transform(m_tm_mode_responses.col(channel_index), m_final_cartesian_patterns.real().col(channel_index), m_final_cartesian_patterns.imag().col(channel_index));
+	}
+	auto mode_pixels_per_block = (m_input_modes + kModePixelBlocks - 1) / kModePixelBlocks;
+	#pragma omp parallel for
+	for (auto block_index = 0; block_index < kModePixelBlocks; ++block_index) {
+		auto mode_pixel_start = mode_pixels_per_block * block_index;
+		auto mode_pixels = (std::min)(mode_pixels_per_block, m_input_modes - mode_pixel_start);
+		if (mode_pixels > 0) {
+			finalize_mode_pixels(mode_pixel_start, mode_pixels, m_daq_channels);
 		}
-		dac_column(dac_row_index) = m_phase_to_dac[dac_value_index];
 	}
+}
+
+
+bool App::use_fixed_point_tm() const {
+	return m_fixed_point_tm && (m_input_mode_basis == INPUT_MODE_BASIS::HADAMARD) && (m_power_normalization == POWER_NORMALIZATION::NO_NORMALIZATION) &&
+		(m_rolling_tm_buffers == 0) && !m_adaptive_tm;
+}
+
+
+void App::create_fixed_point_tm_demodulation_matrix() {
+	// Only the phase of the response is used, so the demodulation matrix is scaled to integers, the largest coefficient is 2^bits.
+	// The window sums of the 12 bit samples (offset removed) are bounded by window length * 2^11, so each demodulated value is bounded
+	// by window length * 2^11 * 2^bits * (largest row sum of the coefficients, relative to the largest coefficient), which must fit in i32.
+	// For example, a 50 sample window with 3 patterns (row sum of 2) leaves 13 bits, so the full 12 bits are used.
+	auto coefficient_max = m_tm_demodulation_matrix.cwiseAbs().maxCoeff();
+	auto row_sum_max = m_tm_demodulation_matrix.cwiseAbs().rowwise().sum().maxCoeff() / coefficient_max;
+	auto window_sum_max = static_cast<f64>(m_analysis_window_length) * (1 << (15 - kDAQSampleShift));
+	m_tm_demodulation_bits = static_cast<int>(std::floor(std::log2((std::numeric_limits<i32>::max)() / (window_sum_max * row_sum_max))));
+	m_tm_demodulation_bits = (std::max)(0, (std::min)(m_tm_demodulation_bits, kFixedPointDemodulationBits));
+	m_tm_demodulation_matrix_fixed_point = (m_tm_demodulation_matrix * (std::ldexp(1.0f, m_tm_demodulation_bits) / coefficient_max)).array().round().cast<i32>();
+}
+
+
+void App::estimate_fixed_point_tm_mode_responses(Eigen::Ref<Eigen::MatrixXi> mode_alignment_real, Eigen::Ref<Eigen::MatrixXi> mode_alignment_imag, Eigen::Ref<Eigen::VectorXf> mode_magnitudes) {
+	TraceSpan trace_span{"estimate_mode_responses"};
+	demodulate_fixed_point_tm_responses(m_tm_demodulation_matrix_fixed_point, m_record_window_sums.data(), m_daq_channels, mode_alignment_real, mode_alignment_imag, mode_magnitudes);
+}
+
+
+void App::clear_cycle_accumulators() {
+	// Drops the partial sums of an interrupted cycle (float and fixed point), so the next cycle starts from zero.
+	m_final_cartesian_patterns.setZero();
+	m_final_patterns_real_fixed_point.setZero();
+	m_final_patterns_imag_fixed_point.setZero();
+}
+
+
+void App::finalize_fixed_point_mode_pixels(const int mode_pixel_start, const int mode_pixels, const int channels) {
+	TraceSpan trace_span{"finalize_mode_pixels"};
+	// The integer sums are converted to floats only for the phase, then cleared for the next cycle.
+	auto patterns_real = m_final_patterns_real_fixed_point.block(mode_pixel_start, 0, mode_pixels, channels);
+	auto patterns_imag = m_final_patterns_imag_fixed_point.block(mode_pixel_start, 0, mode_pixels, channels);
+	m_final_cartesian_patterns.real().block(mode_pixel_start, 0, mode_pixels, channels) = patterns_real.cast<f32>();
+	m_final_cartesian_patterns.imag().block(mode_pixel_start, 0, mode_pixels, channels) = patterns_imag.cast<f32>();
+	patterns_real.fill(0);
+	patterns_imag.fill(0);
+	finalize_mode_pixels(mode_pixel_start, mode_pixels, channels);
+}
+
+
+void App::reset_reload_cost() {
+	// Until a reload is measured, it costs at least its UART waits (LOOPSTOP, USB and LOOPCYCLE).
+	m_reload_us = 3 * kGLVReloadSleep_ms * 1e3;
+}
+
+
+bool App::reload_loop_cycle_measured(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) {
+	HPC reload_hpc;
+	reload_hpc.start();
+	auto reloaded = m_glv->reload_loop_cycle(column_start, dac_frame);
+	m_reload_us = (std::max)(m_reload_us, reload_hpc.stop().get_time_in_usec());
+	return reloaded;
+}
+
+
+bool App::reload_pays_off(const f64 saved_us) const {
+	// A reload on the cycle path stalls the GLV, it only pays off if the patterns it saves take longer to display.
+	return saved_us > m_reload_us;
+}
+
+
+void App::reset_adaptive_tm() {
+	// Start with all the modes as dominant (as preloaded), the first schedule is built after the first cycle.
+	m_adaptive_tm_schedule.resize(m_input_modes);
+	std::iota(m_adaptive_tm_schedule.begin(), m_adaptive_tm_schedule.end(), 0);
+	m_adaptive_tm_dominant_groups = m_tm_buffer_count;
+	m_adaptive_tm_weak_group = 0;
+	m_adaptive_tm_cycles = kAdaptiveTMScheduleCycles - 1;
+	reset_reload_cost();
+}
+
+
+void App::reschedule_adaptive_tm() {
+	// Sort the modes by their response magnitude, the strongest modes which hold kAdaptiveTMDominantEnergy of the
+	// response energy are dominant (rounded up to whole groups). At least one group is left for the weak modes.
+	// Equal magnitudes keep the order of the modes, std::stable_sort would allocate its buffer on the cycle path.
+	std::iota(m_adaptive_tm_schedule.begin(), m_adaptive_tm_schedule.end(), 0);
+	std::sort(m_adaptive_tm_schedule.begin(), m_adaptive_tm_schedule.end(), [this](const int mode_a, const int mode_b) {
+		auto magnitude_a = m_tm_mode_magnitudes(mode_a);
+		auto magnitude_b = m_tm_mode_magnitudes(mode_b);
+		return (magnitude_a > magnitude_b) || ((magnitude_a == magnitude_b) && (mode_a < mode_b));
+	});
+	auto energy_threshold = kAdaptiveTMDominantEnergy * m_tm_mode_magnitudes.squaredNorm();
+	f32 energy = 0;
+	auto dominant_modes = 0;
+	while ((dominant_modes < m_input_modes) && (energy < energy_threshold)) {
+		auto magnitude = m_tm_mode_magnitudes(m_adaptive_tm_schedule[dominant_modes++]);
+		energy += magnitude * magnitude;
+	}
+	m_adaptive_tm_dominant_groups = (dominant_modes + kModesPerBufferTM - 1) / kModesPerBufferTM;
+	m_adaptive_tm_dominant_groups = (std::max)(1, (std::min)(m_adaptive_tm_dominant_groups, m_tm_buffer_count - 1));
+
+	// The weak group is reloaded on the cycle path, unless it pays off all the modes are measured every cycle, without reloads.
+	if (!reload_pays_off(adaptive_tm_skipped_us())) {
+		m_adaptive_tm_dominant_groups = m_tm_buffer_count;
+	}
+
+	// The weak modes take turns in their natural order.
+	std::sort(m_adaptive_tm_schedule.begin() + kModesPerBufferTM * m_adaptive_tm_dominant_groups, m_adaptive_tm_schedule.end());
+	m_adaptive_tm_weak_group = 0;
+	m_adaptive_tm_cycles = 0;
+	m_buffer_count_per_cycle = m_adaptive_tm_dominant_groups + ((adaptive_tm_weak_groups() > 0) ? 1 : 0);
+}
+
+
+int App::adaptive_tm_weak_groups() const {
+	return m_tm_buffer_count - m_adaptive_tm_dominant_groups;
+}
+
+
+f64 App::adaptive_tm_skipped_us() const {
+	// The weak groups which are not measured in a cycle, at the column rate.
+	auto skipped_groups = (std::max)(0, adaptive_tm_weak_groups() - 1);
+	return skipped_groups * m_records_per_buffer_tm * m_glv_col_period_ns_initial * 1e-3;
+}
+
+
+GLVFrameXs::ColsBlockXpr App::create_adaptive_tm_dac_columns(const bool weak_group_only) {
+	// The columns of the dominant groups are followed by the columns of the current weak group.
+	// They are created in the reload buffers of the run (see allocate_cycle_buffers), so the reload doesn't allocate.
+	auto dominant_modes = kModesPerBufferTM * m_adaptive_tm_dominant_groups;
+	auto weak_group_start = m_adaptive_tm_schedule.begin() + dominant_modes + kModesPerBufferTM * m_adaptive_tm_weak_group;
+	m_reload_modes.clear();
+	if (!weak_group_only) {
+		m_reload_modes.insert(m_reload_modes.end(), m_adaptive_tm_schedule.begin(), m_adaptive_tm_schedule.begin() + dominant_modes);
+	}
+	if (adaptive_tm_weak_groups() > 0) {
+		m_reload_modes.insert(m_reload_modes.end(), weak_group_start, weak_group_start + kModesPerBufferTM);
+	}
+	auto columns = static_cast<Eigen::Index>(m_reload_modes.size()) * m_tm_patterns_per_mode;
+	fill_tm_phase_columns(m_reload_modes, m_reload_cartesian_columns, m_reload_phase_columns);
+	convert_phase_to_glv_dac_columns(m_reload_phase_columns.leftCols(columns), m_reload_dac_columns.leftCols(columns));
+	return m_reload_dac_columns.leftCols(columns);
+}
+
+
+void App::reset_online_iterative() {
+	// Start from the adjustment of the run (the previous solution, if used) with no contribution from any group.
+	m_online_groups = m_input_modes / m_modes_per_buffer_iterative;
+	m_online_first_group = 0;
+	reset_reload_cost();
+	m_online_banks = online_iterative_banks();
+	m_buffer_count_per_cycle = m_online_banks;
+	m_online_adjustment = m_input_modes_adjustment;
+	m_online_partial_patterns = Eigen::MatrixXcf::Zero(m_input_modes, m_online_groups);
+	m_online_pattern_sum = Eigen::VectorXcf::Zero(m_input_modes);
+	m_online_basis_block = Eigen::MatrixXcf{m_input_modes, m_modes_per_buffer_iterative};
+	m_online_partial_pattern = Eigen::VectorXcf{m_input_modes};
+	reset_final_dac_column();
+}
+
+
+int App::online_iterative_banks() const {
+	// The banks are reloaded every loop cycle, which only pays off if displaying them takes longer than the reload.
+	auto bank_us = m_records_per_buffer_iterative * m_glv_col_period_ns_initial * 1e-3;
+	auto banks = static_cast<int>(std::ceil(m_reload_us / bank_us));
+	return (std::max)(kOnlineIterativeBanks, (std::min)(banks, m_online_groups));
+}
+
+
+GLVFrameXs::ColsBlockXpr App::create_online_iterative_dac_columns() {
+	// The banks hold the phase steps of the modes of the next groups, adjusted by the current solution.
+	// The pixels out of the modes are the same as in the solution.
+	// They are created in the reload buffer of the run (see allocate_cycle_buffers), so the reload doesn't allocate.
+	auto dac_frame = m_reload_dac_columns.leftCols(m_records_per_buffer_iterative * m_online_banks);
+	auto modes_per_bank = m_modes_per_buffer_iterative;
+	#pragma omp parallel for
+	for (auto col_index = 0; col_index < dac_frame.cols(); ++col_index) {
+		auto bank_mode_index = col_index / m_iterative_phase_steps;
+		auto group_index = (m_online_first_group + bank_mode_index / modes_per_bank) % m_online_groups;
+		auto mode = modes_per_bank * group_index + (bank_mode_index % modes_per_bank);
+		auto added_phase = m_iterative_phase_step_in_cartesian(col_index % m_iterative_phase_steps);
+		dac_frame.col(col_index) = m_final_dac_column;
+		for (auto mode_pixel_index = 0; mode_pixel_index < m_input_modes; ++mode_pixel_index) {
+			auto phase = std::arg(m_online_adjustment(mode_pixel_index) * m_basis.element(mode_pixel_index, mode) * added_phase);
+			auto pixel_index = m_mode_start_pixel + m_glv_mode_pixel_ratio * mode_pixel_index;
+			dac_frame.col(col_index).segment(pixel_index, m_glv_mode_pixel_ratio).fill(convert_phase_to_glv_dac_value(phase));
+		}
+	}
+	return dac_frame;
+}
+
+
+void App::reset_loop_cycle_pacing() {
+	m_pacing_latency_max_us = 0;
+	m_pacing_cycle_count = 0;
+}
+
+
+bool App::pace_loop_cycle() {
+	// Tune once every kTestTrials measured cycles.
+	if (!m_adaptive_pacing || (m_pacing_cycle_count < kTestTrials)) {
+		return false;
+	}
+
+	// The wait has to cover the worst processing and upload latency, plus a margin.
+	auto wait_us = static_cast<u32>(m_pacing_latency_max_us * (1 + kGLVLoopCycleWaitMargin));
+	wait_us = (std::max)(wait_us, kGLVLoopCycleWaitMin_us);
+	reset_loop_cycle_pacing();
+
+	// Restarting the loop cycle stalls on the UART commands, so only shorten the wait when it is considerably shorter.
+	// A longer wait is always applied.
+	if ((wait_us <= m_loopcycle_wait_us) && (wait_us >= (m_loopcycle_wait_us >> 1))) {
+		return false;
+	}
+
+	// This is called once all the buffers of the cycle arrived, so the GLV waits for the variable column.
+	m_loopcycle_wait_us = wait_us;
+	m_glv->restart_loop_cycle(m_loopcycle_wait_us);
+	AllocationPause allocation_pause;
+	spdlog::info("APP: Loop cycle wait was changed to %dus", m_loopcycle_wait_us);
+	return true;
+}
+
+
+void App::reset_buffer_alignment(const int records_per_buffer) {
+	m_records_per_buffer = records_per_buffer;
+	m_first_cycle_data_index = 1;  // The DAQ numbers the buffers from 1.
+	m_last_data_index = 0;
+	m_filler_buffers = 0;
+	m_trigger_count_valid = false;
+	m_stall_trigger_count = 0;
+	m_stall_data_index = 0;
+}
+
+
+bool App::start_synchronized_loop_cycle(const int records_per_buffer) {
+	reset_buffer_alignment(records_per_buffer);
+	reset_final_dac_column();
+
+	// Triggers which arrive before the board is armed are lost, so only start the GLV after the DAQ is armed.
+	if (!m_daq->wait_for_armed(kDAQArmTimeout_ms)) {
+		spdlog::error("APP: DAQ failed to arm");
+		m_daq->stop();
+		return false;
+	}
+
+	// Trigger counts are relative to the count when armed.
+	m_trigger_count_valid = m_daq->get_trigger_count(&m_trigger_count_at_arm);
+	if (!m_trigger_count_valid) {
+		spdlog::warn("APP: Failed to read the DAQ trigger count, buffers will not be checked for alignment");
+	}
+	m_hpc.start();
+	m_glv->run_loop_cycle();
+	return true;
+}
+
+
+bool App::align_buffer_to_cycle(const u64 data_index, int* buffer_index) {
+	m_last_data_index = data_index;
+
+	// Buffers which hold the records of a resynchronization are discarded, the next buffer starts a new cycle.
+	// Once all were discarded, resume the loop cycle with the current solution.
+	// The GLV waits for the variable column after the filler columns, so the loop cycle resumes with the short UART wait.
+	if (m_filler_buffers > 0) {
+		std::lock_guard<std::mutex> lock(m_resync_mtx);
+		m_first_cycle_data_index = data_index + 1;
+		if (--m_filler_buffers == 0) {
+			clear_cycle_accumulators();
+			m_glv->resume_loop_cycle();
+			m_glv->load_and_resume_cycle(m_final_dac_column);
+			AllocationPause allocation_pause;
+			spdlog::info("APP: Resynchronized");
+		}
+		return false;
+	}
+	*buffer_index = static_cast<int>((data_index - m_first_cycle_data_index) % m_buffer_count_per_cycle);
+	return true;
+}
+
+
+bool App::check_cycle_alignment(const u64 data_index) {
+	// At the end of a cycle the GLV waits for the variable column, so every trigger so far should be in the received buffers.
+	u32 trigger_count;
+	if (!m_trigger_count_valid || !m_daq->get_trigger_count(&trigger_count)) {
+		return true;
+	}
+	auto pending_records = static_cast<i64>(static_cast<u32>(trigger_count - m_trigger_count_at_arm)) - static_cast<i64>(data_index * m_records_per_buffer);
+	if (pending_records <= 0) {
+		return true;
+	}
+	AllocationPause allocation_pause;
+	spdlog::warn("APP: %d unexpected triggers, resynchronizing", pending_records);
+	resynchronize(pending_records);
+	return false;
+}
+
+
+bool App::begin_cycle_buffer(const u64 data_index, int* buffer_index, bool* last_buffer_in_cycle) {
+	if (!align_buffer_to_cycle(data_index, buffer_index)) {
+		return false;
+	}
+
+	// The latency of the cycle is measured from the arrival of its last buffer until the solution is uploaded.
+	// If the board triggered more than expected, the records were not aligned with the patterns, so the cycle is dropped.
+	*last_buffer_in_cycle = (*buffer_index == (m_buffer_count_per_cycle - 1));
+	if (*last_buffer_in_cycle) {
+		m_pacing_hpc.start();
+		if (!check_cycle_alignment(data_index)) {
+			clear_cycle_accumulators();
+			return false;
+		}
+	}
+	return true;
+}
+
+
+void App::check_for_stalled_cycle() {
+	// A lost trigger stalls the cycle, the GLV waits for the variable column while the DAQ waits for the rest of the last buffer.
+	// The cycle stalled if neither triggers nor buffers arrived since the last check, and a buffer is partially filled.
+	u32 trigger_count;
+	if (!m_trigger_count_valid || (m_filler_buffers > 0) || !m_daq->get_trigger_count(&trigger_count)) {
+		return;
+	}
+	u64 last_data_index = m_last_data_index;
+	auto stalled = (trigger_count == m_stall_trigger_count) && (last_data_index == m_stall_data_index);
+	m_stall_trigger_count = trigger_count;
+	m_stall_data_index = last_data_index;
+	auto pending_records = static_cast<i64>(static_cast<u32>(trigger_count - m_trigger_count_at_arm)) - static_cast<i64>(last_data_index * m_records_per_buffer);
+	if (!stalled || (pending_records <= 0) || ((pending_records % m_records_per_buffer) == 0)) {
+		return;
+	}
+	spdlog::warn("APP: Cycle stalled with %d pending records, resynchronizing", pending_records);
+	m_flight_recorder.dump("stalled cycle");
+	resynchronize(pending_records);
+}
+
+
+void App::record_cycle(const Eigen::Ref<const Eigen::VectorXcf>& responses, const f32 focus_signal, const bool loop_cycle_restarted) {
+	// The latency is from the arrival of the last buffer of the cycle (the current buffer) until the upload.
+	// If the loop cycle was restarted (or reloaded) before the upload, it includes the UART waits, so it isn't checked for outliers.
+	auto latency_us = clock_ticks_to_usec(static_cast<i64>(get_clock_ticks() - m_buffer_receive_ticks));
+	m_flight_recorder.push_cycle(responses, m_final_dac_column, latency_us, focus_signal, m_loopcycle_wait_us, !loop_cycle_restarted);
+}
+
+
+template <typename Report>
+void App::count_cycle(Report&& report) {
+	// Every kTestTrials cycles, report the average cycle time (the optimization adds its own results).
+	if (++m_cycle_count < kTestTrials) {
+		return;
+	}
+	AllocationPause allocation_pause;
+	auto cycle_time_us = m_hpc.stop().get_time_in_usec() / m_cycle_count;
+	report(cycle_time_us);
+	report_cycle_allocations();
+	m_hpc.start();
+	m_cycle_count = 0;
+}
+
+
+void App::report_cycle_allocations() const {
+	auto allocation_count = AllocationGuard::take_allocation_count();
+	if (allocation_count > 0) {
+		spdlog::warn("APP: %llu heap allocations on the cycle path", allocation_count);
+	}
+}
+
+
+void App::report_decorrelation_time() const {
+	auto decorrelation_time_us = m_decorrelation.get_decorrelation_time_us();
+	if (decorrelation_time_us < 0) {
+		spdlog::info("APP: Medium decorrelation time is not known yet, correlation between sweeps is %f", m_decorrelation.get_correlation());
+		return;
+	}
+	spdlog::info("APP: Medium decorrelation time is %f usec, correlation between sweeps is %f", decorrelation_time_us, m_decorrelation.get_correlation());
+}
+
+
+void App::resynchronize(const i64 pending_records) {
+	// Stop the loop cycle and complete the partially filled buffer with filler columns, so the next cycle starts on a buffer boundary.
+	// The buffers which hold the pending records are discarded, then the loop cycle resumes (see align_buffer_to_cycle).
+	// Called from the run thread and from the DAQ thread, only the first of them resynchronizes. The GLV waits for the
+	// variable column in both cases, so the UART commands use the short wait.
+	std::lock_guard<std::mutex> lock(m_resync_mtx);
+	if (m_filler_buffers > 0) {
+		return;
+	}
+	auto partial_records = static_cast<int>(pending_records % m_records_per_buffer);
+	auto filler_records = (partial_records == 0) ? 0 : (m_records_per_buffer - partial_records);
+	m_filler_buffers = static_cast<int>(pending_records / m_records_per_buffer) + ((partial_records == 0) ? 0 : 1);
+	m_glv->interrupt_loop_cycle(static_cast<u16>(filler_records));
+}
+
+
+void App::reset_final_dac_column() {
+	// The pixels out of the modes don't change during the optimization, so they are converted only once.
+	m_final_dac_column = convert_phase_to_glv_dac_column(Eigen::VectorXf{m_final_phase_columns.col(0)});
+}
+
+
+void App::accumulate_mode_pixels(const int mode_pixel_start, const SplitComplexMatrix& basis_block, const Eigen::Ref<const Eigen::MatrixXf>& modes_real, const Eigen::Ref<const Eigen::MatrixXf>& modes_imag) {
+	TraceSpan trace_span{"accumulate_mode_pixels"};
+	// Adds up the modes of the basis block weighted by their (complex) coefficients, one column per channel.
+	auto pattern_real = m_final_cartesian_patterns.real().block(mode_pixel_start, 0, basis_block.rows(), modes_real.cols());
+	auto pattern_imag = m_final_cartesian_patterns.imag().block(mode_pixel_start, 0, basis_block.rows(), modes_real.cols());
+	accumulate_basis_block(basis_block, m_basis.is_real(), modes_real, modes_imag, pattern_real, pattern_imag);
+}
+
+
+void App::finalize_mode_pixels(const int mode_pixel_start, const int mode_pixels, const int channels) {
+	TraceSpan trace_span{"finalize_mode_pixels"};
+	// Compute element wise phase in the range [-PI, PI] for each channel (vectorized on the split planes), and convert the phase
+	// of channel A to DAC values. Both are computed once per mode pixel, and expanded to the GLV pixels of the mode pixel.
+	Eigen::Matrix<f32, Eigen::Dynamic, Eigen::Dynamic, 0, kGLVPixels, kDAQChannelsMax> phases{mode_pixels, channels};
+	split_complex_angle(m_final_cartesian_patterns.real().block(mode_pixel_start, 0, mode_pixels, channels), m_final_cartesian_patterns.imag().block(mode_pixel_start, 0, mode_pixels, channels), phases);
+	expand_mode_pixel_phases(phases, mode_pixel_start, get_mode_pixel_layout(), get_phase_to_dac(), m_final_phase_columns, m_final_dac_column);
+
+	// Clear the pixels for the next cycle.
+	m_final_cartesian_patterns.real().block(mode_pixel_start, 0, mode_pixels, channels).setZero();
+	m_final_cartesian_patterns.imag().block(mode_pixel_start, 0, mode_pixels, channels).setZero();
+}
+
+
+void App::allocate_cycle_buffers(const int records_per_buffer, const int modes_per_buffer, const int reload_columns) {
+	// All the state which the callbacks write to is sized here once per run, so the cycle path runs without heap allocations
+	// (which AllocationGuard reports). The reload buffers hold the columns which are reloaded to the GLV during the run.
+	m_daq_acquired_channels = get_daq_acquired_channels();
+	allocate_record_windows(records_per_buffer);
+	auto mode_pixels_per_block = (m_input_modes + kModePixelBlocks - 1) / kModePixelBlocks;
+	for (auto block_index = 0; block_index < kModePixelBlocks; ++block_index) {
+		auto mode_pixels = (std::max)(0, (std::min)(mode_pixels_per_block, m_input_modes - mode_pixels_per_block * block_index));
+		m_basis_blocks[block_index].resize(mode_pixels, modes_per_buffer);
+		m_hadamard_blocks[block_index].resize(mode_pixels, modes_per_buffer);
+	}
+	m_reload_modes.reserve(m_input_modes);
+	m_reload_cartesian_columns.resize(kGLVPixels, reload_columns);
+	m_reload_phase_columns.resize(kGLVPixels, reload_columns);
+	m_reload_dac_columns.resize(kGLVPixels, reload_columns);
+	AllocationGuard::take_allocation_count();
+}
+
+
+void App::allocate_record_windows(const int records_per_buffer) {
+	m_deinterleaved_buffer.resize(m_daq_samples_per_record * records_per_buffer * m_daq_acquired_channels);
+	m_record_avg_intensity = Eigen::MatrixXf{records_per_buffer, m_daq_acquired_channels};
+	m_record_window_sums = Eigen::MatrixXi{records_per_buffer, m_daq_acquired_channels};
+}
+
+
+u16 App::convert_phase_to_glv_dac_value(const f32 phase) const {
+	return convert_phase_to_dac_value(get_phase_to_dac(), phase);
+}
+
+
+ModePixelLayout App::get_mode_pixel_layout() const {
+	return ModePixelLayout{m_mode_start_pixel, m_glv_mode_pixel_ratio};
+}
+
+
+PhaseToDAC App::get_phase_to_dac() const {
+	return PhaseToDAC{m_phase_to_dac, m_phase_to_dac_size, m_phase_index_coeff};
+}
+
+
+GLVColVectorXs App::convert_phase_to_glv_dac_column(const Eigen::VectorXf& phase_column) {
+	auto dac_column = GLVColVectorXs{kGLVPixels, 1};
+	convert_phase_to_glv_dac_columns(phase_column, dac_column);
 	return dac_column;
 }
 
 
 GLVFrameXs App::convert_phase_to_glv_dac_column(const Eigen::MatrixXf& phase_frame) {
 	auto dac_frame = GLVFrameXs{kGLVPixels, phase_frame.cols()};
+	convert_phase_to_glv_dac_columns(phase_frame, dac_frame);
+	return dac_frame;
+}
+
+
+void App::convert_phase_to_glv_dac_columns(const Eigen::Ref<const Eigen::MatrixXf>& phase_frame, Eigen::Ref<GLVFrameXs> dac_frame) const {
 	for (auto col_index = 0; col_index < phase_frame.cols(); ++col_index) {
-		Eigen::VectorXf phase_column = phase_frame.col(col_index);
-		dac_frame.col(col_index) = convert_phase_to_glv_dac_column(phase_column);
+		for (auto dac_row_index = 0; dac_row_index < kGLVPixels; ++dac_row_index) {
+			dac_frame(dac_row_index, col_index) = convert_phase_to_glv_dac_value(phase_frame(dac_row_index, col_index));
+		}
 	}
-	return dac_frame;
 }
 
 
@@ -1265,164 +2563,31 @@ GLVFrameXs App::create_voltage_gratings() {
 
 
 void App::create_input_modes() {
-	// First step, create the input mode matrix with a 1:1 to ratio (each basis pixel is equivalent to an input mode pixel.)
-	auto m_input_modes_matrixratio_1to1_matrix = Eigen::MatrixXcf{m_input_modes, m_input_modes};
+	// The basis elements are generated on demand in mode space (each basis pixel is equivalent to an input mode pixel.)
+	// The pixels are expanded by the GLV to mode pixel ratio only when displayed.
+	m_basis.configure(m_input_mode_basis, m_input_modes);
 
-	// Hadamard basis.
-	// Online implementation from: https://stackoverflow.com/questions/33080313/the-below-code-generates-the-32x32-hadamard-matrix-but-how-do-i-write-it-recursi
-	if (m_input_mode_basis == INPUT_MODE_BASIS::HADAMARD) {
-		m_input_modes_matrixratio_1to1_matrix(0, 0) = std::complex<f32>{1.0, 0};
-		auto m = 1;
-		while (m < m_input_modes) {
-			for (auto ii = 0; ii < m; ++ii) {
-				for (auto jj = 0; jj < m; ++jj) {
-					m_input_modes_matrixratio_1to1_matrix(ii + m, jj) = m_input_modes_matrixratio_1to1_matrix(ii, jj);
-					m_input_modes_matrixratio_1to1_matrix(ii, jj + m) = m_input_modes_matrixratio_1to1_matrix(ii, jj);
-					m_input_modes_matrixratio_1to1_matrix(ii + m, jj + m) = -m_input_modes_matrixratio_1to1_matrix(ii, jj);
-				}
-			}
-			m = m * 2;
-		}
-	}
-	
-	// Fourier basis.
-	// Implementation from wikipedia. Each DFT matrix column gives two basis elements
-	// Real part corresponds to a cosine wave.
-	// Imaginery part corresponds to a sine wave.
-	// Convert to cartesian complex representation using by cos(x) + jsin(x)
-	if (m_input_mode_basis == INPUT_MODE_BASIS::FOURIER) {
-		auto dftmtx = Eigen::MatrixXcf{m_input_modes, m_input_modes};
-		auto N = static_cast<f32>(m_input_modes);
-		auto w = std::polar(1.0f, -TWOPI_F32 / N);
-		for (auto col_index = 0; col_index < (m_input_modes/2); ++col_index) {
-			for (auto row_index = 0; row_index < m_input_modes; ++row_index) {
-				dftmtx(row_index, col_index) = PI_F32 * pow(w, col_index * row_index);
-				auto cos_cartesian_real = cosf(dftmtx(row_index, col_index).real());
-				auto cos_cartesian_imag = sinf(dftmtx(row_index, col_index).real());
-				auto sin_cartesian_real = cosf(dftmtx(row_index, col_index).imag());
-				auto sin_cartesian_imag = sinf(dftmtx(row_index, col_index).imag());
-				m_input_modes_matrixratio_1to1_matrix(row_index, 2*col_index) = std::complex<f32>{cos_cartesian_real, cos_cartesian_imag};
-				m_input_modes_matrixratio_1to1_matrix(row_index, 2*col_index + 1) = std::complex<f32>{sin_cartesian_real, sin_cartesian_imag};
-			}
+	// The adjustment of the basis which is used by the iterative optimization.
+	m_input_modes_adjustment = Eigen::VectorXcf::Ones(m_input_modes);
+	m_mode_responses = Eigen::VectorXcf::Zero(m_input_modes);
+}
 
-			// Debugging with array plotter, place break point on auto plot_buffer_f32 = ...
-			std::vector<f32> plot_vector(m_input_modes);
-			Eigen::VectorXf::Map(plot_vector.data(), m_input_modes) = dftmtx.col(col_index).real();
-			auto plot_buffer_f32 = plot_vector.data();
-		} 
-	}
 
-	// Second step, according to the glv to mode pixel ratio, expand the pixels.
-	m_input_modes_matrix = Eigen::MatrixXcf::Zero(m_pixels_per_mode, m_input_modes);
-	m_input_modes_matrix_adjusted = Eigen::MatrixXcf::Zero(m_pixels_per_mode, m_input_modes);
-	for (auto col_index = 0; col_index < m_input_modes; ++col_index) {
-		for (auto row_index = 0; row_index < m_input_modes; ++row_index) {
-			for (auto expand_index = 0; expand_index < m_glv_mode_pixel_ratio; ++expand_index) {
-				m_input_modes_matrix(m_glv_mode_pixel_ratio * row_index + expand_index, col_index) = m_input_modes_matrixratio_1to1_matrix(row_index, col_index);
-			}
-		}
+Eigen::VectorXcf App::expand_mode_column(const Eigen::VectorXcf& mode_column) const {
+	// According to the glv to mode pixel ratio, expand the pixels.
+	auto pixel_column = Eigen::VectorXcf{m_pixels_per_mode};
+	for (auto mode_pixel_index = 0; mode_pixel_index < m_input_modes; ++mode_pixel_index) {
+		pixel_column.segment(m_glv_mode_pixel_ratio * mode_pixel_index, m_glv_mode_pixel_ratio).fill(mode_column(mode_pixel_index));
 	}
-
-	// Create a copy of the input modes matrix which is used by the iterative optimization.
-	m_input_modes_matrix_adjusted = m_input_modes_matrix;
+	return pixel_column;
 }
 
 
 Eigen::MatrixXf App::create_preloaded_phase_columns_for_tm_optimization(const bool dump_to_file) {
-	// The nomenclature scheme for adding the reference is:
-	// reference "top"
-	// mode
-	// reference "bottom"	
-	
-	// Iterate and create the reference + modes matrix.
-	auto ref_modes_cartesian_matrix = Eigen::MatrixXcf{kGLVPixels, m_input_modes * kTMInterferencePatternsPerMode};
-	for (auto input_mode_index = 0; input_mode_index < m_input_modes_matrix.cols(); ++input_mode_index) {
-		for (auto add_phase_index = 0; add_phase_index < kTMInterferencePatternsPerMode; ++add_phase_index) {
-			auto ref_modes_col_index = kTMInterferencePatternsPerMode * input_mode_index + add_phase_index;
-
-			// For the case of fixed reference, fill the entire column (top reference + mode + bottom reference) according to the 
-			// phase of the reference. 
-			if ((m_fixed_segment == FIXED_SEGMENT::REFERENCE_AT_ZERO) || (m_fixed_segment == FIXED_SEGMENT::REFERENCE_AT_PI)) {
-				if (m_fixed_segment == FIXED_SEGMENT::REFERENCE_AT_PI) {
-					ref_modes_cartesian_matrix.col(ref_modes_col_index).fill(std::complex<f32>{-1, 0});
-				}
-				else if (m_fixed_segment == FIXED_SEGMENT::REFERENCE_AT_ZERO) {
-					ref_modes_cartesian_matrix.col(ref_modes_col_index).fill(std::complex<f32>{1, 0});
-				}
-
-				if (m_phase_steps == PHASE_STEPS::PI_HALF) {
-					// Overwrite with the input mode in the middle, shifted by an additional phase.
-					switch (add_phase_index) {
-					case 0:  // Phase 0
-						ref_modes_cartesian_matrix.block(m_mode_start_pixel, ref_modes_col_index, m_pixels_per_mode, 1) =
-							m_input_modes_matrix.col(input_mode_index).array() * std::complex<f32>{1, 0};
-						break;
-					case 1:  // Phase PI/2
-						ref_modes_cartesian_matrix.block(m_mode_start_pixel, ref_modes_col_index, m_pixels_per_mode, 1) =
-							m_input_modes_matrix.col(input_mode_index).array() * std::complex<f32>{0, 1};
-						break;
-					case 2:  // Phase PI
-						ref_modes_cartesian_matrix.block(m_mode_start_pixel, ref_modes_col_index, m_pixels_per_mode, 1) =
-							m_input_modes_matrix.col(input_mode_index).array() * std::complex<f32>{-1, 0};
-						break;
-					default:
-						assert(0);
-						break;
-					}
-				}
-				if (m_phase_steps == PHASE_STEPS::PI_QUARTER) {
-					// Overwrite with the input mode in the middle, shifted by an additional phase.
-					switch (add_phase_index) {
-					case 0:  // Phase 0
-						ref_modes_cartesian_matrix.block(m_mode_start_pixel, ref_modes_col_index, m_pixels_per_mode, 1) =
-							(m_input_modes_matrix.col(input_mode_index).array() + std::complex<f32>{1, -2})  * std::complex<f32>{0, 1};
-						break;
-					case 1:  // Phase PI/4
-						ref_modes_cartesian_matrix.block(m_mode_start_pixel, ref_modes_col_index, m_pixels_per_mode, 1) =
-							(m_input_modes_matrix.col(input_mode_index).array() + std::complex<f32>{1, -2})  * std::complex<f32>{-1, 1};
-						break;
-					case 2:  // Phase PI/2
-						ref_modes_cartesian_matrix.block(m_mode_start_pixel, ref_modes_col_index, m_pixels_per_mode, 1) =
-							(m_input_modes_matrix.col(input_mode_index).array() + std::complex<f32>{1, -2})  * std::complex<f32>{-1, 0};
-						break;
-					default:
-						assert(0);
-						break;
-					}
-				}
-			}
-
-			// For the case of fixed mode, fill the entire column (top reference + mode + bottom reference) according to the 
-			// phase of the reference. 
-			if (m_fixed_segment == FIXED_SEGMENT::MODE) {
-				switch (add_phase_index) {
-				case 0:  // First phase step.
-					ref_modes_cartesian_matrix.col(ref_modes_col_index).fill(std::complex<f32>{1, 0});
-					break;
-				case 1:  // Second phase step.
-					if ( m_phase_steps == PHASE_STEPS::PI_HALF )
-						ref_modes_cartesian_matrix.col(ref_modes_col_index).fill(std::complex<f32>{0, 1});
-					if ( m_phase_steps == PHASE_STEPS::PI_QUARTER )
-						ref_modes_cartesian_matrix.col(ref_modes_col_index).fill(std::complex<f32>{1, 1});
-					break;
-				case 2:  // Third phase step.
-					if (m_phase_steps == PHASE_STEPS::PI_HALF )
-						ref_modes_cartesian_matrix.col(ref_modes_col_index).fill(std::complex<f32>{-1, 0});
-					if (m_phase_steps == PHASE_STEPS::PI_QUARTER)
-						ref_modes_cartesian_matrix.col(ref_modes_col_index).fill(std::complex<f32>{0, 1});
-					break;
-				default:
-					assert(0);
-					break;
-				}
-				ref_modes_cartesian_matrix.block(m_mode_start_pixel, ref_modes_col_index, m_pixels_per_mode, 1) =	m_input_modes_matrix.col(input_mode_index);
-			}
-
-		}
-	}
-
-	// Get the phase of the matrix in the range [-PI, PI].
-	Eigen::MatrixXf ref_modes_phase_matrix = ref_modes_cartesian_matrix.imag().binaryExpr(ref_modes_cartesian_matrix.real(), std::ptr_fun<f32, f32, f32>(atan2f)).array();
+	// All the modes in order.
+	std::vector<int> modes(m_input_modes);
+	std::iota(modes.begin(), modes.end(), 0);
+	auto ref_modes_phase_matrix = create_tm_phase_columns(modes);
 
 	// Dump to file.
 	if (dump_to_file) {
@@ -1437,6 +2602,28 @@ Eigen::MatrixXf App::create_preloaded_phase_columns_for_tm_optimization(const bo
 }
 
 
+Eigen::MatrixXf App::create_tm_phase_columns(const std::vector<int>& modes) {
+	auto columns = static_cast<Eigen::Index>(modes.size()) * m_tm_patterns_per_mode;
+	auto ref_modes_cartesian_matrix = SplitComplexMatrix{kGLVPixels, columns};
+	Eigen::MatrixXf ref_modes_phase_matrix{kGLVPixels, columns};
+	fill_tm_phase_columns(modes, ref_modes_cartesian_matrix, ref_modes_phase_matrix);
+	return ref_modes_phase_matrix;
+}
+
+
+void App::fill_tm_phase_columns(const std::vector<int>& modes, SplitComplexMatrix& ref_modes_cartesian_matrix, Eigen::Ref<Eigen::MatrixXf> ref_modes_phase_matrix) {
+	// With a fixed reference, the phases are added to the mode, with a fixed mode, to the reference.
+	auto fixed_reference = 0.0f;
+	if (m_fixed_segment == FIXED_SEGMENT::REFERENCE_AT_ZERO) {
+		fixed_reference = 1.0f;
+	}
+	if (m_fixed_segment == FIXED_SEGMENT::REFERENCE_AT_PI) {
+		fixed_reference = -1.0f;
+	}
+	fill_tm_pattern_columns(m_basis, modes, m_tm_reference_phases, fixed_reference, get_mode_pixel_layout(), ref_modes_cartesian_matrix, ref_modes_phase_matrix);
+}
+
+
 Eigen::MatrixXf App::create_preloaded_phase_columns_for_iterative_optimization(const bool use_prev_solution, const bool dump_to_file) {
 	// The nomenclature scheme for adding the reference is:
 	// reference "top"
@@ -1444,36 +2631,40 @@ Eigen::MatrixXf App::create_preloaded_phase_columns_for_iterative_optimization(c
 	// reference "bottom"	
 	// Note that here, the reference has no meaning, pixels that are not part of the mode, are fixed phase 0.
 	
-	// First, if required, adjust the phase of the input modes by the previous solution, otherwise the adjusted copy is the same as the original.
-	// The adjusted input modes are used during the algorithm process.
+	// First, if required, adjust the phase of the input modes by the previous solution, otherwise the adjusted basis is the same as the original.
+	// The adjusted input modes, diag(adjustment) * B, are used during the algorithm process.
+	m_input_modes_adjustment = Eigen::VectorXcf::Ones(m_input_modes);
 	if (use_prev_solution) {
-		auto m_final_cartesian_patternlocal = Eigen::VectorXcf{m_input_modes_matrix_adjusted.rows(), 1};
+		auto m_final_cartesian_patternlocal = Eigen::VectorXcf{m_input_modes, 1};
 
 		// We don't have the solution in cartesian, only in polar, so transform to cartesian first.
-		m_final_cartesian_patternlocal.real() = m_final_phase_column.block(m_mode_start_pixel, 0, m_pixels_per_mode, 1).array().cos();
-		m_final_cartesian_patternlocal.imag() = m_final_phase_column.block(m_mode_start_pixel, 0, m_pixels_per_mode, 1).array().sin();
-		auto adjustment = m_input_modes_matrix_adjusted.array().colwise() * m_final_cartesian_patternlocal.array();
-		m_input_modes_matrix_adjusted = adjustment;
+		// The solution is expanded to GLV pixels, take the first GLV pixel of each mode pixel.
+		// The solution already includes the previous adjustment, so it replaces the adjustment (instead of compounding it).
+		auto final_phase_mode_pixels = Eigen::Map<const Eigen::VectorXf, 0, Eigen::InnerStride<>>(m_final_phase_columns.col(0).data() + m_mode_start_pixel, m_input_modes, Eigen::InnerStride<>(m_glv_mode_pixel_ratio));
+		m_final_cartesian_patternlocal.real() = final_phase_mode_pixels.array().cos();
+		m_final_cartesian_patternlocal.imag() = final_phase_mode_pixels.array().sin();
+		m_input_modes_adjustment = m_final_cartesian_patternlocal;
 	}
 
 	// Find the phase step size and allocate a cartesian phase step LUT.
-	auto iterative_phase_step = TWOPI_F32 / static_cast<f32>(kIterativePhaseStepsPerMode);
-	m_iterative_phase_step_in_cartesian = Eigen::VectorXcf{kIterativePhaseStepsPerMode, 1};
+	auto iterative_phase_step = TWOPI_F32 / static_cast<f32>(m_iterative_phase_steps);
+	m_iterative_phase_step_in_cartesian = Eigen::VectorXcf{m_iterative_phase_steps, 1};
 
 	// Iterate and create the reference + modes matrix (still in cartesian coordinates).
-	auto ref_modes_cartesian_matrix = Eigen::MatrixXcf{kGLVPixels, m_input_modes * kIterativePhaseStepsPerMode};
-	for (auto input_mode_index = 0; input_mode_index < m_input_modes_matrix.cols(); ++input_mode_index) {
-		for (auto added_phase_index = 0; added_phase_index < kIterativePhaseStepsPerMode; ++added_phase_index) {
-			auto ref_modes_col_index = kIterativePhaseStepsPerMode * input_mode_index + added_phase_index;
+	auto ref_modes_cartesian_matrix = SplitComplexMatrix{kGLVPixels, m_input_modes * m_iterative_phase_steps};
+	for (auto input_mode_index = 0; input_mode_index < m_input_modes; ++input_mode_index) {
+		for (auto added_phase_index = 0; added_phase_index < m_iterative_phase_steps; ++added_phase_index) {
+			auto ref_modes_col_index = m_iterative_phase_steps * input_mode_index + added_phase_index;
 			auto added_phase = added_phase_index * iterative_phase_step;
 			m_iterative_phase_step_in_cartesian[added_phase_index] = std::complex<f32>{cosf(added_phase), sinf(added_phase)};
-			ref_modes_cartesian_matrix.col(ref_modes_col_index) = m_final_phase_column;
-			ref_modes_cartesian_matrix.block(m_mode_start_pixel, ref_modes_col_index, m_pixels_per_mode, 1) = m_input_modes_matrix_adjusted.col(input_mode_index).array() * m_iterative_phase_step_in_cartesian[added_phase_index];
+			ref_modes_cartesian_matrix.real().col(ref_modes_col_index) = m_final_phase_columns.col(0);
+			ref_modes_cartesian_matrix.set_block(m_mode_start_pixel, ref_modes_col_index, expand_mode_column(m_basis.column(input_mode_index).cwiseProduct(m_input_modes_adjustment)) * m_iterative_phase_step_in_cartesian[added_phase_index]);
 		}
 	}
 
 	// Get the phase of the matrix in the range [-PI, PI].
-	Eigen::MatrixXf ref_modes_phase_matrix = ref_modes_cartesian_matrix.imag().binaryExpr(ref_modes_cartesian_matrix.real(), std::ptr_fun<f32, f32, f32>(atan2f)).array();
+	Eigen::MatrixXf ref_modes_phase_matrix{ref_modes_cartesian_matrix.rows(), ref_modes_cartesian_matrix.cols()};
+	split_complex_angle(ref_modes_cartesian_matrix.real(), ref_modes_cartesian_matrix.imag(), ref_modes_phase_matrix);
 
 	// Dump to file.
 	if (dump_to_file) {
@@ -1488,6 +2679,42 @@ Eigen::MatrixXf App::create_preloaded_phase_columns_for_iterative_optimization(c
 }
 
 
+void App::create_tm_demodulation_matrix() {
+	// Find the phases added to the reference (or the mode) on each interference pattern.
+	m_tm_reference_phases = Eigen::VectorXf{m_tm_patterns_per_mode};
+	if (m_tm_patterns_per_mode == TM_INTERFERENCE_PATTERNS::THREE_PATTERNS) {
+		if (m_phase_steps == PHASE_STEPS::PI_HALF) {
+			m_tm_reference_phases << 0, PI_F32 / 2, PI_F32;
+		}
+		if (m_phase_steps == PHASE_STEPS::PI_QUARTER) {
+			m_tm_reference_phases << 0, PI_F32 / 4, PI_F32 / 2;
+		}
+	}
+	else {
+		for (auto pattern_index = 0; pattern_index < m_tm_patterns_per_mode; ++pattern_index) {
+			m_tm_reference_phases(pattern_index) = pattern_index * TWOPI_F32 / m_tm_patterns_per_mode;
+		}
+	}
+
+	// Each interference pattern intensity follows I(k) = A + B*cos(phase(k)) + C*sin(phase(k)).
+	// The least squares solution for [A, B, C] is pinv(S) * I, where S(k, :) = [1, cos(phase(k)), sin(phase(k))].
+	Eigen::MatrixXf S{m_tm_patterns_per_mode, 3};
+	S.col(0).setOnes();
+	S.col(1) = m_tm_reference_phases.array().cos();
+	S.col(2) = m_tm_reference_phases.array().sin();
+	Eigen::MatrixXf S_pinv = (S.transpose() * S).inverse() * S.transpose();
+
+	// With a fixed reference, the phase is added to the mode, I(k) = |R + M*exp(j*phase(k))|^2, so conj(R)*M = (B - jC)/2
+	// and the conjugate response is B + jC.
+	// With a fixed mode, the phase is added to the reference, I(k) = |R*exp(j*phase(k)) + M|^2, so R*conj(M) = (B - jC)/2
+	// is already the conjugate response.
+	m_tm_demodulation_matrix = S_pinv.bottomRows(2);
+	if (m_fixed_segment == FIXED_SEGMENT::MODE) {
+		m_tm_demodulation_matrix.row(1) *= -1;
+	}
+}
+
+
 void App::print_configuration(const OPTIMIZATION_ALGORITHM algorithm) {
 	spdlog::info("APP: \"GLV pixel to mode pixel\" ratio is %d:1", m_glv_mode_pixel_ratio);
 	spdlog::info("APP: Using %d input modes", m_input_modes);
@@ -1510,7 +2737,7 @@ void App::print_configuration(const OPTIMIZATION_ALGORITHM algorithm) {
 		case FIXED_SEGMENT::MODE:
 			spdlog::info("APP: Mode is fixed (reference changes)");
 			std::string reference_during_focus_string;
-			if (m_final_phase_column(0) == PI_F32) {
+			if (m_final_phase_columns(0, 0) == PI_F32) {
 				reference_during_focus_string = "is a high frequency grating";
 			}
 			else {
@@ -1519,9 +2746,30 @@ void App::print_configuration(const OPTIMIZATION_ALGORITHM algorithm) {
 			spdlog::info("APP: Reference on focusing pattern %s", reference_during_focus_string);
 			break;
 		}
+		spdlog::info("APP: Using %d interference patterns per mode", m_tm_patterns_per_mode);
+		if (m_rolling_tm_buffers > 0) {
+			spdlog::info("APP: Rolling, the solution is updated every %d buffers with a forgetting factor of %f", m_rolling_tm_buffers, m_rolling_tm_forgetting);
+		}
+		if (use_fixed_point_tm()) {
+			spdlog::info("APP: Fixed point, the largest demodulation coefficient is 2^%d", m_tm_demodulation_bits);
+		}
+		if (m_adaptive_tm) {
+			spdlog::info("APP: Adaptive, the dominant modes hold %f of the response energy, the schedule is rebuilt every %d cycles", kAdaptiveTMDominantEnergy, kAdaptiveTMScheduleCycles);
+		}
+		spdlog::info("APP: Using %d DAQ channel(s), each with its own solution", m_daq_channels);
+	}
+	if (m_power_normalization == POWER_NORMALIZATION::DIVIDE) {
+		spdlog::info("APP: Signal is divided by the reference power on channel B");
 	}
+	if (m_power_normalization == POWER_NORMALIZATION::REGRESS) {
+		spdlog::info("APP: Signal is regressed on the reference power on channel B");
+	}
+	spdlog::info("APP: Analysis window is samples %d-%d, DAQ record is %d samples with a trigger delay of %d samples", m_analysis_window_start, m_analysis_window_start + m_analysis_window_length - 1, m_daq_samples_per_record, m_daq_trigger_delay_samples);
 	if (algorithm == OPTIMIZATION_ALGORITHM::ITERATIVE) {
-		spdlog::info("APP: Using %d phase steps per mode", kIterativePhaseStepsPerMode);
+		spdlog::info("APP: Using %d phase steps per mode", m_iterative_phase_steps);
+		if (m_online_iterative) {
+			spdlog::info("APP: Online, at least %d mode groups are rebuilt around the solution every loop cycle, as many as cover the reload", kOnlineIterativeBanks);
+		}
 	}
 	spdlog::info("");
 }
\ No newline at end of file
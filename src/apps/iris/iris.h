@@ -1,33 +1,63 @@
 #pragma once
 #include <thread>
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <vector>
 #include "eigen/Eigen/Dense"
 #include "core0/types.h"
 #include "core2/hpc.h"
+#include "core2/pinned_memory.h"
+#include "core2/trace.h"
 #include "alazar_daq/alazar_daq.h"
 #include "glv/glv.h"
+#include "allocation_guard.h"
+#include "backends.h"
+#include "basis.h"
+#include "decorrelation.h"
+#include "flight_recorder.h"
+#include "kernels.h"
+#include "split_complex.h"
 
 // Application defaults.
 const int kInputModes_initial = 256;
 const int kGLVvddah = 340;
-const u32 kGLVLoopCycleWait_us = 50000;
+const u32 kGLVLoopCycleWait_us = 50000;  // Initial wait, the adaptive pacing tunes it during the optimization.
 const std::string kGLVComPort = "COM3";
-const int kTMInterferencePatternsPerMode = 3;
-const int kIterativePhaseStepsPerMode = 16;
+const int kTMInterferencePatternsPerMode_initial = 3;
+const int kIterativePhaseStepsPerMode_initial = 16;
+const int kAnalysisWindowStart_initial = 200;  // The samples (after the trigger) which are averaged in each record of the optimizations.
+const int kAnalysisWindowLength_initial = 50;
 
 // Probably don't need to touch these.
-const int kDAQSamplesPerRecord = 256;
-const int kModesPerBufferTM = 64;  // Each buffer in the TM optimization will contain data for X records, where X = kModesPerBufferTM * kInterferencePatternsPerMode
-                                   // The following must be an integer: (kInputModes * kInterferencePatternsPerMode) / kModesPerBufferTM
-const int kModesPerBufferIterative = 16; // Each buffer in the iterative optimization will contain data for X records, where X = kModesPerBufferIterative * kIterativePhasesPerMode
-                                         // The following must be an integer: (kInputModes * kIterativePhasesPerMode) / kModesPerBufferIterative
+const int kDAQSamplesPerRecord = 256;  // Record length for the calibration, the optimizations derive the record from the analysis window.
+const int kRecordsPerBufferIterative = 256; // Each buffer in the iterative optimization will contain data for X modes, where X = kRecordsPerBufferIterative / #phase steps per mode
+                                           // The following must be an integer: kInputModes / X
 const int kTestTrials = 50;  // Report results every kTestTrials cycles.
-#define DAQ_WORKAROUND
+const u32 kGLVLoopCycleWaitMin_us = 100;  // Lower bound for the adaptive pacing loop cycle wait.
+const f64 kGLVLoopCycleWaitMargin = 0.25;  // The adaptive pacing wait is the worst measured latency plus this fraction.
+const int kWindowDetectionColumnPairs = 64;  // Number of high contrast column pairs cycled for the analysis window detection.
+const int kWindowDetectionMinLength = 16;  // Shortest settled window (samples) the detection accepts.
+const f32 kWindowDetectionTolerance = 0.05f;  // A sample is settled when the step response is within this fraction of the settled step.
+const u32 kDAQArmTimeout_ms = 5000;  // The GLV starts cycling only after the DAQ is armed.
+const u32 kCycleStallCheck_ms = 500;  // Period of the check for cycles stalled by lost triggers.
+const int kModePixelBlocks = 16;  // The mode pixels are split to blocks which are processed in parallel.
+const int kRollingTMBuffers = 4;  // Buffers between the solution updates in the rolling TM optimization (each update restarts the loop cycle).
+const f32 kRollingTMForgetting = 0.9f;  // Weight of the responses of the rolling TM optimization is multiplied by this every update.
+const int kOnlineIterativeBanks = 2;  // Minimum mode groups (DAQ buffers) preloaded per loop cycle in the online iterative optimization.
+const int kAdaptiveTMScheduleCycles = 16;  // Cycles between the rebuilds of the adaptive TM schedule.
+const f32 kAdaptiveTMDominantEnergy = 0.8f;  // The dominant modes, measured every cycle, hold this fraction of the response energy.
+const int kFixedPointDemodulationBits = 12;  // The largest fixed point TM demodulation coefficient is 2^X (less if the analysis window is too long for i32).
+const std::string kTraceFile = "trace.json";  // Timeline of the DAQ, processing and GLV activity, see toggle_trace().
+const size_t kFlightRecorderRawBytes = 64 << 20;  // Raw DAQ buffers kept by the flight recorder (the latest seconds at the usual buffer rates).
+const int kFlightRecorderCycles = 256;  // Cycles (responses and focusing columns) kept by the flight recorder.
+const int kDecorrelationRingSize = 8;  // TM responses (one per sweep of all the modes) kept for the decorrelation time estimate.
 
 
 class App {
 public:
-	App();
+	// The app owns the DAQ and the GLV backends (see backends.h).
+	App(std::unique_ptr<DAQBackend> daq, std::unique_ptr<GLVBackend> glv);
 	~App();
 
 	enum OPTIMIZATION_ALGORITHM {
@@ -59,9 +89,25 @@ public:
 		VOLTAGE_GRATING
 	};
 
+	// Reference phases of the TM optimization when using 3 interference patterns per mode.
 	enum PHASE_STEPS {
-		PI_HALF = 0,
-		PI_QUARTER
+		PI_HALF = 0,  // 0, PI/2, PI
+		PI_QUARTER    // 0, PI/4, PI/2
+	};
+
+	// Number of interference patterns per mode in the TM optimization.
+	// Other than 3, the reference phases are equally spaced: 2PI*k/#patterns.
+	enum TM_INTERFERENCE_PATTERNS {
+		THREE_PATTERNS = 3,
+		FOUR_PATTERNS = 4,
+		FIVE_PATTERNS = 5,
+		EIGHT_PATTERNS = 8
+	};
+
+	enum ITERATIVE_PHASE_STEPS {
+		FOUR = 4,
+		EIGHT = 8,
+		SIXTEEN = 16
 	};
 
 	enum CUSTOM_COLUMN_TYPE {
@@ -72,13 +118,29 @@ public:
 		PHASE_GRATINGS
 	};
 
-	enum INPUT_MODE_BASIS {
-		HADAMARD = 0,
-		FOURIER
+	using INPUT_MODE_BASIS = Basis::INPUT_MODE_BASIS;
+
+	// DAQ channels used in the TM optimization, each channel (detector/target) has its own solution.
+	// The solution of channel A is the one displayed during the optimization.
+	enum DAQ_CHANNELS {
+		SINGLE_CHANNEL = 1,  // Channel A.
+		DUAL_CHANNEL = 2     // Channel A and channel B.
+	};
+
+	// Normalization of the signal (channel A) by the laser power, which is monitored on channel B.
+	// This is applied to each record before the response extraction in both optimizations.
+	enum POWER_NORMALIZATION {
+		NO_NORMALIZATION = 0,
+		DIVIDE,   // Signal is divided by the reference power (relative to the mean reference power in the buffer).
+		REGRESS   // The component of the signal that is linear in the reference power (over the records in the buffer) is removed.
 	};
 
 	// Extracts a voltage curve (file), with a DAQ voltage level for each GLV DAC level.
 	void extract_calibration_curve(const CALIBRATION_TYPE calibration_type);
+
+	// Cycles alternating high contrast columns with the current column period, and sets the analysis window
+	// to the earliest window in which the step response has settled (step response is dumped to a file).
+	void detect_analysis_window();
 	
 	// Runs the TM optimization.
 	void run_tm_optimization();
@@ -94,7 +156,8 @@ public:
 	void stop(const bool silent = false);
 
 	// Displays the solution, which was measured during the experiment, on the GLV.
-	void display_solution(const bool ramp_repetitive = false);
+	// channel selects the solution of a DAQ channel (0 for channel A, 1 for channel B).
+	void display_solution(const bool ramp_repetitive = false, const int channel = 0);
 
 	// Returns true if the app is running.
 	bool is_running();
@@ -114,31 +177,96 @@ public:
 	// Sets the number of GLV pixels used for one mode pixel.
 	void set_glv_mode_pixel_ratio(const PIXEL_RATIO ratio);
 
-	// Sets the phase steps for the TM optimization.
+	// Sets the phase steps for the TM optimization (only used with 3 interference patterns per mode).
 	void set_tm_optimization_phase_steps(const PHASE_STEPS phase_steps);
 
+	// Sets the number of interference patterns per mode for the TM optimization, returns false if the configuration rejects it.
+	bool set_tm_interference_patterns_per_mode(const TM_INTERFERENCE_PATTERNS patterns);
+
+	// Sets the number of phase steps per mode for the iterative optimization, returns false if the configuration rejects it.
+	bool set_iterative_optimization_phase_steps(const ITERATIVE_PHASE_STEPS phase_steps);
+
 	// Sets the input mode basis type.
 	void set_basis_type(const INPUT_MODE_BASIS input_mode_basis);
 
+	// Enables tuning the GLV loop cycle wait from the measured processing and upload latency during the optimization.
+	void set_adaptive_pacing(const bool adaptive_pacing);
+
+	// Enables the rolling TM optimization, in which the solution is updated every #buffers from the latest response of every mode.
+	// Every update, the weight of the previous responses is multiplied by the forgetting factor (0, 1]. Zero buffers disables it.
+	// Unless the window covers all the modes, moving the loop cycle to the next window costs two UART commands (~20ms) per update,
+	// so short windows trade pattern throughput for update rate (the run reports the fraction of the column rate it achieves).
+	// Returns false if the configuration rejects it.
+	bool set_rolling_tm(const int buffers, const f32 forgetting = 1.0f);
+
+	// Enables the adaptive TM optimization, in which the modes with the strongest responses (the dominant modes) are measured
+	// every cycle, while the rest of the modes take turns, one group (DAQ buffer) per cycle.
+	// Returns false if the configuration rejects it.
+	bool set_adaptive_tm(const bool adaptive_tm);
+
+	// Enables the fixed point TM optimization, in which the analysis windows, the demodulation and the accumulation of the modes
+	// are computed in integers, and floats are only used for the final phase of each mode pixel.
+	// Used only with the Hadamard basis, without power normalization, in the TM optimization which measures all the modes every cycle.
+	// Off by default, until it is validated against the float TM optimization on the hardware.
+	// Returns false if the configuration rejects it.
+	bool set_fixed_point_tm(const bool fixed_point_tm);
+
+	// Enables the online iterative optimization, in which the preloaded mode groups are rebuilt around the current solution
+	// every loop cycle, and the solution is updated per mode group.
+	// Returns false if the configuration rejects it.
+	bool set_online_iterative(const bool online_iterative);
+
+	// Sets the analysis window (samples after the trigger) which is averaged in each record of the optimizations.
+	// The DAQ record length and trigger delay are derived from the window.
+	void set_analysis_window(const int window_start, const int window_length, const bool silent = false);
+
+	// Sets the DAQ channels used in the TM optimization, returns false if the configuration rejects it.
+	bool set_daq_channels(const DAQ_CHANNELS channels);
+
+	// Sets the normalization of the signal by the reference power on channel B.
+	// Channel B can't be used as both a reference and a second signal channel.
+	// Returns false if the configuration rejects it.
+	bool set_power_normalization(const POWER_NORMALIZATION power_normalization);
+
+	// Starts tracing the DAQ waits, the processing and the GLV transfers (UART and USB) on one timeline,
+	// or stops and writes the trace to kTraceFile (open it in ui.perfetto.dev or chrome://tracing).
+	void toggle_trace();
+
+	// Dumps the flight recorder (the latest DAQ buffers, responses, focusing columns and timings) to a file.
+	// The run dumps it on its own on anomalies, see FlightRecorder.
+	void dump_flight_recorder();
+
 	// Benchmarks the processing datapath of the application.
 	// Instead of triggering and acquiring real data, we process dummy data as fast as possible and then
 	// send the final result to the GLV module which just sinks the data instead of sending it to the hardware. 
 	// This indicates an upper bound for how fast the application will run without the supporting hardware.
-	// Note: Requires the definition of the macro GLV_PROCESSING_EMULATION in glv.h to include the processing in
-	//       the GLV module.
+	// Note: Requires the null GLV backend (--glv null) to include the processing in the GLV module without a GLV.
 	void test_tm_optimization_compute_performance();
 	void test_iterative_optimization_compute_performance();
 
 
 private:
-	std::unique_ptr<DAQ> m_daq;  
-	std::unique_ptr<GLV> m_glv;
+	std::unique_ptr<DAQBackend> m_daq;
+	std::unique_ptr<GLVBackend> m_glv;
 	int m_input_modes;
 	int m_glv_mode_pixel_ratio;
 	int m_pixels_per_mode;
 	int m_records_per_buffer_tm;
+	int m_tm_patterns_per_mode;
 	int m_records_per_buffer_iterative;
+	int m_modes_per_buffer_iterative;
+	int m_iterative_phase_steps;
 	int m_buffer_count_per_cycle;
+	int m_daq_channels;
+	u32 m_analysis_window_start;
+	u32 m_analysis_window_length;
+	u32 m_analysis_window_offset;
+	u32 m_daq_samples_per_record;
+	u32 m_daq_trigger_delay_samples;
+	int m_detected_window_start;
+	int m_detected_window_length;
+	int m_daq_acquired_channels;
+	POWER_NORMALIZATION m_power_normalization;
 	size_t m_cycle_count;
 	bool m_app_running;
 	bool m_glv_auto_running;
@@ -146,6 +274,11 @@ private:
 	bool m_calibration_loaded;
 	std::thread m_daq_thread;
 	HPC m_hpc;
+	HPC m_pacing_hpc;
+	bool m_adaptive_pacing;
+	u32 m_loopcycle_wait_us;
+	f64 m_pacing_latency_max_us;
+	int m_pacing_cycle_count;
 	int m_mode_start_pixel;
 	u32 m_glv_col_period_ns_initial;
 	f32 m_phase_index_coeff;
@@ -153,28 +286,135 @@ private:
 	u16 m_phase_to_dac_size;
 	FIXED_SEGMENT m_fixed_segment;
 	INPUT_MODE_BASIS m_input_mode_basis;
-	Eigen::MatrixXcf m_input_modes_matrix;
-	Eigen::MatrixXcf m_input_modes_matrix_adjusted;
-	Eigen::VectorXcf m_final_cartesian_pattern;
-	Eigen::VectorXf m_final_phase_column;
+	Basis m_basis;  // In mode space, a mode pixel is expanded to m_glv_mode_pixel_ratio GLV pixels only when displayed.
+	Eigen::VectorXcf m_input_modes_adjustment;  // The iterative optimization uses the basis diag(adjustment) * B, i.e. the previous solution (cartesian).
+	Eigen::VectorXcf m_mode_responses;  // Optimal phase (cartesian) of each mode in the cycle, for bases with a fast transform.
+	std::vector<SplitComplexMatrix> m_basis_blocks;  // Generated basis blocks, one per block of mode pixels.
+	std::vector<Eigen::MatrixXi> m_hadamard_blocks;  // Same as above, for the fixed point TM optimization.
+	SplitComplexMatrix m_final_cartesian_patterns;  // One column per DAQ channel, in mode space.
+	Eigen::MatrixXf m_final_phase_columns;  // One column per DAQ channel.
+	GLVColVectorXs m_final_dac_column;  // The solution of channel A as displayed, only the mode pixels change during the optimization.
+	std::vector<u16, PinnedAllocator<u16>> m_deinterleaved_buffer;  // Processing arena of the records (pinned like the DMA buffers).
+	Eigen::MatrixXf m_record_avg_intensity;  // One column per acquired DAQ channel, one row per record.
+	Eigen::MatrixXi m_record_window_sums;  // Same as above for the fixed point TM optimization, sums of the 12 bit samples (offset removed).
 	PHASE_STEPS m_phase_steps;
+	Eigen::VectorXf m_tm_reference_phases;
+	Eigen::Matrix<f32, 2, Eigen::Dynamic> m_tm_demodulation_matrix;
+	Eigen::Matrix<i32, 2, Eigen::Dynamic> m_tm_demodulation_matrix_fixed_point;
+	int m_tm_demodulation_bits;
+	bool m_fixed_point_tm;
+	Eigen::MatrixXi m_final_patterns_real_fixed_point;  // Accumulated aligned modes (Q14) of the fixed point TM optimization, one column per DAQ channel.
+	Eigen::MatrixXi m_final_patterns_imag_fixed_point;
 	Eigen::VectorXcf m_iterative_phase_step_in_cartesian;
+	int m_rolling_tm_buffers;
+	f32 m_rolling_tm_forgetting;
+	int m_rolling_tm_first_buffer;  // TM buffer (group of modes) the current rolling window starts with.
+	int m_tm_buffer_count;  // Buffers which cover all the modes in the TM optimization.
+	Eigen::MatrixXcf m_tm_mode_responses;  // Latest aligned response of each mode in the TM optimization, one column per DAQ channel.
+	DecorrelationEstimator m_decorrelation;
+	HPC m_decorrelation_hpc;  // Time stamps the TM responses since the start of the optimization.
+	FlightRecorder m_flight_recorder;
+	u64 m_buffer_receive_ticks;  // Arrival of the buffer being processed (clock ticks).
+	bool m_adaptive_tm;
+	Eigen::VectorXf m_tm_mode_magnitudes;  // Latest response magnitude of each mode (channel A) in the TM optimization.
+	std::vector<int> m_adaptive_tm_schedule;  // All the modes, the dominant modes first, followed by the weak modes in groups.
+	int m_adaptive_tm_dominant_groups;
+	int m_adaptive_tm_weak_group;  // Group of weak modes which is measured in the current cycle.
+	int m_adaptive_tm_cycles;  // Cycles since the schedule was rebuilt.
+	bool m_online_iterative;
+	int m_online_groups;
+	int m_online_banks;  // Mode groups preloaded per loop cycle, displaying them must take longer than reloading them.
+	int m_online_first_group;  // Mode group in the first preloaded bank.
+	Eigen::VectorXcf m_online_adjustment;  // Adjustment of the basis in the preloaded banks.
+	Eigen::MatrixXcf m_online_partial_patterns;  // Contribution of each mode group to the solution (in mode space), one column per group.
+	Eigen::VectorXcf m_online_pattern_sum;
+	Eigen::MatrixXcf m_online_basis_block;
+	Eigen::VectorXcf m_online_partial_pattern;  // Contribution of the mode group of the buffer.
+	f64 m_reload_us;  // Worst measured reload of columns on the cycle path, which the patterns it saves must cover.
+	std::vector<int> m_reload_modes;  // Modes of the columns which are reloaded to the GLV during the run.
+	SplitComplexMatrix m_reload_cartesian_columns;  // The reload buffers of the run, see allocate_cycle_buffers().
+	Eigen::MatrixXf m_reload_phase_columns;
+	GLVFrameXs m_reload_dac_columns;
+	void (App::*m_on_buffer_receive)(u16* const data_ptr, const size_t data_len, const u64 data_index);  // Callback of the run, called under an allocation guard.
 	OPTIMIZATION_ALGORITHM m_algorithm_on_last_run;
-	bool m_daq_workaround_first_buffer_flag;
+	int m_records_per_buffer;
+	std::mutex m_resync_mtx;  // Serializes the resynchronization of the run thread (stalls) and the DAQ thread (unexpected triggers).
+	std::atomic<u64> m_first_cycle_data_index;
+	std::atomic<u64> m_last_data_index;
+	std::atomic<int> m_filler_buffers;
+	bool m_trigger_count_valid;
+	u32 m_trigger_count_at_arm;
+	u32 m_stall_trigger_count;
+	u64 m_stall_data_index;
 
 	// Private methods.
 	bool load_phase_to_dac_calibration_file();
 	bool configure(const DAQParams* daq_params, const GLVParams* glv_params);
 	void on_glv_serial_receive(char* const data_ptr, const size_t data_len);
 	void on_buffer_receive_extract_calibration_curve(u16* const data_ptr, const size_t data_len, const u64 data_index);
+	void on_buffer_receive_detect_analysis_window(u16* const data_ptr, const size_t data_len, const u64 data_index);
 	void on_buffer_receive_run_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index);
+	void on_buffer_receive_run_fixed_point_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index);
+	void on_buffer_receive_run_rolling_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index);
+	void on_buffer_receive_run_adaptive_tm_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index);
 	void on_buffer_receive_run_iterative_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index);
+	void on_buffer_receive_run_online_iterative_optimization(u16* const data_ptr, const size_t data_len, const u64 data_index);
+	void on_buffer_receive_guarded(u16* const data_ptr, const size_t data_len, const u64 data_index);
 	void on_daq_timeout();
+	void allocate_cycle_buffers(const int records_per_buffer, const int modes_per_buffer, const int reload_columns);
+	void allocate_record_windows(const int records_per_buffer);
+	void reset_loop_cycle_pacing();
+	void reset_buffer_alignment(const int records_per_buffer);
+	bool start_synchronized_loop_cycle(const int records_per_buffer);
+	bool align_buffer_to_cycle(const u64 data_index, int* buffer_index);
+	bool check_cycle_alignment(const u64 data_index);
+	bool begin_cycle_buffer(const u64 data_index, int* buffer_index, bool* last_buffer_in_cycle);
+	void check_for_stalled_cycle();
+	void resynchronize(const i64 pending_records);
+	void reset_final_dac_column();
+	void accumulate_mode_pixels(const int mode_pixel_start, const SplitComplexMatrix& basis_block, const Eigen::Ref<const Eigen::MatrixXf>& modes_real, const Eigen::Ref<const Eigen::MatrixXf>& modes_imag);
+	void finalize_mode_pixels(const int mode_pixel_start, const int mode_pixels, const int channels);
+	void clear_cycle_accumulators();
+	bool pace_loop_cycle();
+	void record_cycle(const Eigen::Ref<const Eigen::VectorXcf>& responses, const f32 focus_signal, const bool loop_cycle_restarted);
+	template <typename Report> void count_cycle(Report&& report);
+	void report_cycle_allocations() const;
+	void report_decorrelation_time() const;
+	int get_daq_acquired_channels() const;
+	u16* deinterleave_record_channels(u16* const data_ptr, const int records_per_buffer);
+	void average_record_windows(u16* const data_ptr, const int records_per_buffer);
+	void sum_record_windows(u16* const data_ptr, const int records_per_buffer);
+	void estimate_tm_mode_responses(Eigen::Ref<Eigen::MatrixXcf> mode_alignment, Eigen::Ref<Eigen::VectorXf> mode_magnitudes);
+	void finalize_tm_mode_responses();
+	bool use_fixed_point_tm() const;
+	void create_fixed_point_tm_demodulation_matrix();
+	void estimate_fixed_point_tm_mode_responses(Eigen::Ref<Eigen::MatrixXi> mode_alignment_real, Eigen::Ref<Eigen::MatrixXi> mode_alignment_imag, Eigen::Ref<Eigen::VectorXf> mode_magnitudes);
+	void finalize_fixed_point_mode_pixels(const int mode_pixel_start, const int mode_pixels, const int channels);
+	void reset_reload_cost();
+	bool reload_loop_cycle_measured(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame);
+	bool reload_pays_off(const f64 saved_us) const;
+	void reset_adaptive_tm();
+	void reschedule_adaptive_tm();
+	int adaptive_tm_weak_groups() const;
+	f64 adaptive_tm_skipped_us() const;
+	GLVFrameXs::ColsBlockXpr create_adaptive_tm_dac_columns(const bool weak_group_only);
+	void estimate_iterative_mode_responses(Eigen::Ref<Eigen::VectorXcf> mode_responses);
+	void reset_online_iterative();
+	int online_iterative_banks() const;
+	GLVFrameXs::ColsBlockXpr create_online_iterative_dac_columns();
+	u16 convert_phase_to_glv_dac_value(const f32 phase) const;
+	ModePixelLayout get_mode_pixel_layout() const;
+	PhaseToDAC get_phase_to_dac() const;
 	GLVColVectorXs convert_phase_to_glv_dac_column(const Eigen::VectorXf& phase_column);
 	GLVFrameXs convert_phase_to_glv_dac_column(const Eigen::MatrixXf& phase_frame);
+	void convert_phase_to_glv_dac_columns(const Eigen::Ref<const Eigen::MatrixXf>& phase_frame, Eigen::Ref<GLVFrameXs> dac_frame) const;
 	GLVFrameXs create_voltage_gratings();
 	void create_input_modes();
+	Eigen::VectorXcf expand_mode_column(const Eigen::VectorXcf& mode_column) const;
+	void create_tm_demodulation_matrix();
 	Eigen::MatrixXf create_preloaded_phase_columns_for_tm_optimization(const bool dump_to_file = false);
+	Eigen::MatrixXf create_tm_phase_columns(const std::vector<int>& modes);
+	void fill_tm_phase_columns(const std::vector<int>& modes, SplitComplexMatrix& ref_modes_cartesian_matrix, Eigen::Ref<Eigen::MatrixXf> ref_modes_phase_matrix);
 	Eigen::MatrixXf create_preloaded_phase_columns_for_iterative_optimization(const bool use_prev_solution, const bool dump_to_file = false);
 	void print_configuration(const OPTIMIZATION_ALGORITHM algorithm);
 }; 
\ No newline at end of file
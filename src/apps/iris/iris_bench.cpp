@@ -0,0 +1,576 @@
+// Micro-benchmarks of the processing kernels of iris (kernels.h), without the DAQ and the GLV.
+// Each kernel is swept over the dimensions it depends on (mode count, GLV to mode pixel ratio, basis, threads) and timed per call,
+// on Linux the hardware counters of the calls are read as well (cycles, IPC, last level cache misses). The results are written as JSON.
+// Usage: iris_bench [--modes 64,256,1024] [--ratios 1,2,4] [--threads 1,2,4] [--basis hadamard,fourier] [--min-time-ms 200] [--filter kernel] [--out iris_bench.json]
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <random>
+#include <numeric>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include "core2/clock.h"
+#include "kernels.h"
+
+namespace {
+const f32 kPI = 3.1415927f;
+const int kBenchModePixelBlocks = 16;  // Same split of the mode pixels as kModePixelBlocks of the application.
+const int kBenchPatternsPerMode = 3;
+const int kBenchSamplesPerRecord = 256;
+const int kBenchWindowOffset = 200;
+const int kBenchWindowLength = 50;
+const int kBenchPhaseToDACSize = 4096;
+const int kBenchMinIterations = 10;
+const int kBenchMaxIterations = 1 << 20;
+
+
+struct Options {
+	std::vector<int> modes = {64, 128, 256, 512, 1024};
+	std::vector<int> ratios = {1, 2, 4};
+	std::vector<int> threads;
+	std::vector<Basis::INPUT_MODE_BASIS> bases = {Basis::INPUT_MODE_BASIS::HADAMARD, Basis::INPUT_MODE_BASIS::FOURIER};
+	f64 min_time_ms = 200;
+	std::string filter;
+	std::string out = "iris_bench.json";
+};
+
+
+// One benchmark case, the dimensions which the kernel doesn't depend on are -1.
+struct Case {
+	std::string kernel;
+	std::string basis;
+	int modes;
+	int pixel_ratio;
+	int threads;
+};
+
+
+// Hardware counters of the calls, summed over the threads which ran them.
+struct Counters {
+	bool valid;
+	f64 cycles;
+	f64 instructions;
+	f64 llc_misses;
+};
+
+
+#if defined(__linux__)
+// A group of counters (cycles, instructions, cache misses) per thread of the team, only the user space of the process is counted.
+class PerfCounters {
+public:
+	static const int kEvents = 3;
+
+	void open(const int threads) {
+		m_fds.assign(threads * kEvents, -1);
+		run_on_threads(threads, [this](const int thread_index) {
+			const u64 configs[kEvents] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+			for (auto event_index = 0; event_index < kEvents; ++event_index) {
+				perf_event_attr attr{};
+				attr.size = sizeof(attr);
+				attr.type = PERF_TYPE_HARDWARE;
+				attr.config = configs[event_index];
+				attr.disabled = (event_index == 0) ? 1 : 0;
+				attr.exclude_kernel = 1;
+				attr.exclude_hv = 1;
+				attr.read_format = PERF_FORMAT_GROUP;
+				auto group_fd = (event_index == 0) ? -1 : m_fds[thread_index * kEvents];
+				m_fds[thread_index * kEvents + event_index] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0));
+			}
+		});
+	}
+
+	bool is_valid() const {
+		return !m_fds.empty() && std::all_of(m_fds.begin(), m_fds.end(), [](const int fd) { return fd >= 0; });
+	}
+
+	void start(const int threads) {
+		run_on_threads(threads, [this](const int thread_index) {
+			auto fd = m_fds[thread_index * kEvents];
+			ioctl(fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+			ioctl(fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+		});
+	}
+
+	Counters stop(const int threads) {
+		std::vector<u64> values(threads * kEvents, 0);
+		run_on_threads(threads, [this, &values](const int thread_index) {
+			auto fd = m_fds[thread_index * kEvents];
+			ioctl(fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+			u64 group[1 + kEvents] = {};
+			if (read(fd, group, sizeof(group)) == static_cast<ssize_t>(sizeof(group))) {
+				std::copy(group + 1, group + 1 + kEvents, values.begin() + thread_index * kEvents);
+			}
+		});
+		Counters counters{true, 0, 0, 0};
+		for (auto thread_index = 0; thread_index < threads; ++thread_index) {
+			counters.cycles += static_cast<f64>(values[thread_index * kEvents]);
+			counters.instructions += static_cast<f64>(values[thread_index * kEvents + 1]);
+			counters.llc_misses += static_cast<f64>(values[thread_index * kEvents + 2]);
+		}
+		return counters;
+	}
+
+	void close() {
+		for (auto fd : m_fds) {
+			if (fd >= 0) {
+				::close(fd);
+			}
+		}
+		m_fds.clear();
+	}
+
+private:
+	std::vector<int> m_fds;
+
+	// The counters count the thread which opened them, so every thread of the team handles its own.
+	// The OpenMP runtime keeps its pool, so a team of the same size runs on the same threads.
+	static void run_on_threads(const int threads, const std::function<void(int)>& task) {
+#ifdef _OPENMP
+		#pragma omp parallel num_threads(threads)
+		{
+			task(omp_get_thread_num());
+		}
+#else
+		task(0);
+#endif
+	}
+};
+#else
+// Hardware counters are read only on Linux.
+class PerfCounters {
+public:
+	void open(const int) {}
+	bool is_valid() const { return false; }
+	void start(const int) {}
+	Counters stop(const int) { return Counters{false, 0, 0, 0}; }
+	void close() {}
+};
+#endif
+
+
+struct Result {
+	Case bench_case;
+	int iterations;
+	f64 mean_us;
+	f64 median_us;
+	f64 min_us;
+	Counters counters;  // Per call.
+};
+
+
+// Runs the kernel until min_time_ms has passed (a warm up call first), and times every call.
+Result run_case(const Case& bench_case, const Options& options, const std::function<void()>& kernel) {
+	auto threads = (std::max)(bench_case.threads, 1);
+#ifdef _OPENMP
+	omp_set_num_threads(threads);
+#endif
+	kernel();
+	PerfCounters perf_counters;
+	perf_counters.open(threads);
+	std::vector<f64> call_us;
+	call_us.reserve(kBenchMaxIterations);
+	auto min_ticks = static_cast<u64>(options.min_time_ms * 1000 * get_clock_source().ticks_per_usec);
+	perf_counters.start(threads);
+	auto start_ticks = get_clock_ticks();
+	auto end_ticks = start_ticks;
+	while ((static_cast<int>(call_us.size()) < kBenchMinIterations) || (((end_ticks - start_ticks) < min_ticks) && (static_cast<int>(call_us.size()) < kBenchMaxIterations))) {
+		auto call_start_ticks = get_clock_ticks();
+		kernel();
+		end_ticks = get_clock_ticks();
+		call_us.push_back(clock_ticks_to_usec(end_ticks - call_start_ticks));
+	}
+	auto counters = perf_counters.is_valid() ? perf_counters.stop(threads) : Counters{false, 0, 0, 0};
+	perf_counters.close();
+
+	Result result;
+	result.bench_case = bench_case;
+	result.iterations = static_cast<int>(call_us.size());
+	result.mean_us = std::accumulate(call_us.begin(), call_us.end(), 0.0) / result.iterations;
+	std::sort(call_us.begin(), call_us.end());
+	result.median_us = call_us[call_us.size() / 2];
+	result.min_us = call_us.front();
+	result.counters = counters;
+	result.counters.cycles /= result.iterations;
+	result.counters.instructions /= result.iterations;
+	result.counters.llc_misses /= result.iterations;
+	return result;
+}
+
+
+// Layout of the mode pixels as the application places them, centered on the GLV.
+ModePixelLayout get_layout(const int modes, const int pixel_ratio) {
+	return ModePixelLayout{(kGLVPixels - modes * pixel_ratio) >> 1, pixel_ratio};
+}
+
+
+const char* get_basis_name(const Basis::INPUT_MODE_BASIS basis) {
+	return (basis == Basis::INPUT_MODE_BASIS::HADAMARD) ? "hadamard" : "fourier";
+}
+
+
+// Dimensions which the kernel doesn't depend on (and the basis) are printed as "-" (null in the JSON).
+std::string format_dimension(const int value) {
+	return (value >= 0) ? std::to_string(value) : "-";
+}
+
+
+// Runs the task on each block of mode pixels in parallel, like the callbacks of the application.
+void for_each_mode_pixel_block(const int modes, const std::function<void(int, int, int)>& task) {
+	auto mode_pixels_per_block = (modes + kBenchModePixelBlocks - 1) / kBenchModePixelBlocks;
+	#pragma omp parallel for
+	for (auto block_index = 0; block_index < kBenchModePixelBlocks; ++block_index) {
+		auto mode_pixel_start = mode_pixels_per_block * block_index;
+		auto mode_pixels = (std::min)(mode_pixels_per_block, modes - mode_pixel_start);
+		if (mode_pixels > 0) {
+			task(block_index, mode_pixel_start, mode_pixels);
+		}
+	}
+}
+
+
+class Bench {
+public:
+	explicit Bench(const Options& options) : m_options(options), m_random(1) {
+		// A linear phase to DAC calibration.
+		m_phase_to_dac_lut.resize(kBenchPhaseToDACSize);
+		for (auto lut_index = 0; lut_index < kBenchPhaseToDACSize; ++lut_index) {
+			m_phase_to_dac_lut[lut_index] = static_cast<u16>(lut_index * (kGLVDACLevelsBench - 1) / (kBenchPhaseToDACSize - 1));
+		}
+		m_phase_to_dac = PhaseToDAC{m_phase_to_dac_lut.data(), static_cast<u16>(kBenchPhaseToDACSize), kBenchPhaseToDACSize / (2 * kPI)};
+	}
+
+	void run() {
+		run_record_kernels();
+		run_raw_buffer_kernel();
+		for (auto modes : m_options.modes) {
+			for (auto basis : m_options.bases) {
+				run_basis_kernels(modes, basis);
+			}
+			run_phase_kernels(modes);
+		}
+	}
+
+	const std::vector<Result>& get_results() const { return m_results; }
+
+private:
+	static const int kGLVDACLevelsBench = 1024;
+	const Options& m_options;
+	std::mt19937 m_random;
+	std::vector<u16> m_phase_to_dac_lut;
+	PhaseToDAC m_phase_to_dac;
+	std::vector<Result> m_results;
+
+	bool is_selected(const std::string& kernel) const {
+		return m_options.filter.empty() || (kernel.find(m_options.filter) != std::string::npos);
+	}
+
+	void add(const Case& bench_case, const std::function<void()>& kernel) {
+		if (!is_selected(bench_case.kernel)) {
+			return;
+		}
+		auto result = run_case(bench_case, m_options, kernel);
+		std::printf("%-32s %-8s modes %5s ratio %2s threads %2d: mean %10.3fus median %10.3fus min %10.3fus", bench_case.kernel.c_str(), bench_case.basis.empty() ? "-" : bench_case.basis.c_str(),
+			format_dimension(bench_case.modes).c_str(), format_dimension(bench_case.pixel_ratio).c_str(), bench_case.threads, result.mean_us, result.median_us, result.min_us);
+		if (result.counters.valid) {
+			std::printf(" IPC %.2f LLC misses %.0f", result.counters.instructions / (std::max)(result.counters.cycles, 1.0), result.counters.llc_misses);
+		}
+		std::printf("\n");
+		m_results.push_back(result);
+	}
+
+	// The kernels of a TM buffer, they don't depend on the mode count (a buffer always holds kModesPerBufferTM modes of both channels).
+	void run_record_kernels() {
+		auto records = kModesPerBufferTM * kBenchPatternsPerMode * kDAQChannelsMax;
+		std::uniform_int_distribution<int> sample_distribution{0, 65535};
+		std::vector<u16> samples(kBenchSamplesPerRecord * records);
+		for (auto& sample : samples) {
+			sample = static_cast<u16>(sample_distribution(m_random));
+		}
+		Eigen::MatrixXf record_avg_intensity{records / kDAQChannelsMax, kDAQChannelsMax};
+		add(Case{"window_averaging", "", -1, -1, 1}, [&] {
+			average_windows(samples.data(), kBenchSamplesPerRecord, records, kBenchWindowOffset, kBenchWindowLength, Eigen::Map<Eigen::RowVectorXf>(record_avg_intensity.data(), records));
+		});
+
+		Eigen::Matrix<f32, 2, Eigen::Dynamic> demodulation_matrix = Eigen::Matrix<f32, 2, Eigen::Dynamic>::Random(2, kBenchPatternsPerMode);
+		Eigen::MatrixXcf mode_alignment{kModesPerBufferTM, kDAQChannelsMax};
+		Eigen::VectorXf mode_magnitudes{kModesPerBufferTM};
+		add(Case{"response_extraction", "", -1, -1, 1}, [&] {
+			demodulate_tm_responses(demodulation_matrix, record_avg_intensity.data(), kDAQChannelsMax, mode_alignment, mode_magnitudes);
+		});
+
+		// The same kernels of the fixed point TM optimization.
+		Eigen::MatrixXi record_window_sums{records / kDAQChannelsMax, kDAQChannelsMax};
+		add(Case{"window_summing", "", -1, -1, 1}, [&] {
+			sum_windows(samples.data(), kBenchSamplesPerRecord, records, kBenchWindowOffset, kBenchWindowLength, Eigen::Map<Eigen::RowVectorXi>(record_window_sums.data(), records));
+		});
+		Eigen::Matrix<i32, 2, Eigen::Dynamic> demodulation_matrix_fixed_point = (demodulation_matrix * 4096).array().round().cast<i32>();
+		Eigen::MatrixXi mode_alignment_real{kModesPerBufferTM, kDAQChannelsMax};
+		Eigen::MatrixXi mode_alignment_imag{kModesPerBufferTM, kDAQChannelsMax};
+		add(Case{"response_extraction_fixed_point", "", -1, -1, 1}, [&] {
+			demodulate_fixed_point_tm_responses(demodulation_matrix_fixed_point, record_window_sums.data(), kDAQChannelsMax, mode_alignment_real, mode_alignment_imag, mode_magnitudes);
+		});
+	}
+
+	void run_raw_buffer_kernel() {
+		GLVColVectorXs dac_column = GLVColVectorXs::LinSpaced(kGLVPixels, 0, kGLVDACLevelsBench - 1);
+		std::vector<u16> raw_buffer(kGLVPixels);
+		add(Case{"raw_interleave", "", -1, -1, 1}, [&] {
+			convert_glv_column_to_raw_buffer(dac_column.data(), raw_buffer.data());
+		});
+	}
+
+	// Basis generation and accumulation of a TM buffer, each thread handles its own blocks of mode pixels.
+	void run_basis_kernels(const int modes, const Basis::INPUT_MODE_BASIS basis_type) {
+		if ((modes < kModesPerBufferTM) || (modes > kGLVPixels)) {
+			return;
+		}
+		Basis basis;
+		basis.configure(basis_type, modes);
+		std::vector<SplitComplexMatrix> basis_blocks(kBenchModePixelBlocks);
+		auto mode_pixels_per_block = (modes + kBenchModePixelBlocks - 1) / kBenchModePixelBlocks;
+		for (auto block_index = 0; block_index < kBenchModePixelBlocks; ++block_index) {
+			auto mode_pixels = (std::max)(0, (std::min)(mode_pixels_per_block, modes - mode_pixels_per_block * block_index));
+			basis_blocks[block_index].resize(mode_pixels, kModesPerBufferTM);
+		}
+		Eigen::MatrixXf modes_real = Eigen::MatrixXf::Random(kModesPerBufferTM, kDAQChannelsMax);
+		Eigen::MatrixXf modes_imag = Eigen::MatrixXf::Random(kModesPerBufferTM, kDAQChannelsMax);
+		auto patterns = SplitComplexMatrix{modes, kDAQChannelsMax};
+		patterns.setZero();
+		for (auto threads : m_options.threads) {
+			add(Case{"basis_generation", get_basis_name(basis_type), modes, -1, threads}, [&] {
+				for_each_mode_pixel_block(modes, [&](const int block_index, const int mode_pixel_start, const int) {
+					basis.fill_block(mode_pixel_start, 0, basis_blocks[block_index].real(), basis_blocks[block_index].imag());
+				});
+			});
+			add(Case{"accumulation", get_basis_name(basis_type), modes, -1, threads}, [&] {
+				for_each_mode_pixel_block(modes, [&](const int block_index, const int mode_pixel_start, const int mode_pixels) {
+					accumulate_basis_block(basis_blocks[block_index], basis.is_real(), modes_real, modes_imag,
+						patterns.real().block(mode_pixel_start, 0, mode_pixels, kDAQChannelsMax), patterns.imag().block(mode_pixel_start, 0, mode_pixels, kDAQChannelsMax));
+				});
+			});
+		}
+
+		// The fixed point TM optimization, Hadamard blocks (+1/-1) and Q14 coefficients.
+		if (basis_type == Basis::INPUT_MODE_BASIS::HADAMARD) {
+			std::vector<Eigen::MatrixXi> hadamard_blocks(kBenchModePixelBlocks);
+			for (auto block_index = 0; block_index < kBenchModePixelBlocks; ++block_index) {
+				hadamard_blocks[block_index].resize(basis_blocks[block_index].rows(), kModesPerBufferTM);
+			}
+			Eigen::MatrixXi modes_real_fixed_point = (modes_real * (1 << kFixedPointAlignmentBits)).cast<i32>();
+			Eigen::MatrixXi modes_imag_fixed_point = (modes_imag * (1 << kFixedPointAlignmentBits)).cast<i32>();
+			Eigen::MatrixXi patterns_real_fixed_point = Eigen::MatrixXi::Zero(modes, kDAQChannelsMax);
+			Eigen::MatrixXi patterns_imag_fixed_point = Eigen::MatrixXi::Zero(modes, kDAQChannelsMax);
+			for (auto threads : m_options.threads) {
+				add(Case{"basis_generation_fixed_point", get_basis_name(basis_type), modes, -1, threads}, [&] {
+					for_each_mode_pixel_block(modes, [&](const int block_index, const int mode_pixel_start, const int) {
+						basis.fill_hadamard_block(mode_pixel_start, 0, hadamard_blocks[block_index]);
+					});
+				});
+				add(Case{"accumulation_fixed_point", get_basis_name(basis_type), modes, -1, threads}, [&] {
+					for_each_mode_pixel_block(modes, [&](const int block_index, const int mode_pixel_start, const int mode_pixels) {
+						accumulate_hadamard_block(hadamard_blocks[block_index], modes_real_fixed_point, modes_imag_fixed_point,
+							patterns_real_fixed_point.block(mode_pixel_start, 0, mode_pixels, kDAQChannelsMax), patterns_imag_fixed_point.block(mode_pixel_start, 0, mode_pixels, kDAQChannelsMax));
+					});
+				});
+			}
+		}
+
+		// The TM preload, all the interference patterns of all the modes (single threaded, as in the application).
+		Eigen::VectorXf reference_phases{kBenchPatternsPerMode};
+		reference_phases << 0, kPI / 2, kPI;
+		std::vector<int> mode_list(modes);
+		std::iota(mode_list.begin(), mode_list.end(), 0);
+		auto columns = modes * kBenchPatternsPerMode;
+		auto cartesian_columns = SplitComplexMatrix{kGLVPixels, columns};
+		Eigen::MatrixXf phase_columns{kGLVPixels, columns};
+		for (auto pixel_ratio : m_options.ratios) {
+			if ((modes * pixel_ratio) > kGLVPixels) {
+				continue;
+			}
+			add(Case{"preload_generation", get_basis_name(basis_type), modes, pixel_ratio, 1}, [&] {
+				fill_tm_pattern_columns(basis, mode_list, reference_phases, 1.0f, get_layout(modes, pixel_ratio), cartesian_columns, phase_columns);
+			});
+		}
+	}
+
+	// The finalization of a cycle, the phase of the mode pixels (atan2) and their expansion to the GLV pixels and DAC values.
+	void run_phase_kernels(const int modes) {
+		if (modes > kGLVPixels) {
+			return;
+		}
+		auto patterns = SplitComplexMatrix{modes, kDAQChannelsMax};
+		patterns.real() = Eigen::MatrixXf::Random(modes, kDAQChannelsMax);
+		patterns.imag() = Eigen::MatrixXf::Random(modes, kDAQChannelsMax);
+		Eigen::MatrixXf phases{modes, kDAQChannelsMax};
+		Eigen::MatrixXf phase_columns = Eigen::MatrixXf::Zero(kGLVPixels, kDAQChannelsMax);
+		GLVColVectorXs dac_column = GLVColVectorXs::Zero(kGLVPixels);
+		for (auto threads : m_options.threads) {
+			add(Case{"atan2", "", modes, -1, threads}, [&] {
+				for_each_mode_pixel_block(modes, [&](const int, const int mode_pixel_start, const int mode_pixels) {
+					split_complex_angle(patterns.real().block(mode_pixel_start, 0, mode_pixels, kDAQChannelsMax), patterns.imag().block(mode_pixel_start, 0, mode_pixels, kDAQChannelsMax),
+						phases.block(mode_pixel_start, 0, mode_pixels, kDAQChannelsMax));
+				});
+			});
+			for (auto pixel_ratio : m_options.ratios) {
+				if ((modes * pixel_ratio) > kGLVPixels) {
+					continue;
+				}
+				auto layout = get_layout(modes, pixel_ratio);
+				add(Case{"phase_to_dac", "", modes, pixel_ratio, threads}, [&] {
+					for_each_mode_pixel_block(modes, [&](const int, const int mode_pixel_start, const int mode_pixels) {
+						expand_mode_pixel_phases(phases.block(mode_pixel_start, 0, mode_pixels, kDAQChannelsMax), mode_pixel_start, layout, m_phase_to_dac, phase_columns, dac_column);
+					});
+				});
+			}
+		}
+	}
+};
+
+
+std::vector<int> parse_int_list(const std::string& value) {
+	std::vector<int> values;
+	std::stringstream stream{value};
+	std::string item;
+	while (std::getline(stream, item, ',')) {
+		values.push_back(std::atoi(item.c_str()));
+	}
+	return values;
+}
+
+
+bool parse_options(const int argc, char* argv[], Options& options) {
+	for (auto arg_index = 1; arg_index < argc; ++arg_index) {
+		std::string arg{argv[arg_index]};
+		if (arg_index + 1 >= argc) {
+			return false;
+		}
+		std::string value{argv[++arg_index]};
+		if (arg == "--modes") {
+			options.modes = parse_int_list(value);
+		}
+		else if (arg == "--ratios") {
+			options.ratios = parse_int_list(value);
+		}
+		else if (arg == "--threads") {
+			options.threads = parse_int_list(value);
+		}
+		else if (arg == "--basis") {
+			options.bases.clear();
+			if (value.find("hadamard") != std::string::npos) {
+				options.bases.push_back(Basis::INPUT_MODE_BASIS::HADAMARD);
+			}
+			if (value.find("fourier") != std::string::npos) {
+				options.bases.push_back(Basis::INPUT_MODE_BASIS::FOURIER);
+			}
+		}
+		else if (arg == "--min-time-ms") {
+			options.min_time_ms = std::atof(value.c_str());
+		}
+		else if (arg == "--filter") {
+			options.filter = value;
+		}
+		else if (arg == "--out") {
+			options.out = value;
+		}
+		else {
+			return false;
+		}
+	}
+
+	// By default the threads are doubled up to the threads of the machine.
+	if (options.threads.empty()) {
+		auto max_threads = 1;
+#ifdef _OPENMP
+		max_threads = omp_get_max_threads();
+#endif
+		for (auto threads = 1; threads < max_threads; threads <<= 1) {
+			options.threads.push_back(threads);
+		}
+		options.threads.push_back(max_threads);
+	}
+	return true;
+}
+
+
+void write_json_number(std::ofstream& file, const char* const name, const f64 value, const bool valid) {
+	file << ",\"" << name << "\":";
+	if (valid && std::isfinite(value)) {
+		file << value;
+	}
+	else {
+		file << "null";
+	}
+}
+
+
+bool write_json(const std::string& file_name, const std::vector<Result>& results) {
+	std::ofstream file{file_name};
+	if (!file) {
+		return false;
+	}
+	file.precision(9);
+	auto& clock_source = get_clock_source();
+	file << "{\"clock\":{\"tsc\":" << (clock_source.tsc ? "true" : "false") << ",\"ticks_per_usec\":" << clock_source.ticks_per_usec << "},\"results\":[";
+	for (size_t result_index = 0; result_index < results.size(); ++result_index) {
+		auto& result = results[result_index];
+		auto& bench_case = result.bench_case;
+		auto& counters = result.counters;
+		file << (result_index ? "," : "") << "\n{\"kernel\":\"" << bench_case.kernel << "\",\"basis\":";
+		file << (bench_case.basis.empty() ? "null" : "\"" + bench_case.basis + "\"");
+		write_json_number(file, "modes", bench_case.modes, bench_case.modes >= 0);
+		write_json_number(file, "pixel_ratio", bench_case.pixel_ratio, bench_case.pixel_ratio >= 0);
+		write_json_number(file, "threads", bench_case.threads, true);
+		write_json_number(file, "iterations", result.iterations, true);
+		write_json_number(file, "mean_us", result.mean_us, true);
+		write_json_number(file, "median_us", result.median_us, true);
+		write_json_number(file, "min_us", result.min_us, true);
+		write_json_number(file, "cycles", counters.cycles, counters.valid);
+		write_json_number(file, "instructions", counters.instructions, counters.valid);
+		write_json_number(file, "ipc", counters.instructions / counters.cycles, counters.valid && (counters.cycles > 0));
+		write_json_number(file, "llc_misses", counters.llc_misses, counters.valid);
+		file << "}";
+	}
+	file << "\n]}\n";
+	return static_cast<bool>(file);
+}
+}
+
+
+int main(int argc, char* argv[]) {
+	Options options;
+	if (!parse_options(argc, argv, options)) {
+		std::cout << "Usage: iris_bench [--modes 64,256,1024] [--ratios 1,2,4] [--threads 1,2,4] [--basis hadamard,fourier] [--min-time-ms 200] [--filter kernel] [--out iris_bench.json]" << std::endl;
+		return 1;
+	}
+	auto& clock_source = get_clock_source();
+	std::cout << "BENCH: Clock is " << (clock_source.tsc ? "TSC" : "OS") << ", " << clock_source.ticks_per_usec << " ticks per usec" << std::endl;
+	PerfCounters perf_counters;
+	perf_counters.open(1);
+	if (!perf_counters.is_valid()) {
+		std::cout << "BENCH: Hardware counters are not available, their results are null" << std::endl;
+	}
+	perf_counters.close();
+
+	Bench bench{options};
+	bench.run();
+	if (!write_json(options.out, bench.get_results())) {
+		std::cout << "BENCH: Failed to write " << options.out << std::endl;
+		return 1;
+	}
+	std::cout << "BENCH: Results written to " << options.out << std::endl;
+	return 0;
+}
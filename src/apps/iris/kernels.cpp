@@ -0,0 +1,170 @@
+#include "kernels.h"
+
+
+void average_windows(const u16* const records_ptr, const int samples_per_record, const int records, const int window_offset, const int window_length, Eigen::Ref<Eigen::RowVectorXf> record_avg_intensity) {
+	// Each column of the record matrix corresponds to a record, the record is fitted to the analysis window.
+	auto record_matrix = Eigen::Map<const Eigen::Matrix<u16, Eigen::Dynamic, Eigen::Dynamic>>(records_ptr, samples_per_record, records);
+	record_avg_intensity = record_matrix.block(window_offset, 0, window_length, records).cast<f32>().colwise().mean();
+}
+
+
+void sum_windows(const u16* const records_ptr, const int samples_per_record, const int records, const int window_offset, const int window_length, Eigen::Ref<Eigen::RowVectorXi> record_window_sums) {
+	auto record_matrix = Eigen::Map<const Eigen::Matrix<u16, Eigen::Dynamic, Eigen::Dynamic>>(records_ptr, samples_per_record, records);
+	auto window_zero_sum = static_cast<i32>(window_length) * (static_cast<i32>(kDAQZeroCode) >> kDAQSampleShift);
+	record_window_sums = record_matrix.block(window_offset, 0, window_length, records).unaryExpr([](const u16 sample) {
+		return static_cast<i32>(sample >> kDAQSampleShift);
+	}).colwise().sum().array() - window_zero_sum;
+}
+
+
+void demodulate_tm_responses(const Eigen::Matrix<f32, 2, Eigen::Dynamic>& demodulation_matrix, const f32* const intensity_ptr, const int channels, Eigen::Ref<Eigen::MatrixXcf> mode_alignment, Eigen::Ref<Eigen::VectorXf> mode_magnitudes) {
+	// Demodulate all the modes of all the channels in the buffer at once, each column holds the interference patterns of one mode.
+	// The result holds the conjugate response of each mode as a (real, imaginary) column, the channels follow one another.
+	auto mode_avg_intensity_per_interference = Eigen::Map<const Eigen::MatrixXf>(intensity_ptr, demodulation_matrix.cols(), kModesPerBufferTM * channels);
+	Eigen::Matrix<f32, 2, Eigen::Dynamic, 0, 2, kModesPerBufferTM * kDAQChannelsMax> mode_response_conj_per_mode = demodulation_matrix * mode_avg_intensity_per_interference;
+
+	// The phase of each mode is aligned by its normalized conjugate response, the magnitude of channel A is kept for the scheduling.
+	// A mode without a response has no phase, it is left out of the solution (as in the fixed point TM optimization).
+	for (auto channel_index = 0; channel_index < channels; ++channel_index) {
+		for (auto mode_index = 0; mode_index < kModesPerBufferTM; ++mode_index) {
+			auto response_index = kModesPerBufferTM * channel_index + mode_index;
+			std::complex<f32> mode_response_conj{mode_response_conj_per_mode(0, response_index), mode_response_conj_per_mode(1, response_index)};
+			auto mode_magnitude = std::abs(mode_response_conj);
+			mode_alignment(mode_index, channel_index) = (mode_magnitude > 0) ? (mode_response_conj / mode_magnitude) : std::complex<f32>{0, 0};
+			if (channel_index == 0) {
+				mode_magnitudes(mode_index) = mode_magnitude;
+			}
+		}
+	}
+}
+
+
+void demodulate_fixed_point_tm_responses(const Eigen::Matrix<i32, 2, Eigen::Dynamic>& demodulation_matrix, const i32* const window_sums_ptr, const int channels,
+	Eigen::Ref<Eigen::MatrixXi> mode_alignment_real, Eigen::Ref<Eigen::MatrixXi> mode_alignment_imag, Eigen::Ref<Eigen::VectorXf> mode_magnitudes) {
+	// Demodulate all the modes of all the channels in the buffer at once (see demodulate_tm_responses()).
+	auto mode_window_sum_per_interference = Eigen::Map<const Eigen::MatrixXi>(window_sums_ptr, demodulation_matrix.cols(), kModesPerBufferTM * channels);
+	Eigen::Matrix<i32, 2, Eigen::Dynamic, 0, 2, kModesPerBufferTM * kDAQChannelsMax> mode_response_conj_per_mode = demodulation_matrix * mode_window_sum_per_interference;
+
+	// The phase of each mode is aligned by its normalized conjugate response, quantized to Q14.
+	// A mode without a response doesn't add to the solution.
+	const auto alignment_scale = static_cast<f32>(1 << kFixedPointAlignmentBits);
+	for (auto channel_index = 0; channel_index < channels; ++channel_index) {
+		for (auto mode_index = 0; mode_index < kModesPerBufferTM; ++mode_index) {
+			auto response_index = kModesPerBufferTM * channel_index + mode_index;
+			auto response_real = static_cast<f32>(mode_response_conj_per_mode(0, response_index));
+			auto response_imag = static_cast<f32>(mode_response_conj_per_mode(1, response_index));
+			auto mode_magnitude = std::hypot(response_real, response_imag);
+			auto scale = (mode_magnitude > 0) ? (alignment_scale / mode_magnitude) : 0.0f;
+			mode_alignment_real(mode_index, channel_index) = static_cast<i32>(std::lround(response_real * scale));
+			mode_alignment_imag(mode_index, channel_index) = static_cast<i32>(std::lround(response_imag * scale));
+			if (channel_index == 0) {
+				mode_magnitudes(mode_index) = mode_magnitude;
+			}
+		}
+	}
+}
+
+
+void accumulate_basis_block(const SplitComplexMatrix& basis_block, const bool real_basis, const Eigen::Ref<const Eigen::MatrixXf>& modes_real, const Eigen::Ref<const Eigen::MatrixXf>& modes_imag,
+	Eigen::Ref<Eigen::MatrixXf> pattern_real, Eigen::Ref<Eigen::MatrixXf> pattern_imag) {
+	// (Br + jBi) * (Ar + jAi) = (Br*Ar - Bi*Ai) + j(Br*Ai + Bi*Ar), each term is a real product on the split planes.
+	// The imaginary plane of a real basis (Hadamard) is zero, so its terms are skipped.
+	pattern_real.noalias() += basis_block.real() * modes_real;
+	pattern_imag.noalias() += basis_block.real() * modes_imag;
+	if (!real_basis) {
+		pattern_real.noalias() -= basis_block.imag() * modes_imag;
+		pattern_imag.noalias() += basis_block.imag() * modes_real;
+	}
+}
+
+
+void accumulate_hadamard_block(const Eigen::Ref<const Eigen::MatrixXi>& hadamard_block, const Eigen::Ref<const Eigen::MatrixXi>& modes_real, const Eigen::Ref<const Eigen::MatrixXi>& modes_imag,
+	Eigen::Ref<Eigen::MatrixXi> pattern_real, Eigen::Ref<Eigen::MatrixXi> pattern_imag) {
+	pattern_real.noalias() += hadamard_block * modes_real;
+	pattern_imag.noalias() += hadamard_block * modes_imag;
+}
+
+
+u16 convert_phase_to_dac_value(const PhaseToDAC& phase_to_dac, const f32 phase) {
+	// Atan2 phase is in the range [-PI, PI]. It has two discontinuities which we need to resolve to get an integer index.
+	// This is a description of how it is done:
+	// We multiply by the index_coeff to get a number in the range [-size/2 : size/2]
+	// and add size if the number is negative.
+	// For example:
+	// size = 100  -> index_coeff = 100/2PI
+	// If we have a pixel with phase 3PI/4, the resulting index will be (u16)(3PI/4 * 100/2PI) = 37
+	// If we have a pixel with phase PI, the resulting index will be (u16)(PI * 100/2PI) = 50
+	// If we have a pixel with phase -PI (discontinuity), the resulting index will be (u16)(-PI * 100/2PI + 100) = 50
+	// If we have a pixel with phase -PI/100, the resulting index will be (u16)(-PI/100 * 100/2PI + 100) = 99
+	auto phase_to_dac_transformed = phase * phase_to_dac.index_coeff;
+	u16 dac_value_index;
+	if (phase_to_dac_transformed < 0) {
+		dac_value_index = static_cast<u16>(phase_to_dac_transformed + phase_to_dac.size);
+	}
+	else {
+		dac_value_index = static_cast<u16>(phase_to_dac_transformed);
+	}
+	return phase_to_dac.lut[dac_value_index];
+}
+
+
+void expand_mode_pixel_phases(const Eigen::Ref<const Eigen::MatrixXf>& phases, const int mode_pixel_start, const ModePixelLayout& layout, const PhaseToDAC& phase_to_dac,
+	Eigen::Ref<Eigen::MatrixXf> phase_columns, Eigen::Ref<GLVColVectorXs> dac_column) {
+	// The phase and the DAC value are computed once per mode pixel, and expanded to the GLV pixels of the mode pixel.
+	for (auto channel_index = 0; channel_index < phases.cols(); ++channel_index) {
+		for (auto mode_pixel_index = mode_pixel_start; mode_pixel_index < (mode_pixel_start + phases.rows()); ++mode_pixel_index) {
+			auto phase = phases(mode_pixel_index - mode_pixel_start, channel_index);
+			auto pixel_index = layout.start_pixel + layout.pixel_ratio * mode_pixel_index;
+			phase_columns.block(pixel_index, channel_index, layout.pixel_ratio, 1).fill(phase);
+			if (channel_index == 0) {
+				dac_column.segment(pixel_index, layout.pixel_ratio).fill(convert_phase_to_dac_value(phase_to_dac, phase));
+			}
+		}
+	}
+}
+
+
+void fill_tm_pattern_columns(const Basis& basis, const std::vector<int>& modes, const Eigen::VectorXf& reference_phases, const f32 fixed_reference, const ModePixelLayout& layout,
+	SplitComplexMatrix& cartesian_columns, Eigen::Ref<Eigen::MatrixXf> phase_columns) {
+	// The nomenclature scheme for adding the reference is:
+	// reference "top"
+	// mode
+	// reference "bottom"
+
+	// Iterate and create the reference + modes matrix, the interference patterns of each mode in the list follow one another.
+	// The columns of the mode are generated in place, so no temporary is allocated.
+	auto mode_pixels = basis.modes();
+	auto patterns_per_mode = static_cast<int>(reference_phases.size());
+	Eigen::Matrix<f32, Eigen::Dynamic, 1, 0, kGLVPixels, 1> mode_real{mode_pixels};
+	Eigen::Matrix<f32, Eigen::Dynamic, 1, 0, kGLVPixels, 1> mode_imag{mode_pixels};
+	for (auto mode_list_index = 0; mode_list_index < static_cast<int>(modes.size()); ++mode_list_index) {
+		basis.fill_block(0, modes[mode_list_index], mode_real, mode_imag);
+		for (auto add_phase_index = 0; add_phase_index < patterns_per_mode; ++add_phase_index) {
+			auto ref_modes_col_index = patterns_per_mode * mode_list_index + add_phase_index;
+			auto added_phase = std::polar(1.0f, reference_phases(add_phase_index));
+
+			// For the case of fixed reference, fill the entire column (top reference + mode + bottom reference) according to the
+			// phase of the reference and overwrite with the input mode in the middle, shifted by the added phase.
+			// For the case of fixed mode, fill the entire column (top reference + mode + bottom reference) with the
+			// added phase of the reference and overwrite with the input mode in the middle.
+			auto reference = added_phase;
+			auto mode_phase = std::complex<f32>{1, 0};
+			if (fixed_reference != 0) {
+				reference = {fixed_reference, 0};
+				mode_phase = added_phase;
+			}
+			cartesian_columns.real().col(ref_modes_col_index).fill(reference.real());
+			cartesian_columns.imag().col(ref_modes_col_index).fill(reference.imag());
+			for (auto mode_pixel_index = 0; mode_pixel_index < mode_pixels; ++mode_pixel_index) {
+				auto value = std::complex<f32>{mode_real(mode_pixel_index), mode_imag(mode_pixel_index)} * mode_phase;
+				auto pixel_index = layout.start_pixel + layout.pixel_ratio * mode_pixel_index;
+				cartesian_columns.real().col(ref_modes_col_index).segment(pixel_index, layout.pixel_ratio).fill(value.real());
+				cartesian_columns.imag().col(ref_modes_col_index).segment(pixel_index, layout.pixel_ratio).fill(value.imag());
+			}
+		}
+	}
+
+	// Get the phase of the matrix in the range [-PI, PI].
+	auto columns = static_cast<Eigen::Index>(modes.size()) * patterns_per_mode;
+	split_complex_angle(cartesian_columns.real().leftCols(columns), cartesian_columns.imag().leftCols(columns), phase_columns.leftCols(columns));
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <complex>
+#include "eigen/Eigen/Dense"
+#include "core0/types.h"
+#include "glv/glv_column.h"
+#include "basis.h"
+#include "split_complex.h"
+
+const int kModesPerBufferTM = 64;  // Each buffer in the TM optimization will contain data for X records, where X = kModesPerBufferTM * #interference patterns per mode
+                                   // The following must be an integer: kInputModes / kModesPerBufferTM
+const int kDAQChannelsMax = 2;  // Channel A and channel B.
+const f32 kDAQZeroCode = 32768.0f;  // Sample code of a ~0V input signal.
+const int kDAQSampleShift = 4;  // The 12 bit samples are left aligned in the 16 bit sample codes.
+const int kFixedPointAlignmentBits = 14;  // The aligned modes are quantized to Q14, so the Hadamard sums of up to 2^16 modes fit in i32.
+
+
+// The processing kernels of the optimizations. They are free of the DAQ and the GLV, so the application and iris_bench run the same code.
+// None of them allocates, the outputs are sized by the caller.
+
+// Placement of the mode pixels on the GLV, mode pixel i covers the GLV pixels [start_pixel + pixel_ratio * i, start_pixel + pixel_ratio * (i + 1)).
+struct ModePixelLayout {
+	int start_pixel;
+	int pixel_ratio;
+};
+
+
+// Calibration of the GLV DAC values over the phases [0, 2PI), index_coeff is size / 2PI.
+struct PhaseToDAC {
+	const u16* lut;
+	u16 size;
+	f32 index_coeff;
+};
+
+
+// Mean of the analysis window [window_offset, window_offset + window_length) of each record, the records follow one another.
+void average_windows(const u16* const records_ptr, const int samples_per_record, const int records, const int window_offset, const int window_length, Eigen::Ref<Eigen::RowVectorXf> record_avg_intensity);
+
+// Same as above, in integers. The 12 bit samples of the window are summed and the offset of the window is removed,
+// so a ~0V signal sums to 0 (the sums are bounded by window length * 2^11).
+void sum_windows(const u16* const records_ptr, const int samples_per_record, const int records, const int window_offset, const int window_length, Eigen::Ref<Eigen::RowVectorXi> record_window_sums);
+
+// Demodulates the interference patterns of kModesPerBufferTM modes per channel (one column of patterns per mode, the channels follow one another),
+// and aligns each mode by its normalized conjugate response (one column per channel). The magnitudes are of channel A.
+void demodulate_tm_responses(const Eigen::Matrix<f32, 2, Eigen::Dynamic>& demodulation_matrix, const f32* const intensity_ptr, const int channels, Eigen::Ref<Eigen::MatrixXcf> mode_alignment, Eigen::Ref<Eigen::VectorXf> mode_magnitudes);
+
+// Same as above, in integers (the demodulation matrix is scaled to integers), the alignment of each mode is quantized to Q14.
+void demodulate_fixed_point_tm_responses(const Eigen::Matrix<i32, 2, Eigen::Dynamic>& demodulation_matrix, const i32* const window_sums_ptr, const int channels,
+	Eigen::Ref<Eigen::MatrixXi> mode_alignment_real, Eigen::Ref<Eigen::MatrixXi> mode_alignment_imag, Eigen::Ref<Eigen::VectorXf> mode_magnitudes);
+
+// Adds the modes of the basis block weighted by their (complex) coefficients to the patterns, one column per channel.
+void accumulate_basis_block(const SplitComplexMatrix& basis_block, const bool real_basis, const Eigen::Ref<const Eigen::MatrixXf>& modes_real, const Eigen::Ref<const Eigen::MatrixXf>& modes_imag,
+	Eigen::Ref<Eigen::MatrixXf> pattern_real, Eigen::Ref<Eigen::MatrixXf> pattern_imag);
+
+// Same as above for a Hadamard block (+1/-1) and fixed point coefficients, integer sums don't depend on the order.
+void accumulate_hadamard_block(const Eigen::Ref<const Eigen::MatrixXi>& hadamard_block, const Eigen::Ref<const Eigen::MatrixXi>& modes_real, const Eigen::Ref<const Eigen::MatrixXi>& modes_imag,
+	Eigen::Ref<Eigen::MatrixXi> pattern_real, Eigen::Ref<Eigen::MatrixXi> pattern_imag);
+
+// GLV DAC value of a phase in the range [-PI, PI].
+u16 convert_phase_to_dac_value(const PhaseToDAC& phase_to_dac, const f32 phase);
+
+// Expands the phases of the mode pixels [mode_pixel_start, mode_pixel_start + phases.rows()) to their GLV pixels, one column per channel,
+// and the DAC values of channel A to the DAC column.
+void expand_mode_pixel_phases(const Eigen::Ref<const Eigen::MatrixXf>& phases, const int mode_pixel_start, const ModePixelLayout& layout, const PhaseToDAC& phase_to_dac,
+	Eigen::Ref<Eigen::MatrixXf> phase_columns, Eigen::Ref<GLVColVectorXs> dac_column);
+
+// Fills the TM interference pattern columns of the modes (reference + mode), the patterns of each mode follow one another.
+// With a fixed reference (fixed_reference of +1 or -1) the phases are added to the mode, otherwise (0) to the reference.
+void fill_tm_pattern_columns(const Basis& basis, const std::vector<int>& modes, const Eigen::VectorXf& reference_phases, const f32 fixed_reference, const ModePixelLayout& layout,
+	SplitComplexMatrix& cartesian_columns, Eigen::Ref<Eigen::MatrixXf> phase_columns);
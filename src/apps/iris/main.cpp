@@ -9,10 +9,13 @@ void help() {
 			spdlog::info("General:");
 			spdlog::info("  's' - Stops the app");
 			spdlog::info("  'h' - Prints this help menu");
+			spdlog::info("  'T' - Starts tracing, or stops and writes the trace to %s", kTraceFile);
+			spdlog::info("  'D' - Dumps the flight recorder (latest DAQ buffers, responses and focusing columns) to a file");
 			spdlog::info("  'q' - Exits the application\n");
 			spdlog::info("Calibration:");
 			spdlog::info("  'c' - Extracts a voltage curve for a set of grating columns");
 			spdlog::info("  'e' - Extracts a voltage curve for a set of constant columns");
+			spdlog::info("  'W' - Detects the analysis window (settle time) for the current GLV column time");
 			spdlog::info("  '+' - Ramps calibrated phase grating on the GLV");
 			spdlog::info("  'g' - Configures the GLV to constantly cycle through all DAC amplitudes (GLV is flat)");
 			spdlog::info("  'a' - Configures the GLV to constantly cycle through all voltage gratings in a continuous mode");
@@ -20,7 +23,9 @@ void help() {
 			spdlog::info("  'n' - Configures the GLV to constantly cycle through all voltage gratings one by one\n");
 			spdlog::info("TM optimization:");
 			spdlog::info("  'r' - Runs the optimization using the TM algorithm");
-			spdlog::info("  'w' - Toggle between phase steps of PI/2 to PI/4");
+			spdlog::info("  'w' - Toggle between phase steps of PI/2 to PI/4 (3 interference patterns per mode)");
+			spdlog::info("  '.' - Toggle between 3, 4, 5 and 8 interference patterns per mode");
+			spdlog::info("  ''' - Toggle between acquiring channel A and channels A+B (a solution per channel)");
 			spdlog::info("  '0' - Fixes the reference for the preloaded columns to phase 0 (mode changes)");
 			spdlog::info("  'p' - Fixes the reference for the preloaded columns to phase PI (mode changes)");
 			spdlog::info("  'z' - Fixes the mode for the preloaded columns (reference changes), final reference phase is constant");
@@ -32,9 +37,11 @@ void help() {
 			spdlog::info("  'f' - Configures the GLV to constantly cycle through the TM optimization preloaded columns one by one\n");
 			spdlog::info("Iterative optimization:");
 			spdlog::info("  'm' - Runs the optimization using the iterative algorithm starting from a null solution");
-			spdlog::info("  ',' - Runs the optimization using the iterative algorithm starting from the previous solution\n");
+			spdlog::info("  ',' - Runs the optimization using the iterative algorithm starting from the previous solution");
+			spdlog::info("  '/' - Toggle between 4, 8 and 16 phase steps per mode\n");
 			spdlog::info("Shared optimization options:");
 			spdlog::info("  'u' - Displays the solution, which was measured during the optimization, on the GLV");
+			spdlog::info("  'U' - Displays the solution of channel B, which was measured during the TM optimization, on the GLV");
 			spdlog::info("  ';' - Displays and ramps the solution, which was measured during the optimization, on the GLV");
 			spdlog::info("  '-' - Set the number of input modes to 64");
 			spdlog::info("  '*' - Set the number of input modes to 128");
@@ -45,6 +52,7 @@ void help() {
 			spdlog::info("  'x' - Set the \"GLV pixel to mode pixel\" ratio to 2:1");
 			spdlog::info("  '=' - Set the \"GLV pixel to mode pixel\" ratio to 3:1");
 			spdlog::info("  'y' - Set the \"GLV pixel to mode pixel\" ratio to 4:1");
+			spdlog::info("  '\\' - Toggle the power normalization by the reference on channel B (none, divide, regress)");
 			spdlog::info("  '[' - Sets the input mode basis to Hadamard");
 			spdlog::info("  ']' - Sets the input mode basis to Fourier\n");
 			spdlog::info("GLV options:");
@@ -54,7 +62,12 @@ void help() {
 			spdlog::info("  '6' - Sets GLV column time to 10us");
 			spdlog::info("  '7' - Sets GLV column time to 15us");
 			spdlog::info("  '8' - Sets GLV column time to 20us");
-			spdlog::info("  '9' - Sets GLV column time to 25us\n");
+			spdlog::info("  '9' - Sets GLV column time to 25us");
+			spdlog::info("  '`' - Toggle the adaptive loop cycle pacing");
+			spdlog::info("  'O' - Toggle the online iterative optimization");
+			spdlog::info("  'R' - Toggle the rolling TM optimization");
+			spdlog::info("  'A' - Toggle the adaptive TM optimization");
+			spdlog::info("  'F' - Toggle the fixed point TM optimization\n");
 }
 
 
@@ -63,6 +76,20 @@ int main(int argc, char *argv[]) {
 	// Custom pattern.
 	spdlog::set_pattern("%v");
 
+	// Select the DAQ and the GLV backends.
+	BackendOptions backend_options;
+	if (!parse_backend_options(argc, argv, backend_options)) {
+		print_backend_usage();
+		return 1;
+	}
+	auto daq = create_daq_backend(backend_options);
+	auto glv = create_glv_backend(backend_options);
+	if (!daq || !glv) {
+		print_backend_usage();
+		return 1;
+	}
+	spdlog::info("APP: DAQ backend %s, GLV backend %s", backend_options.daq, backend_options.glv);
+
 	// disable QuickEdit mode in output console.
 	HANDLE hInput = GetStdHandle(STD_INPUT_HANDLE);
 	DWORD prev_mode;
@@ -70,7 +97,7 @@ int main(int argc, char *argv[]) {
 	SetConsoleMode(hInput, prev_mode & ~ENABLE_QUICK_EDIT_MODE);
 	
 	// Resources.
-	App app;
+	App app{std::move(daq), std::move(glv)};
 	std::thread work_thread;
 	u16 col_exp_index_start = 0;
 	u16 col_exp_index_end = 2;
@@ -78,12 +105,24 @@ int main(int argc, char *argv[]) {
 	u16 col_exp_index_grating2 = 0;
 	bool toggle_1 = false;
 	bool toggle_2 = false;
-#ifdef GLV_PROCESSING_EMULATION
-	// If the macro GLV_PROCESSING_EMULATION is defined in glv.h then we can benchmark the complete processing data path.
-	work_thread = std::thread{[&] {app.test_tm_optimization_compute_performance(); }};
-	//work_thread = std::thread{ [&] {app.test_iterative_optimization_compute_performance(); } };
-#else
-	
+	auto daq_channels = App::DAQ_CHANNELS::SINGLE_CHANNEL;
+	auto power_normalization = App::POWER_NORMALIZATION::NO_NORMALIZATION;
+	bool adaptive_pacing = true;
+	bool online_iterative = false;
+	bool rolling_tm = false;
+	bool adaptive_tm = false;
+	bool fixed_point_tm = false;
+	auto iterative_phase_steps = static_cast<App::ITERATIVE_PHASE_STEPS>(kIterativePhaseStepsPerMode_initial);
+	auto tm_interference_patterns = static_cast<App::TM_INTERFERENCE_PATTERNS>(kTMInterferencePatternsPerMode_initial);
+
+	// The benchmark runs with the null GLV backend (--glv null, see parse_backend_options), so it covers the complete processing data path.
+	if (backend_options.benchmark == "tm") {
+		work_thread = std::thread{[&] {app.test_tm_optimization_compute_performance(); }};
+	}
+	else if (backend_options.benchmark == "iterative") {
+		work_thread = std::thread{[&] {app.test_iterative_optimization_compute_performance(); }};
+	}
+
 	// Program loop.
 	help();
 	bool quit = false;
@@ -110,6 +149,16 @@ int main(int argc, char *argv[]) {
 				}
 				work_thread = std::thread{ [&] {app.extract_calibration_curve(App::CALIBRATION_TYPE::VOLTAGE_GRATING); } };
 				break;
+			case 'W':
+				if (app.is_running()) {
+					spdlog::error("APP: Already running...");
+					break;
+				}
+				if (work_thread.joinable()) {
+					work_thread.join();
+				}
+				work_thread = std::thread{ [&] {app.detect_analysis_window(); } };
+				break;
 			case 'r':
 				if (app.is_running()) {
 					spdlog::error("APP: Already running...");
@@ -146,6 +195,9 @@ int main(int argc, char *argv[]) {
 			case 'u':
 				app.display_solution();
 				break;
+			case 'U':
+				app.display_solution(false, 1);
+				break;
 			case ';':
 				app.display_solution(true);
 				break;
@@ -254,6 +306,57 @@ int main(int argc, char *argv[]) {
 				app.set_tm_optimization_phase_steps(phase_step);
 				toggle_2 = !toggle_2;
 				break;
+			case '.': {
+				auto next_tm_interference_patterns = App::TM_INTERFERENCE_PATTERNS::THREE_PATTERNS;
+				if (tm_interference_patterns == App::TM_INTERFERENCE_PATTERNS::THREE_PATTERNS) {
+					next_tm_interference_patterns = App::TM_INTERFERENCE_PATTERNS::FOUR_PATTERNS;
+				}
+				else if (tm_interference_patterns == App::TM_INTERFERENCE_PATTERNS::FOUR_PATTERNS) {
+					next_tm_interference_patterns = App::TM_INTERFERENCE_PATTERNS::FIVE_PATTERNS;
+				}
+				else if (tm_interference_patterns == App::TM_INTERFERENCE_PATTERNS::FIVE_PATTERNS) {
+					next_tm_interference_patterns = App::TM_INTERFERENCE_PATTERNS::EIGHT_PATTERNS;
+				}
+				if (app.set_tm_interference_patterns_per_mode(next_tm_interference_patterns)) {
+					tm_interference_patterns = next_tm_interference_patterns;
+				}
+				break;
+			}
+			case '\'': {
+				// Channel B can't be a signal channel while it's the power reference, so the channels may be rejected.
+				auto next_daq_channels = (daq_channels == App::DAQ_CHANNELS::SINGLE_CHANNEL) ? App::DAQ_CHANNELS::DUAL_CHANNEL : App::DAQ_CHANNELS::SINGLE_CHANNEL;
+				if (app.set_daq_channels(next_daq_channels)) {
+					daq_channels = next_daq_channels;
+				}
+				break;
+			}
+			case '\\': {
+				auto next_power_normalization = App::POWER_NORMALIZATION::NO_NORMALIZATION;
+				if (power_normalization == App::POWER_NORMALIZATION::NO_NORMALIZATION) {
+					next_power_normalization = App::POWER_NORMALIZATION::DIVIDE;
+				}
+				else if (power_normalization == App::POWER_NORMALIZATION::DIVIDE) {
+					next_power_normalization = App::POWER_NORMALIZATION::REGRESS;
+				}
+				if (app.set_power_normalization(next_power_normalization)) {
+					power_normalization = next_power_normalization;
+				}
+				break;
+			}
+			case '/': {
+				// Only toggled if the app accepts the phase steps, so the toggle stays in sync with it.
+				auto next_phase_steps = App::ITERATIVE_PHASE_STEPS::FOUR;
+				if (iterative_phase_steps == App::ITERATIVE_PHASE_STEPS::FOUR) {
+					next_phase_steps = App::ITERATIVE_PHASE_STEPS::EIGHT;
+				}
+				else if (iterative_phase_steps == App::ITERATIVE_PHASE_STEPS::EIGHT) {
+					next_phase_steps = App::ITERATIVE_PHASE_STEPS::SIXTEEN;
+				}
+				if (app.set_iterative_optimization_phase_steps(next_phase_steps)) {
+					iterative_phase_steps = next_phase_steps;
+				}
+				break;
+			}
 			case '1':
 				if (app.is_running()) {
 					app.stop(true);
@@ -323,6 +426,36 @@ int main(int argc, char *argv[]) {
 			case '9':
 				app.set_glv_column_period(25000);
 				break;
+			case '`':
+				adaptive_pacing = !adaptive_pacing;
+				app.set_adaptive_pacing(adaptive_pacing);
+				break;
+			case 'O':
+				if (app.set_online_iterative(!online_iterative)) {
+					online_iterative = !online_iterative;
+				}
+				break;
+			case 'R':
+				if (app.set_rolling_tm(!rolling_tm ? kRollingTMBuffers : 0, kRollingTMForgetting)) {
+					rolling_tm = !rolling_tm;
+				}
+				break;
+			case 'A':
+				if (app.set_adaptive_tm(!adaptive_tm)) {
+					adaptive_tm = !adaptive_tm;
+				}
+				break;
+			case 'F':
+				if (app.set_fixed_point_tm(!fixed_point_tm)) {
+					fixed_point_tm = !fixed_point_tm;
+				}
+				break;
+			case 'T':
+				app.toggle_trace();
+				break;
+			case 'D':
+				app.dump_flight_recorder();
+				break;
 			case '[':
 				app.set_basis_type(App::INPUT_MODE_BASIS::HADAMARD);
 				break;
@@ -341,7 +474,6 @@ int main(int argc, char *argv[]) {
 				break;
 		}
 	}
-#endif
 	if (work_thread.joinable()) {
 		work_thread.join();
 	}
@@ -0,0 +1,49 @@
+% Reads a flight recorder dump of iris (flight_recorder_*.bin), see flight_recorder.h.
+% All the fields are little endian, the records are oldest first.
+function dump = read_flight_recorder(file_name)
+fid = fopen(file_name, 'r', 'l');
+if (fid < 0)
+    error('Failed to open %s', file_name);
+end
+cleanup = onCleanup(@() fclose(fid));
+
+% Header.
+magic = fread(fid, [1 8], '*char');
+if (~strcmp(magic, 'IRISFR01'))
+    error('Not a flight recorder dump');
+end
+dump.reason = deblank(fread(fid, [1 32], '*char'));
+ticks_per_usec = fread(fid, 1, 'double');
+dump_ticks = fread(fid, 1, 'uint64');
+buffer_records = fread(fid, 1, 'uint32');
+cycle_records = fread(fid, 1, 'uint32');
+modes = fread(fid, 1, 'uint32');
+glv_pixels = fread(fid, 1, 'uint32');
+to_usec = @(ticks) (double(ticks) - double(dump_ticks)) / ticks_per_usec;  % Times are in us relative to the dump.
+
+% Raw DAQ buffers, the samples are as the DAQ returned them (interleaved with two channels).
+dump.buffers = struct('data_index', {}, 'receive_us', {}, 'done_us', {}, 'samples', {});
+for record_index = 1:buffer_records
+    data_index = fread(fid, 1, 'uint64');
+    receive_ticks = fread(fid, 1, 'uint64');
+    done_ticks = fread(fid, 1, 'uint64');
+    bytes = fread(fid, 1, 'uint64');
+    dump.buffers(record_index).data_index = data_index;
+    dump.buffers(record_index).receive_us = to_usec(receive_ticks);
+    dump.buffers(record_index).done_us = to_usec(done_ticks);
+    dump.buffers(record_index).samples = fread(fid, bytes / 2, '*uint16');
+end
+
+% Cycles, the responses are of channel A.
+dump.cycles = struct('cycle_index', {}, 'end_us', {}, 'latency_us', {}, 'focus_signal', {}, 'loopcycle_wait_us', {}, 'responses', {}, 'dac_column', {});
+for record_index = 1:cycle_records
+    dump.cycles(record_index).cycle_index = fread(fid, 1, 'uint64');
+    dump.cycles(record_index).end_us = to_usec(fread(fid, 1, 'uint64'));
+    dump.cycles(record_index).latency_us = fread(fid, 1, 'double');
+    dump.cycles(record_index).focus_signal = fread(fid, 1, 'single');
+    dump.cycles(record_index).loopcycle_wait_us = fread(fid, 1, 'uint32');
+    responses = fread(fid, [2 modes], 'single');
+    dump.cycles(record_index).responses = complex(responses(1, :), responses(2, :)).';
+    dump.cycles(record_index).dac_column = fread(fid, glv_pixels, '*uint16');
+end
+end
@@ -0,0 +1,29 @@
+#include <limits>
+#include "split_complex.h"
+const f32 PI_F32 = 3.1415927f;
+const f32 HALFPI_F32 = PI_F32 / 2;
+const int kAngleChunk = 256;  // Elements per chunk of the angle, the intermediate arrays of a chunk are on the stack.
+
+
+void split_complex_angle(const Eigen::Ref<const Eigen::MatrixXf>& real, const Eigen::Ref<const Eigen::MatrixXf>& imag, Eigen::Ref<Eigen::MatrixXf> phase) {
+	using ChunkArray = Eigen::Array<f32, Eigen::Dynamic, 1, 0, kAngleChunk, 1>;
+	for (auto col_index = 0; col_index < phase.cols(); ++col_index) {
+		for (auto row_start = 0; row_start < phase.rows(); row_start += kAngleChunk) {
+			auto rows = (std::min)(static_cast<Eigen::Index>(kAngleChunk), phase.rows() - row_start);
+			auto x = real.col(col_index).segment(row_start, rows).array();
+			auto y = imag.col(col_index).segment(row_start, rows).array();
+
+			// atan(a) of the ratio a = min(|x|, |y|) / max(|x|, |y|) in [0, 1], by a minimax polynomial in a^2.
+			ChunkArray abs_x = x.abs();
+			ChunkArray abs_y = y.abs();
+			ChunkArray ratio = abs_x.min(abs_y) / abs_x.max(abs_y).max((std::numeric_limits<f32>::min)());
+			ChunkArray ratio2 = ratio.square();
+			ChunkArray angle = ratio * (0.99997726f + ratio2 * (-0.33262347f + ratio2 * (0.19354346f + ratio2 * (-0.11643287f + ratio2 * (0.05265332f + ratio2 * -0.01172120f)))));
+
+			// Unfold to the octant and the quadrant of (x, y).
+			angle = (abs_y > abs_x).select(HALFPI_F32 - angle, angle);
+			angle = (x < 0).select(PI_F32 - angle, angle);
+			phase.col(col_index).segment(row_start, rows) = (y < 0).select(-angle, angle).matrix();
+		}
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <complex>
+#include "eigen/Eigen/Dense"
+#include "core0/types.h"
+const int kSplitComplexPadding = 8;  // The columns are padded to a multiple of 8 floats (a 256 bit vector).
+
+
+// Complex matrix which keeps the real and the imaginary parts in separate planes (structure of arrays), so the complex
+// multiply-accumulate and the angle run on full vectors of floats, without shuffling interleaved std::complex<f32> elements.
+// Each plane is column major, with its columns padded so each column starts on a vector boundary.
+class SplitComplexMatrix {
+public:
+	using Plane = Eigen::MatrixXf;
+	using PlaneBlock = Eigen::Block<Plane>;
+	using ConstPlaneBlock = Eigen::Block<const Plane>;
+
+	SplitComplexMatrix() : m_rows(0) {}
+	SplitComplexMatrix(const Eigen::Index rows, const Eigen::Index cols) { resize(rows, cols); }
+
+	// Resizes the matrix, all the elements are zero.
+	void resize(const Eigen::Index rows, const Eigen::Index cols) {
+		m_rows = rows;
+		auto padded_rows = ((rows + kSplitComplexPadding - 1) / kSplitComplexPadding) * kSplitComplexPadding;
+		m_real = Plane::Zero(padded_rows, cols);
+		m_imag = Plane::Zero(padded_rows, cols);
+	}
+
+	void setZero() {
+		m_real.setZero();
+		m_imag.setZero();
+	}
+
+	Eigen::Index rows() const { return m_rows; }
+	Eigen::Index cols() const { return m_real.cols(); }
+
+	// The planes without the padding.
+	PlaneBlock real() { return m_real.topRows(m_rows); }
+	PlaneBlock imag() { return m_imag.topRows(m_rows); }
+	ConstPlaneBlock real() const { return m_real.topRows(m_rows); }
+	ConstPlaneBlock imag() const { return m_imag.topRows(m_rows); }
+
+	std::complex<f32> operator()(const Eigen::Index row, const Eigen::Index col) const { return {m_real(row, col), m_imag(row, col)}; }
+
+	// Sets a block of the matrix from interleaved complex elements.
+	void set_block(const Eigen::Index row, const Eigen::Index col, const Eigen::Ref<const Eigen::MatrixXcf>& block) {
+		m_real.block(row, col, block.rows(), block.cols()) = block.real();
+		m_imag.block(row, col, block.rows(), block.cols()) = block.imag();
+	}
+
+private:
+	Eigen::Index m_rows;
+	Plane m_real;
+	Plane m_imag;
+};
+
+
+// Angle of each element (imag, real) in the range [-PI, PI].
+// A polynomial approximation of atan2 (maximal error of ~2e-6 rad, far below a GLV DAC step) which is vectorized, unlike atan2f.
+void split_complex_angle(const Eigen::Ref<const Eigen::MatrixXf>& real, const Eigen::Ref<const Eigen::MatrixXf>& imag, Eigen::Ref<Eigen::MatrixXf> phase);
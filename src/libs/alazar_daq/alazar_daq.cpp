@@ -1,7 +1,9 @@
 #include <iostream>
 #include <iomanip>
 #include <conio.h>
+#include <emmintrin.h>
 #include "AlazarTech/ATS-SDK/7.1.5/Include/AlazarApi.h"
+#include "core2/pinned_memory.h"
 #include "alazar_daq.h"
 
 
@@ -21,8 +23,13 @@ DAQParams::DAQParams() :
 
 DAQ::DAQ() :
 	m_daq_running{false},
+	m_daq_armed{false},
 	m_daq_configured{false},
-	m_mem_allocated{false} {
+	m_mem_allocated{false},
+	m_buffer_array{nullptr},
+	m_buffer_memory{nullptr},
+	m_buffer_memory_bytes{0},
+	m_channel_count{1} {
 }
 
 
@@ -50,7 +57,7 @@ RETURN_CODE DAQ::configure(const DAQParams& daq_params) {
 	// Hardware level configuration //
 	//////////////////////////////////
 	// Specify the sample rate (see sample rate id below).
-	const double samples_per_sec = 500000000.0;
+	const double samples_per_sec = kDAQSamplesPerSec;
 
 	// Select clock parameters as required to generate this sample rate.
 	// For example: if samples_per_sec is 100.e6 (100 MS/s), then:
@@ -133,7 +140,7 @@ RETURN_CODE DAQ::configure(const DAQParams& daq_params) {
 	}
 
 	// Set trigger delay as required.
-	const u32 trigger_delay_required_alignment = 8;
+	const u32 trigger_delay_required_alignment = kDAQTriggerDelayAlignment;
 	u32 trigger_delay_samples = static_cast<u32>(daq_params.trigger_delay_sec * samples_per_sec + 0.5);
 	auto trigger_delay_alignment = trigger_delay_samples % trigger_delay_required_alignment;
 	if (trigger_delay_alignment != 0) {
@@ -195,22 +202,24 @@ RETURN_CODE DAQ::configure(const DAQParams& daq_params) {
 	auto bytes_per_sample = static_cast<f64>((bits_per_sample + 7) / 8);
 	auto bytes_per_record = static_cast<u32>(bytes_per_sample * daq_params.samples_per_record + 0.5); // 0.5 compensates for f64 to integer conversion 
 	m_bytes_per_buffer = bytes_per_record * daq_params.records_per_buffer * channel_count;
+	m_channel_count = channel_count;
 
 	// Allocate memory for DMA buffers.
+	// The buffers are carved from one page locked block (on huge pages where available), each buffer starts on a page.
 	if (m_mem_allocated) {
 		deallocate_memory();
 		m_mem_allocated = false;
 	}
 	if (!m_mem_allocated) {
-		m_buffer_array = new u16*[daq_params.buffer_count];
-		if (!m_buffer_array) {
-			return ApiFailed;	
+		auto buffer_stride = ((m_bytes_per_buffer + kDAQBufferAlignment - 1) / kDAQBufferAlignment) * kDAQBufferAlignment;
+		m_buffer_memory_bytes = buffer_stride * daq_params.buffer_count;
+		m_buffer_memory = allocate_pinned_memory(m_buffer_memory_bytes);
+		if (m_buffer_memory == nullptr) {
+			return ApiFailed;
 		}
+		m_buffer_array = new u16*[daq_params.buffer_count];
 		for (auto buffer_index = 0; buffer_index < daq_params.buffer_count; buffer_index++) {
-			m_buffer_array[buffer_index] = static_cast<u16*>(VirtualAlloc(nullptr, m_bytes_per_buffer, MEM_COMMIT, PAGE_READWRITE));
-			if (m_buffer_array[buffer_index] == nullptr) {
-				return ApiFailed;
-			}
+			m_buffer_array[buffer_index] = reinterpret_cast<u16*>(static_cast<u8*>(m_buffer_memory) + buffer_stride * buffer_index);
 		}
 		m_mem_allocated = true;
 	}
@@ -248,7 +257,11 @@ RETURN_CODE DAQ::capture() {
 	}
 	
 	// Configure the board to make an infinite NPT AutoDMA acquisition.
-	auto adma_flags = ADMA_EXTERNAL_STARTCAPTURE | ADMA_NPT | ADMA_FIFO_ONLY_STREAMING;
+	// With multiple channels, interleave the samples in the buffer (highest transfer rate), see deinterleave_channels.
+	u32 adma_flags = ADMA_EXTERNAL_STARTCAPTURE | ADMA_NPT | ADMA_FIFO_ONLY_STREAMING;
+	if (m_channel_count > 1) {
+		adma_flags |= ADMA_INTERLEAVE_SAMPLES;
+	}
 	auto return_code = AlazarBeforeAsyncRead(
 		m_board_handle,
 		m_daq_params.channel_mask,
@@ -278,16 +291,32 @@ RETURN_CODE DAQ::capture() {
 	}
 
 	// Capture loop.
+	// Let anyone waiting know that the board is armed (see wait_for_armed).
+	Trace::set_thread_name("daq");
 	u64 buffers_completed = 0;
 	m_daq_running = true;
+	{
+		std::lock_guard<std::mutex> lock(m_armed_mtx);
+		m_daq_armed = true;
+	}
+	m_armed_cv.notify_all();
 	while (m_daq_running) {
 		// Wait for the buffer at the head of the list of available buffers to be filled by the board.
 		auto buffer_index = buffers_completed % m_daq_params.buffer_count;
 		u16 *p_buffer = m_buffer_array[buffer_index];
-		return_code = AlazarWaitAsyncBufferComplete(m_board_handle, p_buffer, m_daq_params.acquisition_timeout_ms);
+		{
+			TraceSpan trace_span{"daq_wait"};
+			return_code = AlazarWaitAsyncBufferComplete(m_board_handle, p_buffer, m_daq_params.acquisition_timeout_ms);
+		}
 		if (return_code != ApiSuccess) {
 			if (return_code == ApiWaitTimeout) {
+				// The trigger count is read while the board is still running (see get_trigger_count).
+				on_buffer_timeout();
 				m_daq_running = false;
+				{
+					std::lock_guard<std::mutex> lock(m_armed_mtx);
+					m_daq_armed = false;
+				}
 				AlazarAbortAsyncRead(m_board_handle);
 				AlazarAbortCapture(m_board_handle);
 				return return_code;
@@ -304,7 +333,7 @@ RETURN_CODE DAQ::capture() {
 		// You MUST finish processing this buffer and post it back to the board before
 		// the board fills all of its available DMA buffers and on-board memory.
 		// Samples are arranged in the buffer as follows: S0A, S0B, ..., S1A, S1B, ...
-		// with SXY the sample number X of channel Y.
+		// with SXY the sample number X of channel Y (with a single channel: S0A, S1A, ...).
 		// A 12-bit sample code is stored in the most significant bits of in each 16-bit
 		// sample value. 
 		// Sample codes are unsigned by default. As a result:
@@ -327,6 +356,10 @@ RETURN_CODE DAQ::capture() {
 
 	// Abort the acquisition.
 	m_daq_running = false;
+	{
+		std::lock_guard<std::mutex> lock(m_armed_mtx);
+		m_daq_armed = false;
+	}
 	AlazarAbortAsyncRead(m_board_handle);
 	AlazarAbortCapture(m_board_handle);
 	return return_code;
@@ -338,24 +371,84 @@ void DAQ::stop() {
 }
 
 
+bool DAQ::wait_for_armed(const u32 timeout_ms) {
+	std::unique_lock<std::mutex> lock(m_armed_mtx);
+	return m_armed_cv.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] {return m_daq_armed; });
+}
+
+
+bool DAQ::get_trigger_count(u32* trigger_count) const {
+	if (!m_daq_running) {
+		return false;
+	}
+	U32 num_triggers;
+	const u32 password = 0x32145876;
+	auto return_code = AlazarReadRegister(m_board_handle, 12, &num_triggers, password);
+	if (return_code != ApiSuccess) {
+		return false;
+	}
+	*trigger_count = num_triggers;
+	return true;
+}
+
+
 void DAQ::set_cb_on_buffer_recv(cb_on_buffer_recv on_recv) {
 	m_daq_params.on_recv = on_recv;
 }
 
 
+void DAQ::set_trace_buffer(TraceBuffer* const trace_buffer) {
+	Trace::attach_buffer(trace_buffer);
+}
+
+
 const char* DAQ::error_to_text(const RETURN_CODE& return_code) const {
 	return AlazarErrorToText(return_code);
 }
 
 
+void DAQ::fit_record_to_window(const u32 window_start, const u32 window_length, u32* trigger_delay_samples, u32* samples_per_record, u32* window_offset) {
+	// Start the record as late as the trigger delay alignment allows.
+	*trigger_delay_samples = window_start - (window_start % kDAQTriggerDelayAlignment);
+	*window_offset = window_start - *trigger_delay_samples;
+
+	// The record must cover the window, be aligned and not shorter than the minimum.
+	auto samples = *window_offset + window_length;
+	samples = ((samples + kDAQSamplesPerRecordAlignment - 1) / kDAQSamplesPerRecordAlignment) * kDAQSamplesPerRecordAlignment;
+	*samples_per_record = (samples < kDAQMinSamplesPerRecord) ? kDAQMinSamplesPerRecord : samples;
+}
+
+
+void DAQ::deinterleave_channels(const u16* const interleaved, u16* const channel_a, u16* const channel_b, const size_t samples_per_channel) {
+	// Each 32 bit lane holds a sample pair (low 16 bits: channel A, high 16 bits: channel B).
+	// Sign extend each half to 32 bits and pack back with signed saturation, which keeps the original 16 bits.
+	// Each iteration handles 8 samples per channel.
+	const size_t samples_per_iteration = 8;
+	const auto vector_samples = samples_per_channel - (samples_per_channel % samples_per_iteration);
+	const auto src = reinterpret_cast<const __m128i*>(interleaved);
+	for (size_t sample_index = 0; sample_index < vector_samples; sample_index += samples_per_iteration) {
+		auto pairs_low = _mm_loadu_si128(src + (sample_index >> 2));
+		auto pairs_high = _mm_loadu_si128(src + (sample_index >> 2) + 1);
+		auto a = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(pairs_low, 16), 16), _mm_srai_epi32(_mm_slli_epi32(pairs_high, 16), 16));
+		auto b = _mm_packs_epi32(_mm_srai_epi32(pairs_low, 16), _mm_srai_epi32(pairs_high, 16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(channel_a + sample_index), a);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(channel_b + sample_index), b);
+	}
+
+	// Remainder.
+	for (auto sample_index = vector_samples; sample_index < samples_per_channel; ++sample_index) {
+		channel_a[sample_index] = interleaved[2 * sample_index];
+		channel_b[sample_index] = interleaved[2 * sample_index + 1];
+	}
+}
+
+
 void DAQ::deallocate_memory() {
 	if (m_mem_allocated) {
-		for (auto buffer_index = 0; buffer_index < m_daq_params.buffer_count; ++buffer_index) {
-			if (m_buffer_array[buffer_index]) {
-				VirtualFree(m_buffer_array[buffer_index], 0, MEM_RELEASE);
-			}
-		}
+		free_pinned_memory(m_buffer_memory, m_buffer_memory_bytes);
+		m_buffer_memory = nullptr;
 		delete[] m_buffer_array;
+		m_buffer_array = nullptr;
 	}
 }
 
@@ -366,10 +459,8 @@ void DAQ::on_buffer_receive(u16* const buffer, const size_t& length, const u64 b
 
 
 void DAQ::on_buffer_timeout() const {
-	U32 num_triggers;
-	const u32 password = 0x32145876;
-	auto return_code = AlazarReadRegister(m_board_handle, 12, &num_triggers, password);
-	if (return_code != ApiSuccess) {
+	u32 num_triggers;
+	if (!get_trigger_count(&num_triggers)) {
 		std::cout << "DAQ: Failed to get number of triggers" << std::endl;
 	}
 	else {
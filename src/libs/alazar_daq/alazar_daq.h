@@ -1,10 +1,21 @@
 #pragma once
 #include <windows.h>
 #include <functional>
+#include <mutex>
+#include <condition_variable>
 #include "AlazarTech/ATS-SDK/7.1.5/Include/AlazarError.h"
 #include "AlazarTech/ATS-SDK/7.1.5/Include/AlazarCmd.h"
 #include "core0/types.h"
 #include "core0/api_export.h"
+#include "core2/trace.h"
+
+
+// Board constants (ATS9350).
+const f64 kDAQSamplesPerSec = 500000000.0;
+const u32 kDAQTriggerDelayAlignment = 8;  // Trigger delay (samples) must be a multiple of this.
+const u32 kDAQMinSamplesPerRecord = 256;  // Record length requirements (samples).
+const u32 kDAQSamplesPerRecordAlignment = 32;
+const u32 kDAQBufferAlignment = 4096;  // Each DMA buffer starts on a page.
 
 
 // DAQ callbacks on buffer receive type.
@@ -51,22 +62,47 @@ public:
 	// Stops the capture.
 	API_EXPORT void stop();
 
+	// Blocks until the capture is armed and waits for triggers, or until the timeout expires.
+	// Returns true if the capture is armed.
+	API_EXPORT bool wait_for_armed(const u32 timeout_ms);
+
+	// Reads the number of triggers the board received, only valid while capturing.
+	API_EXPORT bool get_trigger_count(u32* trigger_count) const;
+
 	// Sets the buffer receive callback.
 	API_EXPORT void set_cb_on_buffer_recv(cb_on_buffer_recv on_recv);
 
+	// Records the waits for the buffers to the trace of the application (see core2/trace.h).
+	// Also calibrates the clock of the DLL, so it isn't calibrated by the first traced wait on the DAQ thread.
+	API_EXPORT void set_trace_buffer(TraceBuffer* const trace_buffer);
+
 	// Uses Alazar API to convert a return code to text.
 	API_EXPORT const char* error_to_text(const RETURN_CODE& return_code) const;
 
+	// Finds the trigger delay (samples) and the shortest record which cover an analysis window (samples after the trigger),
+	// given the board requirements on the trigger delay and the record length.
+	// window_offset is the first sample of the analysis window within the record.
+	API_EXPORT static void fit_record_to_window(const u32 window_start, const u32 window_length, u32* trigger_delay_samples, u32* samples_per_record, u32* window_offset);
+
+	// Splits a dual channel buffer (S0A, S0B, S1A, S1B, ...) into a channel A buffer and a channel B buffer.
+	API_EXPORT static void deinterleave_channels(const u16* const interleaved, u16* const channel_a, u16* const channel_b, const size_t samples_per_channel);
+
 private:
 	const u32 m_system_id = 1;
 	const u32 m_board_id = 1;
 	HANDLE m_board_handle;
 	DAQParams m_daq_params;
 	u16** m_buffer_array;
+	void* m_buffer_memory;  // All the DMA buffers are in one pinned block, see core2/pinned_memory.h.
+	size_t m_buffer_memory_bytes;
 	u32 m_bytes_per_buffer;
+	int m_channel_count;
 	bool m_daq_configured;
 	bool m_mem_allocated;
 	bool m_daq_running;
+	bool m_daq_armed;
+	std::mutex m_armed_mtx;
+	std::condition_variable m_armed_cv;
 
 	void deallocate_memory();
 	void on_buffer_receive(u16* const buffer, const size_t& length, const u64 buffers_completed) const;
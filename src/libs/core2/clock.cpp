@@ -0,0 +1,91 @@
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "clock.h"
+#if defined(CLOCK_HAS_TSC) && !defined(_MSC_VER)
+#include <cpuid.h>
+#endif
+
+namespace {
+const f64 kCalibrationTime_us = 10000;
+
+
+#ifdef CLOCK_HAS_TSC
+bool has_invariant_tsc() {
+	// CPUID 0x80000007, EDX bit 8.
+	const unsigned kLeafPowerManagement = 0x80000007;
+	unsigned registers[4];
+#if defined(_MSC_VER)
+	const unsigned kLeafMaxExtended = 0x80000000;
+	__cpuid(reinterpret_cast<int*>(registers), kLeafMaxExtended);
+	if (registers[0] < kLeafPowerManagement) {
+		return false;
+	}
+	__cpuid(reinterpret_cast<int*>(registers), kLeafPowerManagement);
+#else
+	if (!__get_cpuid(kLeafPowerManagement, &registers[0], &registers[1], &registers[2], &registers[3])) {
+		return false;
+	}
+#endif
+	return (registers[3] & (1U << 8)) != 0;
+}
+#endif
+
+
+f64 get_os_clock_ticks_per_usec() {
+#if defined(WIN32) || defined(_WIN32)
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return frequency.QuadPart / 1e6;
+#else
+	return 1e3;
+#endif
+}
+
+
+ClockSource calibrate_clock() {
+	ClockSource clock_source{false, get_os_clock_ticks_per_usec()};
+#ifdef CLOCK_HAS_TSC
+	if (!has_invariant_tsc()) {
+		return clock_source;
+	}
+
+	// Count the TSC ticks over a stretch of the OS clock, each OS reading is bracketed by two TSC readings.
+	auto os_ticks_per_usec = clock_source.ticks_per_usec;
+	auto tsc_start = __rdtsc();
+	auto os_start = get_os_clock_ticks();
+	tsc_start = (tsc_start + __rdtsc()) / 2;
+	u64 tsc_end;
+	u64 os_end;
+	do {
+		tsc_end = __rdtsc();
+		os_end = get_os_clock_ticks();
+		tsc_end = (tsc_end + __rdtsc()) / 2;
+	} while ((os_end - os_start) < kCalibrationTime_us * os_ticks_per_usec);
+	clock_source.tsc = true;
+	clock_source.ticks_per_usec = (tsc_end - tsc_start) / ((os_end - os_start) / os_ticks_per_usec);
+#endif
+	return clock_source;
+}
+}
+
+
+const ClockSource& get_clock_source() {
+	static const ClockSource clock_source = calibrate_clock();
+	return clock_source;
+}
+
+
+u64 get_os_clock_ticks() {
+#if defined(WIN32) || defined(_WIN32)
+	LARGE_INTEGER ticks;
+	QueryPerformanceCounter(&ticks);
+	return static_cast<u64>(ticks.QuadPart);
+#else
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+	return static_cast<u64>(time.tv_sec) * 1000000000ULL + static_cast<u64>(time.tv_nsec);
+#endif
+}
@@ -0,0 +1,42 @@
+#pragma once
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#define CLOCK_HAS_TSC
+#endif
+#include "../core0/types.h"
+
+
+// Source of the clock, see get_clock_ticks().
+struct ClockSource {
+	bool tsc;  // The invariant TSC, otherwise the monotonic clock of the OS.
+	f64 ticks_per_usec;
+};
+
+
+// Monotonic high resolution clock, shared by the timers (see hpc.h) and the tracing (see trace.h).
+// The source is the invariant TSC where the CPU has one (constant rate across the cores and the power states, a few ns to read),
+// and the monotonic clock of the OS otherwise (QueryPerformanceCounter on Windows, clock_gettime on Linux).
+// The rate of the TSC is calibrated against the OS clock on the first call (~10ms), so call it once outside the cycle path.
+const ClockSource& get_clock_source();
+
+// Ticks of the monotonic clock of the OS.
+u64 get_os_clock_ticks();
+
+
+inline u64 get_clock_ticks() {
+#ifdef CLOCK_HAS_TSC
+	if (get_clock_source().tsc) {
+		return __rdtsc();
+	}
+#endif
+	return get_os_clock_ticks();
+}
+
+
+inline f64 clock_ticks_to_usec(const i64 ticks) {
+	return ticks / get_clock_source().ticks_per_usec;
+}
@@ -1,13 +1,13 @@
 #pragma once
-#include <windows.h>
-#include "../Core0/types.h"
+#include "../core0/types.h"
 
+// Times one interval at a time, on the clock of clock.h (portable).
 class HPC {
 public:
 	bool start();
 	HPC& stop();
 	f64 get_time_in_usec() const;
 private:
-	LARGE_INTEGER m_li_start_tick_count, m_li_end_tick_count;
-	f64 m_cnt_per_sec;
+	u64 m_start_ticks = 0;
+	u64 m_end_ticks = 0;
 };
@@ -0,0 +1,191 @@
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#include <cstdint>
+#include "pinned_memory.h"
+
+namespace {
+const size_t kPageSize = 4096;
+
+
+size_t round_up(const size_t bytes, const size_t alignment) {
+	return ((bytes + alignment - 1) / alignment) * alignment;
+}
+
+
+#if defined(WIN32) || defined(_WIN32)
+bool enable_lock_memory_privilege() {
+	// Large pages need the "Lock pages in memory" privilege enabled in the token of the process (the account must hold it).
+	static const bool enabled = [] {
+		HANDLE token;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+			return false;
+		}
+		TOKEN_PRIVILEGES privileges{};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		auto success = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+			AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && (GetLastError() == ERROR_SUCCESS);
+		CloseHandle(token);
+		return success;
+	}();
+	return enabled;
+}
+
+
+DWORD get_numa_node(const int numa_node) {
+	if (numa_node != kNumaNodeOfCaller) {
+		return static_cast<DWORD>(numa_node);
+	}
+	PROCESSOR_NUMBER processor;
+	USHORT node;
+	GetCurrentProcessorNumberEx(&processor);
+	if (!GetNumaProcessorNodeEx(&processor, &node)) {
+		return NUMA_NO_PREFERRED_NODE;
+	}
+	return node;
+}
+#else
+int get_numa_node(const int numa_node) {
+	if (numa_node != kNumaNodeOfCaller) {
+		return numa_node;
+	}
+	unsigned cpu;
+	unsigned node;
+	if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+		return kNumaNodeOfCaller;
+	}
+	return static_cast<int>(node);
+}
+
+
+void* map_aligned_to_huge_page(const size_t mapped_bytes) {
+	// Transparent huge pages only back the 2MB aligned parts of a mapping, so a larger mapping is trimmed to an aligned one.
+	auto ptr = mmap(nullptr, mapped_bytes + kHugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (ptr == MAP_FAILED) {
+		return nullptr;
+	}
+	auto address = reinterpret_cast<uintptr_t>(ptr);
+	auto aligned_address = round_up(address, kHugePageSize);
+	if (aligned_address > address) {
+		munmap(ptr, aligned_address - address);
+	}
+	munmap(reinterpret_cast<void*>(aligned_address + mapped_bytes), address + kHugePageSize - aligned_address);
+	return reinterpret_cast<void*>(aligned_address);
+}
+#endif
+}
+
+
+size_t pinned_memory_mapped_bytes(const size_t bytes) {
+	return round_up(bytes, (bytes >= kHugePageMinBytes) ? kHugePageSize : kPageSize);
+}
+
+
+#if defined(WIN32) || defined(_WIN32)
+void* allocate_pinned_memory(const size_t bytes, const int numa_node) {
+	if (bytes == 0) {
+		return nullptr;
+	}
+	auto mapped_bytes = pinned_memory_mapped_bytes(bytes);
+	auto node = get_numa_node(numa_node);
+
+	// Large pages can't be paged out, so they are locked as they are.
+	if (((mapped_bytes % kHugePageSize) == 0) && (GetLargePageMinimum() == kHugePageSize) && enable_lock_memory_privilege()) {
+		auto ptr = VirtualAllocExNuma(GetCurrentProcess(), nullptr, mapped_bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node);
+		if (ptr) {
+			return ptr;
+		}
+	}
+	auto ptr = VirtualAllocExNuma(GetCurrentProcess(), nullptr, mapped_bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+	if (!ptr) {
+		return nullptr;
+	}
+
+	// Locked pages count against the minimum working set of the process, so it grows by the block first.
+	SIZE_T working_set_min;
+	SIZE_T working_set_max;
+	if (GetProcessWorkingSetSize(GetCurrentProcess(), &working_set_min, &working_set_max)) {
+		SetProcessWorkingSetSize(GetCurrentProcess(), working_set_min + mapped_bytes, working_set_max + mapped_bytes);
+	}
+	VirtualLock(ptr, mapped_bytes);
+	return ptr;
+}
+
+
+void free_pinned_memory(void* const ptr, const size_t bytes) {
+	if (!ptr) {
+		return;
+	}
+
+	// Unlocking fails for large pages, which didn't grow the working set.
+	auto mapped_bytes = pinned_memory_mapped_bytes(bytes);
+	if (VirtualUnlock(ptr, mapped_bytes)) {
+		SIZE_T working_set_min;
+		SIZE_T working_set_max;
+		if (GetProcessWorkingSetSize(GetCurrentProcess(), &working_set_min, &working_set_max) && (working_set_min > mapped_bytes)) {
+			SetProcessWorkingSetSize(GetCurrentProcess(), working_set_min - mapped_bytes, working_set_max - mapped_bytes);
+		}
+	}
+	VirtualFree(ptr, 0, MEM_RELEASE);
+}
+#else
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+const int kMapHuge2MB = 21 << MAP_HUGE_SHIFT;
+const int kMpolPreferred = 1;  // From linux/mempolicy.h, mbind is called directly so libnuma is not needed.
+const int kMaxNumaNodes = 1024;
+
+
+void* allocate_pinned_memory(const size_t bytes, const int numa_node) {
+	if (bytes == 0) {
+		return nullptr;
+	}
+	auto mapped_bytes = pinned_memory_mapped_bytes(bytes);
+	auto huge = ((mapped_bytes % kHugePageSize) == 0);
+
+	// Reserved huge pages (hugetlbfs) first, then transparent huge pages.
+	void* ptr = nullptr;
+	if (huge) {
+		ptr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | kMapHuge2MB, -1, 0);
+		if (ptr == MAP_FAILED) {
+			ptr = map_aligned_to_huge_page(mapped_bytes);
+			if (ptr) {
+				madvise(ptr, mapped_bytes, MADV_HUGEPAGE);
+			}
+		}
+	}
+	else {
+		ptr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		ptr = (ptr == MAP_FAILED) ? nullptr : ptr;
+	}
+	if (!ptr) {
+		return nullptr;
+	}
+
+	// The node has to be set before the pages are touched, locking faults them in.
+	auto node = get_numa_node(numa_node);
+	if ((node >= 0) && (node < kMaxNumaNodes)) {
+		unsigned long node_mask[kMaxNumaNodes / (8 * sizeof(unsigned long))] = {};
+		node_mask[node / (8 * sizeof(unsigned long))] = 1UL << (node % (8 * sizeof(unsigned long)));
+		syscall(SYS_mbind, ptr, mapped_bytes, kMpolPreferred, node_mask, kMaxNumaNodes, 0);
+	}
+	mlock(ptr, mapped_bytes);
+	return ptr;
+}
+
+
+void free_pinned_memory(void* const ptr, const size_t bytes) {
+	if (!ptr) {
+		return;
+	}
+	auto mapped_bytes = pinned_memory_mapped_bytes(bytes);
+	munlock(ptr, mapped_bytes);
+	munmap(ptr, mapped_bytes);
+}
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+#include <new>
+#include <cstddef>
+#include "../core0/types.h"
+
+const size_t kHugePageSize = 2 << 20;  // 2MB.
+const size_t kHugePageMinBytes = kHugePageSize >> 1;  // Smaller blocks get normal pages, most of a huge page would be wasted.
+const int kNumaNodeOfCaller = -1;
+
+
+// Page locked memory for the DMA and the processing buffers.
+// Blocks of at least kHugePageMinBytes are backed by 2MB huge pages where available (large pages on Windows, which need the
+// "Lock pages in memory" privilege, hugetlbfs or transparent huge pages on Linux), so a few TLB entries cover all the buffers.
+// The memory is placed on the NUMA node of the calling thread (or the given node) and locked in RAM, so it is never paged out.
+// Huge pages, the NUMA node and locking are best effort, a block which could not get them is still usable.
+// The memory is zeroed.
+void* allocate_pinned_memory(const size_t bytes, const int numa_node = kNumaNodeOfCaller);
+
+// Releases a block of allocate_pinned_memory, bytes is the size it was allocated with.
+void free_pinned_memory(void* const ptr, const size_t bytes);
+
+// Size which is actually mapped for a block of #bytes (rounded up to whole pages).
+size_t pinned_memory_mapped_bytes(const size_t bytes);
+
+
+// Allocator of the standard containers on pinned memory, each allocation is a block of its own.
+// Meant for large buffers which are allocated once (the processing arenas).
+template <typename T>
+class PinnedAllocator {
+public:
+	using value_type = T;
+
+	PinnedAllocator() = default;
+	template <typename U>
+	PinnedAllocator(const PinnedAllocator<U>&) {}
+
+	T* allocate(const size_t count) {
+		auto ptr = allocate_pinned_memory(count * sizeof(T));
+		if (!ptr) {
+			throw std::bad_alloc{};
+		}
+		return static_cast<T*>(ptr);
+	}
+
+	void deallocate(T* const ptr, const size_t count) {
+		free_pinned_memory(ptr, count * sizeof(T));
+	}
+};
+
+
+template <typename T, typename U>
+bool operator==(const PinnedAllocator<T>&, const PinnedAllocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const PinnedAllocator<T>&, const PinnedAllocator<U>&) { return false; }
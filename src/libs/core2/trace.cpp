@@ -0,0 +1,163 @@
+#if defined(WIN32) || defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include <new>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include "trace.h"
+
+namespace {
+TraceBuffer g_own_buffer;
+TraceBuffer* g_buffer = &g_own_buffer;
+thread_local TraceBuffer* t_ring_buffer = nullptr;
+thread_local u32 t_ring_generation = 0;
+thread_local int t_ring_index = -1;
+thread_local const char* t_thread_name = nullptr;
+
+
+u64 get_thread_id() {
+#if defined(WIN32) || defined(_WIN32)
+	return GetCurrentThreadId();
+#else
+	return static_cast<u64>(syscall(SYS_gettid));
+#endif
+}
+
+
+// Claims a ring for the calling thread on its first event of a recording, returns -1 if all the rings are taken.
+int get_thread_ring_index() {
+	auto generation = g_buffer->generation.load(std::memory_order_acquire);
+	if ((t_ring_buffer != g_buffer) || (t_ring_generation != generation)) {
+		t_ring_buffer = g_buffer;
+		t_ring_generation = generation;
+		t_ring_index = g_buffer->ring_count.fetch_add(1);
+		if (t_ring_index >= kTraceMaxThreads) {
+			t_ring_index = -1;
+			return t_ring_index;
+		}
+		auto& ring = g_buffer->rings[t_ring_index];
+		ring.thread_id = get_thread_id();
+		ring.thread_name = t_thread_name;
+		ring.event_count.store(0, std::memory_order_relaxed);
+	}
+	return t_ring_index;
+}
+}
+
+
+bool Trace::start() {
+	// The events are allocated once, threads may still hold spans of the previous recording.
+	if (!g_buffer->events) {
+		g_buffer->events = new (std::nothrow) TraceEvent[kTraceMaxThreads * kTraceEventsPerThread];
+		if (!g_buffer->events) {
+			return false;
+		}
+	}
+	get_clock_source();
+	g_buffer->ring_count.store(0, std::memory_order_relaxed);
+	g_buffer->generation.fetch_add(1, std::memory_order_release);
+	g_buffer->start_ticks = get_clock_ticks();
+	g_buffer->recording.store(true, std::memory_order_release);
+	return true;
+}
+
+
+void Trace::stop() {
+	g_buffer->recording.store(false, std::memory_order_release);
+}
+
+
+bool Trace::is_recording() {
+	return g_buffer->recording.load(std::memory_order_relaxed);
+}
+
+
+void Trace::record(const char* const name, const u64 start_ticks, const u64 end_ticks) {
+	if (!g_buffer->recording.load(std::memory_order_acquire)) {
+		return;
+	}
+	auto ring_index = get_thread_ring_index();
+	if (ring_index < 0) {
+		return;
+	}
+
+	// The event is written before it is counted, so the export never reads a partially written event.
+	auto& ring = g_buffer->rings[ring_index];
+	auto event_count = ring.event_count.load(std::memory_order_relaxed);
+	g_buffer->events[ring_index * kTraceEventsPerThread + (event_count & (kTraceEventsPerThread - 1))] = TraceEvent{name, start_ticks, end_ticks};
+	ring.event_count.store(event_count + 1, std::memory_order_release);
+}
+
+
+void Trace::set_thread_name(const char* const name) {
+	// A thread which already has a ring in this recording is renamed right away.
+	t_thread_name = name;
+	if ((t_ring_buffer == g_buffer) && (t_ring_generation == g_buffer->generation.load(std::memory_order_acquire)) && (t_ring_index >= 0)) {
+		g_buffer->rings[t_ring_index].thread_name = name;
+	}
+}
+
+
+bool Trace::export_to_chrome_json(const std::string& file_name) {
+	if (!g_buffer->events) {
+		return false;
+	}
+	std::ofstream file{file_name};
+	if (!file) {
+		return false;
+	}
+
+	// Timestamps are in us since start(), with ns resolution.
+	file << std::fixed;
+	file.precision(3);
+	file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	auto first_event = true;
+	auto ring_count = (std::min)(g_buffer->ring_count.load(std::memory_order_acquire), kTraceMaxThreads);
+	std::vector<TraceEvent> events;
+	for (auto ring_index = 0; ring_index < ring_count; ++ring_index) {
+		// Copy the events in the ring, then drop the ones which were overwritten while copying.
+		auto& ring = g_buffer->rings[ring_index];
+		auto event_count = ring.event_count.load(std::memory_order_acquire);
+		auto event_start = (event_count > kTraceEventsPerThread) ? (event_count - kTraceEventsPerThread) : 0;
+		auto ring_events = g_buffer->events + ring_index * kTraceEventsPerThread;
+		events.clear();
+		for (auto event_index = event_start; event_index < event_count; ++event_index) {
+			events.push_back(ring_events[event_index & (kTraceEventsPerThread - 1)]);
+		}
+		auto event_count_after_copy = ring.event_count.load(std::memory_order_acquire);
+		auto overwritten_events = (event_count_after_copy > kTraceEventsPerThread) ? (event_count_after_copy - kTraceEventsPerThread) : 0;
+		auto valid_start = static_cast<size_t>((std::max)(overwritten_events, event_start) - event_start);
+
+		// Chrome trace events: a metadata event naming the thread, and a complete event ("X") per span.
+		file << (first_event ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ring.thread_id <<
+			",\"args\":{\"name\":\"" << (ring.thread_name ? ring.thread_name : "thread") << "\"}}";
+		first_event = false;
+		for (auto event_index = valid_start; event_index < events.size(); ++event_index) {
+			auto& event = events[event_index];
+			if (event.start_ticks < g_buffer->start_ticks) {
+				continue;
+			}
+			file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << ring.thread_id <<
+				",\"ts\":" << clock_ticks_to_usec(event.start_ticks - g_buffer->start_ticks) <<
+				",\"dur\":" << clock_ticks_to_usec(event.end_ticks - event.start_ticks) << "}";
+		}
+	}
+	file << "\n]}\n";
+	return static_cast<bool>(file);
+}
+
+
+TraceBuffer* Trace::get_buffer() {
+	return g_buffer;
+}
+
+
+void Trace::attach_buffer(TraceBuffer* const buffer) {
+	// The clock of the module calibrates here, rather than in the first span it records on the cycle path.
+	get_clock_source();
+	g_buffer = buffer ? buffer : &g_own_buffer;
+}
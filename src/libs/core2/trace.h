@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <string>
+#include "../core0/types.h"
+#include "clock.h"
+
+const int kTraceMaxThreads = 64;
+const u64 kTraceEventsPerThread = 1 << 14;  // Power of 2, the ring of each thread keeps its latest events.
+
+
+// An interval on the timeline of a thread, in clock ticks (see clock.h).
+// The name is not copied, it should be a string literal.
+struct TraceEvent {
+	const char* name;
+	u64 start_ticks;
+	u64 end_ticks;
+};
+
+
+// The events of one thread. Only the thread writes to its ring, so recording is lock free.
+struct TraceRing {
+	std::atomic<u64> event_count;
+	u64 thread_id;
+	const char* thread_name;
+};
+
+
+// The rings of all the threads, and the events behind them (allocated on the first start, never freed).
+// The DLLs link core2 statically, so each has a buffer of its own, attach them to the buffer of the application (see Trace::attach_buffer).
+struct TraceBuffer {
+	std::atomic<bool> recording;
+	std::atomic<int> ring_count;
+	std::atomic<u32> generation;  // Bumped by each start(), which frees all the rings, threads claim a ring again on their next event.
+	u64 start_ticks;
+	TraceRing rings[kTraceMaxThreads];
+	TraceEvent* events;
+};
+
+
+// Records spans on a timeline shared by all the threads, to see how the DAQ, the processing and the GLV transfers overlap.
+// Each thread has a ring of its latest events (kTraceEventsPerThread), recording costs a few clock readings and no locks or allocations.
+// When not recording, a span costs a single load. The timeline is exported to a Chrome trace (chrome://tracing or ui.perfetto.dev).
+class Trace {
+public:
+	// Starts recording, the events and the rings of a previous recording are dropped.
+	static bool start();
+
+	// Stops recording, the events are kept for export.
+	static void stop();
+
+	static bool is_recording();
+
+	// Records an interval on the timeline of the calling thread.
+	static void record(const char* const name, const u64 start_ticks, const u64 end_ticks);
+
+	// Names the timeline of the calling thread (a string literal), otherwise it is named after its thread id.
+	// Doesn't claim a ring, the name is taken on the first event of the thread.
+	static void set_thread_name(const char* const name);
+
+	// Writes the events since start() in the Chrome trace event format (JSON).
+	// Exporting while recording drops the events which are overwritten during the export.
+	static bool export_to_chrome_json(const std::string& file_name);
+
+	// The buffer events are recorded to.
+	static TraceBuffer* get_buffer();
+
+	// Records to the buffer of another module (call before anything is recorded), and calibrates the clock of the module.
+	static void attach_buffer(TraceBuffer* const buffer);
+};
+
+
+// Records the scope it lives in as a span (when recording).
+class TraceSpan {
+public:
+	explicit TraceSpan(const char* const name) :
+		m_name{name},
+		m_start_ticks{Trace::is_recording() ? get_clock_ticks() : 0} {
+	}
+
+	~TraceSpan() {
+		if (m_start_ticks) {
+			Trace::record(m_name, m_start_ticks, get_clock_ticks());
+		}
+	}
+
+	TraceSpan(const TraceSpan&) = delete;
+	TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+	const char* m_name;
+	u64 m_start_ticks;
+};
@@ -1,4 +1,7 @@
 #include <windows.h>
+#include <cstdio>
+#include <cstring>
+#include "core2/pinned_memory.h"
 #include "glv.h"
 const USHORT kVendorID = 0x0D2B;
 const USHORT kProductID = 0x0102;
@@ -11,6 +14,7 @@ GLVParams::GLVParams() :
 	vddah{324},
 	trigger_auto{false},
 	col_period_ns{6000},
+	loopcycle{true},
 	com_port{"COM3"},
 	on_recv{nullptr} {
 }
@@ -22,7 +26,10 @@ GLV::GLV() :
 	m_mem_allocated{false},
 	m_loopcycle_running{false},
 	m_glv_responsive{false},
-	m_preload_column_count{0} {	
+	m_glv_buffer{nullptr},
+	m_preload_column_count{0},
+	m_loopcycle_column_start{0},
+	m_loopcycle_column_end{0} {	
 	m_usb_device = std::make_unique<CCyUSBDevice>();
 	const auto on_uart_recv = std::bind(&GLV::on_uart_receive, this, std::placeholders::_1, std::placeholders::_2);
 	m_uart.set_cb_on_recv(on_uart_recv);
@@ -31,7 +38,7 @@ GLV::GLV() :
 
 GLV::~GLV() {
 	if (m_glv_buffer) {
-		VirtualFree(m_glv_buffer, 0, MEM_RELEASE);
+		free_pinned_memory(m_glv_buffer, kGLVBytesPerTransfer);
 	}
 	if (m_test_running) {
 		m_test_running = false;
@@ -49,19 +56,15 @@ bool GLV::configure(const GLVParams& glv_params) {
 	// Set the internal uart receive call back.
 	m_on_glv_serial_recv = glv_params.on_recv;
 	
-	// Allocate a GLV buffer for sending data over the USB.
+	// Allocate a GLV buffer for sending data over the USB (page locked, so the transfer never waits for a page fault).
 	if (!m_mem_allocated) {
-		m_glv_buffer = static_cast<u16*>(VirtualAlloc(nullptr, kGLVBytesPerTransfer, MEM_COMMIT, PAGE_READWRITE));
+		m_glv_buffer = static_cast<u16*>(allocate_pinned_memory(kGLVBytesPerTransfer));
 		if (m_glv_buffer == nullptr) {
 			return false;
 		}
 		m_mem_allocated = true;
 	}
 
-#ifdef GLV_PROCESSING_EMULATION
-	return true;
-#endif
-
 	// Open the USB3 and the UART interfaces.
 	bool uart_ok = false;
 	bool usb_ok = false;
@@ -95,6 +98,8 @@ bool GLV::preload(const GLVFrameXs& dac_frame) {
 	
 	// Configure the GLV to accept data over USB.
 	m_preload_column_count = dac_frame.cols();
+	m_loopcycle_column_start = 0;
+	m_loopcycle_column_end = m_preload_column_count - 1;
 	uart_send_to_glv("USB 0 0 " + std::to_string(m_preload_column_count));
 	
 	// Iterate through the columns and load to the GLV.
@@ -111,6 +116,23 @@ bool GLV::preload(const GLVFrameXs& dac_frame) {
 }
 
 
+bool GLV::load_columns(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) {
+	// Verify column size.
+	assert(dac_frame.rows() == kGLVPixels);
+
+	// The GLV is idle, so the UART command doesn't need the usual long wait.
+	char command[kGLVCommandLength];
+	std::snprintf(command, sizeof(command), "USB 0 %u %u", static_cast<u32>(column_start), static_cast<u32>(dac_frame.cols()));
+	uart_send_to_glv(command, kGLVReloadSleep_ms);
+	for (auto col_index = 0; col_index < dac_frame.cols(); ++col_index) {
+		if (!usb_load_to_glv(dac_frame.col(col_index))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
 bool GLV::cycle(const u16 column_start, const u16 column_end, const bool repeat) {
 	if (repeat) {
 		return uart_send_to_glv("LOOPLUT " + std::to_string(column_start) + " " + std::to_string(column_end) + " 0");
@@ -123,34 +145,118 @@ bool GLV::cycle(const u16 column_start, const u16 column_end, const bool repeat)
 
 
 bool GLV::run_loop_cycle() {
-#ifdef GLV_NO_LOOPCYCLE
-	// Configure GLV to cycle through all the preloaded PLUTs (loaded from index #0 to index #preload_column_count_-1)
-	uart_send_to_glv("GOLUT 0 " + std::to_string(preload_column_count_ - 1));
-	return true;
-#else
+	return start_loop_cycle(1000);
+}
+
+
+bool GLV::start_loop_cycle(const u32 post_sleep_time) {
+	if (!m_glv_params.loopcycle) {
+		// Configure GLV to cycle through the preloaded PLUTs of the loop cycle range (all the preloaded columns by default).
+		char command[kGLVCommandLength];
+		std::snprintf(command, sizeof(command), "GOLUT %zu %zu", m_loopcycle_column_start, m_loopcycle_column_end);
+		uart_send_to_glv(command, post_sleep_time);
+		return true;
+	}
+
 	// Specialized GLV command to:
-	// 1.Run a set of preloaded columns between index #0 and index #preload_column_count_-1
+	// 1.Run a set of preloaded columns between index #m_loopcycle_column_start and index #m_loopcycle_column_end (all by default)
 	// 2.Wait for a column to be sent over the USB (without a UART command)
 	// 3.Once arrived, store in #preload_column_count_ (the third parameter) and display
 	// 4.Repeat (go back to step 1), optionally wait here.
 	// Note: the last two numbers are wait time (us) in step 4 and whether or not to trigger for step 3 (correspondingly)
+	// The loop cycle is restarted on the cycle path, so the command is formatted without allocating.
 	m_loopcycle_running = true;
-	uart_send_to_glv("LOOPCYCLE 0 " + std::to_string(m_preload_column_count - 1) + " " + std::to_string(m_preload_column_count) + " " + std::to_string(m_glv_params.loopcycle_wait_us) + " 0");
+	char command[kGLVCommandLength];
+	std::snprintf(command, sizeof(command), "LOOPCYCLE %zu %zu %zu %u 0", m_loopcycle_column_start, m_loopcycle_column_end, m_preload_column_count, m_glv_params.loopcycle_wait_us);
+	uart_send_to_glv(command, post_sleep_time);
 	return true;
-#endif
+}
+
+
+bool GLV::restart_loop_cycle(const u32 loopcycle_wait_us) {
+	// The wait is a parameter of the loop cycle command, so it has to be stopped and sent again.
+	// The restart runs on the cycle path while the GLV waits for the variable column, so the UART commands use the short wait.
+	m_glv_params.loopcycle_wait_us = loopcycle_wait_us;
+	if (!m_loopcycle_running) {
+		return true;
+	}
+	uart_send_to_glv("LOOPSTOP", kGLVReloadSleep_ms);
+	m_loopcycle_running = false;
+	return start_loop_cycle(kGLVReloadSleep_ms);
+}
+
+
+bool GLV::set_loop_cycle_range(const u16 column_start, const u16 column_end) {
+	assert((column_start <= column_end) && (column_end < m_preload_column_count));
+	m_loopcycle_column_start = column_start;
+	m_loopcycle_column_end = column_end;
+	if (!m_loopcycle_running) {
+		return true;
+	}
+	uart_send_to_glv("LOOPSTOP", kGLVReloadSleep_ms);
+	m_loopcycle_running = false;
+	return start_loop_cycle(kGLVReloadSleep_ms);
+}
+
+
+bool GLV::reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame) {
+	// Verify column size and range.
+	assert(dac_frame.rows() == kGLVPixels);
+	assert((column_start + dac_frame.cols()) <= m_preload_column_count);
+
+	// While the loop cycle runs, a column sent over the USB is taken as the variable column, so stop it first.
+	// The GLV is idle, so the UART commands don't need the usual long wait.
+	if (m_loopcycle_running) {
+		uart_send_to_glv("LOOPSTOP", kGLVReloadSleep_ms);
+		m_loopcycle_running = false;
+	}
+	if (!load_columns(column_start, dac_frame)) {
+		return false;
+	}
+	return start_loop_cycle(kGLVReloadSleep_ms);
+}
+
+
+bool GLV::reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame, const u16 loop_column_start, const u16 loop_column_end) {
+	// The range takes effect when the loop cycle restarts after the reload.
+	assert((loop_column_start <= loop_column_end) && (loop_column_end < m_preload_column_count));
+	m_loopcycle_column_start = loop_column_start;
+	m_loopcycle_column_end = loop_column_end;
+	return reload_loop_cycle(column_start, dac_frame);
 }
 
 
 bool GLV::stop_loop_cycle() {
 	// Stop the loop cycle command.
 	if (m_loopcycle_running) {
-		return uart_send_to_glv("LOOPSTOP");
 		m_loopcycle_running = false;
+		return uart_send_to_glv("LOOPSTOP");
 	}
 	return true;
 }
 
 
+bool GLV::interrupt_loop_cycle(const u16 filler_columns) {
+	// The GLV is idle, so the UART commands don't need the usual long wait.
+	m_loopcycle_running = false;
+	if (!uart_send_to_glv("LOOPSTOP", kGLVReloadSleep_ms)) {
+		return false;
+	}
+	if (filler_columns == 0) {
+		return true;
+	}
+	char command[kGLVCommandLength];
+	std::snprintf(command, sizeof(command), "GOLUT 0 %u", static_cast<u32>(filler_columns - 1));
+	bool uart_send_ok = uart_send_to_glv(command, kGLVReloadSleep_ms);
+	return uart_send_ok & uart_send_to_glv("SOFTTRIGGER F1", kGLVReloadSleep_ms);
+}
+
+
+bool GLV::resume_loop_cycle() {
+	return start_loop_cycle(kGLVReloadSleep_ms);
+}
+
+
 bool GLV::stop() {
 	// Stop any constant display.
 	return uart_send_to_glv("/");
@@ -168,9 +274,6 @@ bool GLV::reset() {
 
 
 bool GLV::run_test(const GLV_TESTS& test_index) {
-#ifdef GLV_PROCESSING_EMULATION
-	return false;
-#endif
 	if (!m_glv_hw_configured) {
 		return false;
 	}
@@ -294,40 +397,43 @@ bool GLV::load_and_resume_cycle(const GLVColVectorXs& dac_column) {
 	assert(dac_column.rows() == kGLVPixels);
 
 	// If GLV does not have loop cycle command, manually configure it to accept data over USB.
-#ifdef GLV_NO_LOOPCYCLE
-	// Configure GLV for receiving only one LUT over USB indexed at #preload_column_count_.
-	uart_send_to_glv("USB 0 "+ std::to_string(preload_column_count_) + " 1");
-#endif
+	// Configure GLV for receiving only one LUT over USB indexed at #m_preload_column_count.
+	char command[kGLVCommandLength];
+	if (!m_glv_params.loopcycle) {
+		std::snprintf(command, sizeof(command), "USB 0 %zu 1", m_preload_column_count);
+		uart_send_to_glv(command);
+	}
 
   // Send the new column o the USB.
 	auto transfer_success = usb_load_to_glv(dac_column);
 
 	// If GLV does not have loop cycle command, manually configure it to display the given dac_column and then 
 	// cycle again through the preloaded columns.
-#ifdef GLV_NO_LOOPCYCLE
-	// Configure GLV to display only one PLUT starting with the index #preload_column_count_ and ending with the same index.
-	uart_send_to_glv("GOLUT " + std::to_string(preload_column_count_) + " " + std::to_string(preload_column_count_));
-
-	// Configure GLV to cycle through all the preloaded PLUTs (loaded from index #0 to index #preload_column_count_-1).
-	uart_send_to_glv("GOLUT 0 " + std::to_string(preload_column_count_ - 1));
-#endif
+	if (!m_glv_params.loopcycle) {
+		// Configure GLV to display only one PLUT starting with the index #m_preload_column_count and ending with the same index.
+		std::snprintf(command, sizeof(command), "GOLUT %zu %zu", m_preload_column_count, m_preload_column_count);
+		uart_send_to_glv(command);
+
+		// Configure GLV to cycle through the preloaded PLUTs of the loop cycle range again.
+		std::snprintf(command, sizeof(command), "GOLUT %zu %zu", m_loopcycle_column_start, m_loopcycle_column_end);
+		uart_send_to_glv(command);
+	}
 
 	return transfer_success;
 }
 
 
-bool GLV::usb_load_to_glv(const GLVColVectorXs& dac_column) {
+void GLV::set_trace_buffer(TraceBuffer* const trace_buffer) {
+	Trace::attach_buffer(trace_buffer);
+}
+
+
+bool GLV::usb_load_to_glv(const Eigen::Ref<const GLVColVectorXs>& dac_column) {
+	TraceSpan trace_span{"glv_usb"};
 	// Process the eigen vector to a raw buffer.
 	convert_to_raw_buffer(dac_column);
 
 	// Send over USB.
-#ifdef GLV_PROCESSING_EMULATION
-	// Debugging with array plotter, place break point on dummy = m_glv_buffer[0];
-	u16 plot_buffer_u16[kGLVPixels];
-	GLVColVectorXs::Map(plot_buffer_u16, dac_column.rows()) = dac_column;
-	volatile auto dummy = m_glv_buffer[0];
-	return true;
-#endif
 	auto ep_bulk_out = m_usb_device->BulkOutEndPt;
 	auto length = static_cast<LONG>(kGLVBytesPerTransfer);
 	auto success = ep_bulk_out->XferData(reinterpret_cast<PUCHAR>(m_glv_buffer), length);
@@ -340,15 +446,26 @@ bool GLV::usb_load_to_glv(const GLVColVectorXs& dac_column) {
 
 
 bool GLV::uart_send_to_glv(const std::string& command, const u32 post_sleep_time) {
-#ifdef GLV_PROCESSING_EMULATION
-	return true;
-#endif
-	std::unique_lock<std::mutex>(uart_mtx);
-	auto success = m_uart.send(command + '\r');
+	return uart_send_to_glv(command.c_str(), post_sleep_time);
+}
+
+
+bool GLV::uart_send_to_glv(const char* const command, const u32 post_sleep_time) {
+	// The carriage return is appended in a member buffer, so sending doesn't allocate.
+	size_t success;
+	{
+		TraceSpan trace_span{"glv_uart"};
+		std::lock_guard<std::mutex> lock(m_uart_mtx);
+		auto length = strnlen(command, kGLVCommandLength);
+		std::memcpy(m_uart_command, command, length);
+		m_uart_command[length] = '\r';
+		success = m_uart.send(m_uart_command, length + 1);
+	}
 	if ((success == 0xffffffffffffffff) || (success == 0)) {
 		return false;
 	}
 	else {
+		TraceSpan trace_span{"glv_uart_sleep"};
 		Sleep(post_sleep_time);
 		return true;
 	}
@@ -388,28 +505,8 @@ bool GLV::configure_over_uart() {
 }
 
 
-void GLV::convert_to_raw_buffer(const GLVColVectorXs& dac_column) {
-	// Interleave the pixels into the following scheme:
-	// 0, 1, 2, 3, 4, 5, 6, 7, 8, ... , 1086, 1087
-	//                         ||
-	//                         \/
-	// 0, 1, 544, 545, 2, 3, 546, 547, ... , 542, 543, 1086, 1087
-	// Also swap the bytes on each u16 dac value.
-	const int kGLVPixelsHalf = kGLVPixels >> 1;
-	const int kGLVPixelsHalfPlusOne = kGLVPixelsHalf + 1;
-	const int kGLVPixelsHalfMinusOne = kGLVPixelsHalf - 1;
-	for (auto sample_index = 0; sample_index < kGLVPixelsHalfMinusOne; sample_index += 2) {
-		auto il_index = sample_index << 1;
-		m_glv_buffer[il_index    ] = byte_swap(dac_column[sample_index]);
-		m_glv_buffer[il_index + 1] = byte_swap(dac_column[sample_index + 1]);
-		m_glv_buffer[il_index + 2] = byte_swap(dac_column[kGLVPixelsHalf + sample_index]);
-		m_glv_buffer[il_index + 3] = byte_swap(dac_column[kGLVPixelsHalfPlusOne + sample_index]);
-	}
-}
-
-
-u16 GLV::byte_swap(const u16 dac_value) const {
-	return ((dac_value & 0x00FF) << 8) | ((dac_value & 0xFF00) >> 8);
+void GLV::convert_to_raw_buffer(const Eigen::Ref<const GLVColVectorXs>& dac_column) {
+	convert_glv_column_to_raw_buffer(dac_column.data(), m_glv_buffer);
 }
 
 
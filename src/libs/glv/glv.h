@@ -7,19 +7,15 @@
 #include "eigen/Eigen/Dense"
 #include "core0/types.h"
 #include "core0/api_export.h"
+#include "core2/trace.h"
 #include "serialport/serialport.h"
+#include "glv_column.h"
 
-#define kGLVPixels 1088
 #define kGLVMinAmp 0
 #define kGLVMaxAmp 1023
 #define kGLVDACLevels 1024
-//#define GLV_NO_LOOPCYCLE
-//#define GLV_PROCESSING_EMULATION
-
-
-// Type aliases to a GLV column and GLV frame.
-using GLVColVectorXs = Eigen::Matrix<u16, -1, 1>;
-using GLVFrameXs = Eigen::Matrix<u16, -1, -1>;
+#define kGLVReloadSleep_ms 10  // Wait after the UART commands which reload or restart the loop cycle, the GLV is idle between the loop cycles.
+#define kGLVCommandLength 128  // The commands of the cycle path are formatted to a buffer of this size, so they don't allocate.
 
 
 // DAQ configuration parameters.
@@ -29,6 +25,7 @@ struct GLVParams {
 	int vddah;
 	u32 col_period_ns;
 	u32 loopcycle_wait_us;
+	bool loopcycle;  // The firmware has the LOOPCYCLE command, otherwise the loop cycle is emulated with USB and GOLUT commands (slower).
 	std::string com_port;
 	cb_on_serial_recv on_recv;
 };
@@ -65,15 +62,42 @@ public:
 	// Each column should be shaped as a col vector in the input matrix.
 	API_EXPORT bool preload(const GLVFrameXs& dac_frame);
 
+	// Loads columns to the PLUT starting at column_start, the other columns are kept (unlike preload()).
+	// Columns past the preloaded ones can be cycled, but are not part of the loop cycle. The loop cycle must be stopped.
+	API_EXPORT bool load_columns(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame);
+
 	// Cycles through the contents of the PLUT between start and end.
 	API_EXPORT bool cycle(const u16 column_start, const u16 column_end, const bool repeat = false);
 
 	// Starts projecting the pre-loaded frame and wait for a variable column, once received, repeat.
 	API_EXPORT bool run_loop_cycle();
 
+	// Restarts the loop cycle with a new wait (us) after the variable column, see comment run_loop_cycle().
+	// Should be called while the GLV waits for the variable column, so no cycle of the preloaded columns is cut.
+	API_EXPORT bool restart_loop_cycle(const u32 loopcycle_wait_us);
+
 	// Stops the loop cycle, see comment run_loop_cycle().
 	API_EXPORT bool stop_loop_cycle();
 
+	// Stops the loop cycle and displays the preloaded columns [0, filler_columns - 1] once (none if 0), e.g. to complete a partially
+	// filled DAQ buffer. Should be called while the GLV waits for the variable column, so it can be called on the cycle path.
+	API_EXPORT bool interrupt_loop_cycle(const u16 filler_columns);
+
+	// Starts the loop cycle again after interrupt_loop_cycle(), with the same range and wait.
+	API_EXPORT bool resume_loop_cycle();
+
+	// Sets the preloaded columns which the loop cycle runs through (all the preloaded columns by default), see comment run_loop_cycle().
+	// Restarts the loop cycle if running, so should be called while the GLV waits for the variable column.
+	API_EXPORT bool set_loop_cycle_range(const u16 column_start, const u16 column_end);
+
+	// Replaces preloaded columns starting at column_start and (re)starts the loop cycle.
+	// Should be called while the GLV waits for the variable column, the number of preloaded columns is kept.
+	// The frame is taken by reference (a block of a larger frame is not copied).
+	API_EXPORT bool reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame);
+
+	// Same as above, and the loop cycle restarts with the range [loop_column_start, loop_column_end].
+	API_EXPORT bool reload_loop_cycle(const u16 column_start, const Eigen::Ref<const GLVFrameXs>& dac_frame, const u16 loop_column_start, const u16 loop_column_end);
+
 	// Stops the GLV from any constant, repeatative display.
 	API_EXPORT bool stop();
 
@@ -93,6 +117,10 @@ public:
 	// Loads one dymanic column to the GLV.
 	API_EXPORT bool load_and_resume_cycle(const GLVColVectorXs& dac_column);
 
+	// Records the UART commands and the USB transfers to the trace of the application (see core2/trace.h).
+	// Also calibrates the clock of the DLL, so it isn't calibrated by the first traced command on the cycle path.
+	API_EXPORT void set_trace_buffer(TraceBuffer* const trace_buffer);
+
 private:
 	bool m_glv_hw_configured;
 	bool m_test_running;
@@ -104,15 +132,19 @@ private:
 	GLVParams m_glv_params;
 	u16* m_glv_buffer;
 	size_t m_preload_column_count;
+	size_t m_loopcycle_column_start;
+	size_t m_loopcycle_column_end;
 	std::unique_ptr<CCyUSBDevice> m_usb_device;
 	std::thread m_test_thread;
 	std::mutex m_uart_mtx;
+	char m_uart_command[kGLVCommandLength + 1];  // Command and its carriage return.
 
-	bool usb_load_to_glv(const GLVColVectorXs& dac_column);
+	bool usb_load_to_glv(const Eigen::Ref<const GLVColVectorXs>& dac_column);
 	bool uart_send_to_glv(const std::string& command, const u32 post_sleep_time = 1000);
+	bool uart_send_to_glv(const char* const command, const u32 post_sleep_time = 1000);
+	bool start_loop_cycle(const u32 post_sleep_time);
 	bool configure_over_uart();
-	void convert_to_raw_buffer(const GLVColVectorXs& dac_column);
-	u16 byte_swap(const u16 dac_value) const;
+	void convert_to_raw_buffer(const Eigen::Ref<const GLVColVectorXs>& dac_column);
 	bool open_fx3();
 	void on_uart_receive(char* const data_ptr, const size_t data_len);
 };
\ No newline at end of file
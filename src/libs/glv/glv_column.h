@@ -0,0 +1,38 @@
+#pragma once
+#include "eigen/Eigen/Dense"
+#include "core0/types.h"
+
+#define kGLVPixels 1088
+
+
+// Type aliases to a GLV column and GLV frame.
+using GLVColVectorXs = Eigen::Matrix<u16, -1, 1>;
+using GLVFrameXs = Eigen::Matrix<u16, -1, -1>;
+
+
+// Swaps the bytes of a u16 dac value.
+inline u16 glv_byte_swap(const u16 dac_value) {
+	return ((dac_value & 0x00FF) << 8) | ((dac_value & 0xFF00) >> 8);
+}
+
+
+// Converts a column of kGLVPixels DAC values to the raw buffer the GLV reads over the USB.
+// Interleave the pixels into the following scheme:
+// 0, 1, 2, 3, 4, 5, 6, 7, 8, ... , 1086, 1087
+//                         ||
+//                         \/
+// 0, 1, 544, 545, 2, 3, 546, 547, ... , 542, 543, 1086, 1087
+// Also swap the bytes on each u16 dac value.
+// Header only and free of the hardware, so the applications can benchmark it.
+inline void convert_glv_column_to_raw_buffer(const u16* const dac_column, u16* const raw_buffer) {
+	const int kGLVPixelsHalf = kGLVPixels >> 1;
+	const int kGLVPixelsHalfPlusOne = kGLVPixelsHalf + 1;
+	const int kGLVPixelsHalfMinusOne = kGLVPixelsHalf - 1;
+	for (auto sample_index = 0; sample_index < kGLVPixelsHalfMinusOne; sample_index += 2) {
+		auto il_index = sample_index << 1;
+		raw_buffer[il_index    ] = glv_byte_swap(dac_column[sample_index]);
+		raw_buffer[il_index + 1] = glv_byte_swap(dac_column[sample_index + 1]);
+		raw_buffer[il_index + 2] = glv_byte_swap(dac_column[kGLVPixelsHalf + sample_index]);
+		raw_buffer[il_index + 3] = glv_byte_swap(dac_column[kGLVPixelsHalfPlusOne + sample_index]);
+	}
+}
@@ -33,7 +33,7 @@ int main(int argc, char *argv[]) {
 	}
 	auto test_index = GLV::USR_TEST4;
 	if (!glv.run_test(test_index)) {
-		std::cout << "TEST: GLV test did not run, possibly in emulation mode " << std::endl;
+		std::cout << "TEST: GLV test did not run" << std::endl;
 	}
 	Sleep(1000000);
 	return 0;